@@ -17,31 +17,49 @@
 #include <config.h>
 #include <codegen/codegen.h>
 #include <codegen/context.h>
+#include <codegen/debug/dump.h>
+#include <codegen/debug/perf.h>
+#include <codegen/debug/stats.h>
+#include <codegen/walker.h>
 
 #ifndef __INTELLISENSE__
 |.actionlist actions
 |.externnames extern_names
 |.globals globl_
 |.globalnames globl_names
-|.section aux, code, data
+|.section aux, code, cold, data
 |
 |.type JClosure, JClosure
 |.type JPipe, JPipe
 |.type JPipeEnd, JPipeEnd
+|.type JVariables, JVariables
 |.type gpointer, gpointer
 |
 |.define RetContinue, J_CLOSURE_STATUS_CONTINUE
 |.define RetRemove, J_CLOSURE_STATUS_REMOVE
 ||
+||G_LOCK_DEFINE_STATIC (pool);
+||static JContext* pool [J_CONTEXT_POOL_SIZE];
+||static guint pool_length = 0;
+||
+||static void walker_free (JWalker* walker)
+||{
+||  j_walker_clear (walker);
+||  g_slice_free (JWalker, walker);
+||}
+||
 ||void j_context_init (Dst_DECL)
 ||{
 ||  Dst->labels = g_new0 (gpointer, globl__MAX);
 ||  Dst->n_labels = globl__MAX;
-||  Dst->nextpc = 0;
 ||  Dst->maxpc = 2;
-||  Dst->max_expansions = 0;
 ||  Dst->symbols = g_hash_table_new (g_str_hash, g_str_equal);
 ||  Dst->strtab = g_hash_table_new (g_str_hash, g_str_equal);
+||  Dst->strings = g_hash_table_new_full (g_direct_hash, g_direct_equal, (GDestroyNotify) g_ref_string_release, NULL);
+||  Dst->fixups = g_array_new (FALSE, FALSE, sizeof (JFixup));
+||  Dst->marks = g_array_new (FALSE, FALSE, sizeof (JMark));
+||  Dst->relocs = NULL;
+||  Dst->walkers = g_ptr_array_new_with_free_func ((GDestroyNotify) walker_free);
 #if DEVELOPER == 1
 ||  Dst->debug_info = g_hash_table_new (g_str_hash, g_str_equal);
 ||  j_gdb_builder_init (&Dst->debug_builder);
@@ -49,9 +67,42 @@
 ||
 ||  dasm_init (Dst, DASM_MAXSECTION);
 ||  dasm_setupglobal (Dst, Dst->labels, Dst->n_labels);
-||  dasm_setup (Dst, actions);
 ||  dasm_growpc (Dst, Dst->maxpc);
 ||  g_queue_init (&Dst->detachables);
+||  g_queue_init (&Dst->lazies);
+||  j_context_reset (Dst);
+||}
+||
+||void j_context_reset (Dst_DECL)
+||{
+||  Dst->nextpc = 0;
+||  Dst->n_steps = 0;
+||  Dst->max_expansions = 0;
+||  Dst->cold = 0;
+||  Dst->n_sites = 0;
+||  Dst->profile = NULL;
+||  Dst->n_profile = 0;
+||  Dst->profiling = FALSE;
+||  Dst->detachables_base = 0;
+||  Dst->lazies_base = 0;
+||  Dst->eager = FALSE;
+||  Dst->base = NULL;
+||  Dst->delta = 0;
+||
+||  memset (Dst->labels, 0, sizeof (gpointer) * Dst->n_labels);
+||  g_hash_table_remove_all (Dst->symbols);
+||  g_hash_table_remove_all (Dst->strtab);
+||  g_hash_table_remove_all (Dst->strings);
+||  g_array_set_size (Dst->fixups, 0);
+||  g_array_set_size (Dst->marks, 0);
+||  g_clear_pointer (&Dst->relocs, g_array_unref);
+#if DEVELOPER == 1
+||  g_hash_table_remove_all (Dst->debug_info);
+||  j_gdb_builder_clear (&Dst->debug_builder);
+||  j_gdb_builder_init (&Dst->debug_builder);
+#endif // DEVELOPER
+||
+||  dasm_setup (Dst, actions);
 ||
 |   .code
 |->__code_start:
@@ -69,31 +120,144 @@
 #endif // DEVELOPER
 ||  g_free (Dst->labels);
 ||  g_queue_clear (&Dst->detachables);
+||  g_queue_clear (&Dst->lazies);
 ||  g_hash_table_remove_all (Dst->symbols);
 ||  g_hash_table_unref (Dst->symbols);
 ||  g_hash_table_remove_all (Dst->strtab);
 ||  g_hash_table_unref (Dst->strtab);
+||  g_hash_table_remove_all (Dst->strings);
+||  g_hash_table_unref (Dst->strings);
+||  g_clear_pointer (&Dst->fixups, g_array_unref);
+||  g_clear_pointer (&Dst->marks, g_array_unref);
+||  g_clear_pointer (&Dst->relocs, g_array_unref);
+||  g_clear_pointer (&Dst->walkers, g_ptr_array_unref);
 ||  dasm_free (Dst);
 ||}
 ||
+||JContext* j_context_acquire (guint n_nodes)
+||{
+||  JContext* context = NULL;
+||
+||  G_LOCK (pool);
+||  context = (pool_length == 0) ? NULL : pool [--pool_length];
+||  G_UNLOCK (pool);
+||
+||  if (context != NULL)
+||    j_context_reset (context);
+||  else
+||    j_context_init (context = g_slice_new0 (JContext));
+||
+||  /* Roughly two labels per node, so allocpc seldom has to double */
+||  if (context->maxpc < n_nodes * 2)
+||    dasm_growpc (context, context->maxpc = n_nodes * 2);
+||return context;
+||}
+||
+||void j_context_release (Dst_DECL)
+||{
+||  G_LOCK (pool);
+||
+||  if (pool_length < J_CONTEXT_POOL_SIZE)
+||    {
+||      pool [pool_length++] = Dst;
+||      Dst = NULL;
+||    }
+||
+||  G_UNLOCK (pool);
+||
+||  if (Dst != NULL)
+||    {
+||      j_context_clear (Dst);
+||      g_slice_free (JContext, Dst);
+||    }
+||}
+||
+||JWalker* j_context_walker_acquire (Dst_DECL)
+||{
+||  if (Dst->walkers->len == 0)
+||    return g_slice_new0 (JWalker);
+||  else
+||    return g_ptr_array_steal_index_fast (Dst->walkers, Dst->walkers->len - 1);
+||}
+||
+||void j_context_walker_release (Dst_DECL, JWalker* walker)
+||{
+||  j_walker_reset (walker);
+||  g_ptr_array_add (Dst->walkers, walker);
+||}
+||
+||const gchar* j_context_get_build_id (void)
+||{
+||  static const gchar* build_id = NULL;
+||
+||  if (g_once_init_enter (&build_id))
+||    {
+||      GChecksum* checksum = g_checksum_new (G_CHECKSUM_SHA256);
+||      const gsize layout [] = { J_CONTEXT_LAYOUT_VERSION, sizeof (JClosure), sizeof (JPipeEnd), sizeof (gpointer), };
+||      guint i;
+||
+||      /* Bump J_CONTEXT_LAYOUT_VERSION when cached blocks stop being valid for another reason */
+||      g_checksum_update (checksum, (const guchar*) PACKAGE_STRING, -1);
+||      g_checksum_update (checksum, (const guchar*) layout, sizeof (layout));
+||      g_checksum_update (checksum, (const guchar*) actions, sizeof (actions));
+||
+||      for (i = 0; extern_names [i] != NULL; ++i)
+||        g_checksum_update (checksum, (const guchar*) extern_names [i], strlen (extern_names [i]) + 1);
+||
+||      g_once_init_leave (&build_id, g_strdup (g_checksum_get_string (checksum)));
+||      g_checksum_free (checksum);
+||    }
+||return build_id;
+||}
+||
+||const gchar* j_context_get_extern_name (guint index)
+||{
+||  return (index < G_N_ELEMENTS (extern_names) - 1) ? extern_names [index] : NULL;
+||}
+||
 ||/* Defined at the bottom of the file */
 ||void j_context_emit_debuginfo (Dst_DECL);
 ||
 ||static void finish_code_und (Dst_DECL, GHashTableIter* iter)
 ||{
+||  GHashTable* done = g_hash_table_new (g_str_hash, g_str_equal);
+||  GSList* link = NULL;
+||  GSList* list = NULL;
 ||  JTag tag;
 ||  JOnceID* once;
 ||  const JOnceInit* init;
 ||
-||  while (g_hash_table_iter_next (iter, (gpointer*) &once, &tag))
+||/*
+|| * Stubs may refer to other onces, so the table
+|| * can grow while its entries are being emitted
+|| */
+||  do
 ||  {
+||    g_slist_free (list);
+||    list = NULL;
+||
+||    g_hash_table_iter_init (iter, Dst->symbols);
+||
+||    while (g_hash_table_iter_next (iter, (gpointer*) &once, &tag))
+||    if (g_hash_table_add (done, (gpointer) once))
+||      list = g_slist_prepend (list, (gpointer) once);
+||
+||    for (link = list; link; link = link->next)
+||    {
+||      once = link->data;
+||      tag = g_hash_table_lookup (Dst->symbols, once);
+||      j_context_mark (Dst, &tag, once);
 |=>(j_tag_as_pc (&tag)):
 ||
-||    if ((init = j_once_lookup (once, strlen (once))) != NULL)
-||      init->callback (Dst);
-||    else
-||      g_error ("(" G_STRLOC "): Unknown once '%s'", once);
+||      if ((init = j_once_lookup (once, strlen (once))) != NULL)
+||        init->callback (Dst);
+||      else
+||        g_error ("(" G_STRLOC "): Unknown once '%s'", once);
+||    }
 ||  }
+||  while (list != NULL);
+||
+||  g_hash_table_unref (done);
 ||}
 ||
 ||static void finish_data_und (Dst_DECL, GHashTableIter* iter)
@@ -108,11 +272,43 @@
 ||  }
 ||}
 ||
+||void j_context_enter_cold (Dst_DECL)
+||{
+||  if (Dst->cold++ == 0)
+||    {
+|.cold
+||    }
+||}
+||
+||void j_context_leave_cold (Dst_DECL)
+||{
+||  if (--Dst->cold == 0)
+||    {
+|.code
+||    }
+||}
+||
+||void j_context_leave_data (Dst_DECL)
+||{
+||  if (Dst->cold == 0)
+||    {
+|.code
+||    }
+||  else
+||    {
+|.cold
+||    }
+||}
+||
+||/*
+|| * Cold code sits past the hot chains, so error tails and
+|| * rarely taken branches stay out of the way of straight runs
+|| */
 ||void j_context_finish (Dst_DECL)
 ||{
 ||  GHashTableIter iter;
 ||
-|.code
+|.cold
 ||  g_hash_table_iter_init (&iter, Dst->symbols);
 ||  finish_code_und (Dst, &iter);
 |->__code_end:
@@ -123,6 +319,209 @@
 |->__data_end:
 ||}
 ||
+||const gchar* j_context_intern (Dst_DECL, const gchar* value)
+||{
+||  gchar* string = g_ref_string_new_intern (value);
+||/*
+|| * Replacing an existing key drops the reference taken
+|| * above, so each context holds exactly one per string
+|| */
+||return (g_hash_table_add (Dst->strings, string), string);
+||}
+||
+||void j_context_mark (Dst_DECL, const JTag* tag, const gchar* name)
+||{
+||  JMark mark = { *tag, name, };
+||
+||  if (j_perf_enabled () || j_dump_enabled ())
+||    g_array_append_val (Dst->marks, mark);
+||}
+||
+||void j_context_mark_step (Dst_DECL, const JTag* tag, const gchar* name)
+||{
+||  Dst->n_steps += 1;
+||  j_context_mark (Dst, tag, name);
+||}
+||
+||static gint mark_compare (const JMark* a, const JMark* b)
+||{
+||  return (a->tag < b->tag) ? -1 : (a->tag > b->tag);
+||}
+||
+||void j_context_emit_perfmap (Dst_DECL, gpointer base)
+||{
+||  gpointer code_start = Dst->labels [globl___code_start];
+||  gpointer code_end = Dst->labels [globl___code_end];
+||  JMark* mark = NULL;
+||  gpointer next = NULL;
+||  guint i;
+||
+||  if (Dst->marks->len == 0 || !j_perf_enabled ())
+||    return;
+||
+||  for (i = 0; i < Dst->marks->len; ++i)
+||    {
+||      mark = & g_array_index (Dst->marks, JMark, i);
+||      mark->tag = base + j_tag_as_offset (Dst, & mark->tag);
+||    }
+||
+||  g_array_sort (Dst->marks, (GCompareFunc) mark_compare);
+||  j_perf_write (code_start, g_array_index (Dst->marks, JMark, 0).tag - code_start, "closure");
+||
+||  for (i = 0; i < Dst->marks->len; ++i)
+||    {
+||      mark = & g_array_index (Dst->marks, JMark, i);
+||      next = (i + 1 < Dst->marks->len) ? mark [1].tag : code_end;
+||
+||      if (next > mark->tag)
+||        j_perf_write (mark->tag, next - mark->tag, mark->name);
+||    }
+||
+||  g_array_set_size (Dst->marks, 0);
+||}
+||
+||typedef struct _JDumpSymbols JDumpSymbols;
+||
+||struct _JDumpSymbols
+||{
+||  JContext* context;
+||  GArray* marks;
+||};
+||
+||static const gchar* dump_symbolize (gconstpointer address, JDumpSymbols* symbols)
+||{
+||  JContext* Dst = symbols->context;
+||  const gchar* name = NULL;
+||  JMark* mark = NULL;
+||  guint i;
+||
+||  if ((name = j_extern_name (address)) != NULL)
+||    return name;
+||
+||  for (i = 0; i < globl__MAX; ++i)
+||  if (Dst->labels [i] == address)
+||    return globl_names [i];
+||
+||  for (i = 0; i < symbols->marks->len; ++i)
+||  if ((mark = & g_array_index (symbols->marks, JMark, i))->tag == address)
+||    return mark->name;
+||return NULL;
+||}
+||
+||void j_context_emit_dump (Dst_DECL, gpointer base)
+||{
+||  gpointer code_start = Dst->labels [globl___code_start];
+||  gpointer code_end = Dst->labels [globl___code_end];
+||  gpointer data_start = Dst->labels [globl___data_start];
+||  gpointer data_end = Dst->labels [globl___data_end];
+||  JDumpSymbols symbols = { Dst, NULL, };
+||  GString* buffer = NULL;
+||  GHashTableIter iter;
+||  const gchar* name = NULL;
+||  JMark* mark = NULL;
+||  gpointer start, next;
+||  gpointer key, value;
+||  guint i;
+||
+||  if (!j_dump_enabled ())
+||    return;
+||
+||  symbols.marks = g_array_copy (Dst->marks);
+||  buffer = g_string_sized_new (4096);
+||
+||  for (i = 0; i < symbols.marks->len; ++i)
+||    {
+||      mark = & g_array_index (symbols.marks, JMark, i);
+||      mark->tag = base + j_tag_as_offset (Dst, & mark->tag);
+||    }
+||
+||  g_array_sort (symbols.marks, (GCompareFunc) mark_compare);
+||  g_string_append_printf (buffer, "closure %p: %" G_GSIZE_FORMAT " code bytes, %" G_GSIZE_FORMAT " data bytes, %u steps\n",
+||    code_start, (gsize) (code_end - code_start), (gsize) (data_end - data_start), Dst->n_steps);
+||
+||  g_string_append (buffer, "  globals:\n");
+||
+||  for (i = 0; i < globl__MAX; ++i)
+||    g_string_append_printf (buffer, "    %p %s\n", Dst->labels [i], globl_names [i]);
+||
+||  g_string_append (buffer, "  strings:\n");
+||  g_hash_table_iter_init (&iter, Dst->strtab);
+||
+||  while (g_hash_table_iter_next (&iter, &key, &value))
+||    j_dump_string (buffer, base + j_tag_as_offset (Dst, (JTag*) &value), key);
+||
+||  g_hash_table_iter_init (&iter, Dst->strings);
+||
+||  while (g_hash_table_iter_next (&iter, &key, NULL))
+||    j_dump_string (buffer, key, key);
+||
+||  /* Whatever precedes the first mark is the closure's own prologue */
+||  for (i = 0; i <= symbols.marks->len; ++i)
+||    {
+||      start = (i == 0) ? code_start : g_array_index (symbols.marks, JMark, i - 1).tag;
+||      name = (i == 0) ? "closure" : g_array_index (symbols.marks, JMark, i - 1).name;
+||      next = (i < symbols.marks->len) ? g_array_index (symbols.marks, JMark, i).tag : code_end;
+||
+||      if (next > start)
+||        {
+||          g_string_append_printf (buffer, "  <%s> %p: %" G_GSIZE_FORMAT " bytes\n", name, start, (gsize) (next - start));
+||          j_dump_code (buffer, start, next - start, (JDumpSymbolize) dump_symbolize, &symbols);
+||        }
+||    }
+||
+||  g_string_append (buffer, "  data:\n");
+||  j_dump_data (buffer, data_start, data_end - data_start);
+||  j_dump_write (buffer->str);
+||  g_string_free (buffer, TRUE);
+||  g_array_unref (symbols.marks);
+||}
+||
+||void j_context_account (Dst_DECL)
+||{
+||  gpointer code_start = Dst->labels [globl___code_start];
+||  gpointer code_end = Dst->labels [globl___code_end];
+||  gpointer data_start = Dst->labels [globl___data_start];
+||  gpointer data_end = Dst->labels [globl___data_end];
+||
+||  j_stats_add (J_STATS_COUNTER_CODE_BYTES, code_end - code_start);
+||  j_stats_add (J_STATS_COUNTER_DATA_BYTES, data_end - data_start);
+||  j_stats_add (J_STATS_COUNTER_LABELS, Dst->nextpc);
+||  j_stats_add (J_STATS_COUNTER_STEPS, Dst->n_steps);
+||}
+||
+||void j_context_relocate (Dst_DECL, JBlock* block)
+||{
+||  gpointer alias = j_block_alias (block);
+||  gpointer base = j_block_ptr (block);
+||  JFixup* fixup = NULL;
+||  gpointer* slot = NULL;
+||  guint i;
+||
+||  /* dasm_encode () saw the writable view, labels should point to the executable one */
+||  for (i = 0; i < Dst->n_labels; ++i)
+||    if (Dst->labels [i] != NULL)
+||      Dst->labels [i] += j_block_delta (block);
+||
+||  for (i = 0; i < Dst->fixups->len; ++i)
+||    {
+||      fixup = & g_array_index (Dst->fixups, JFixup, i);
+||      slot = alias + j_tag_as_offset (Dst, & fixup->array) + fixup->slot * sizeof (gpointer);
+||
+||      if (fixup->address != NULL)
+||        *slot = (gpointer) fixup->address;
+||      else
+||        {
+||          *slot = base + j_tag_as_offset (Dst, & fixup->target);
+||
+||          if (Dst->relocs != NULL)
+||            {
+||              JReloc reloc = { (guint32) ((gpointer) slot - alias), (guint16) J_RELOC_INDEX_BLOCK, 0, };
+||              g_array_append_val (Dst->relocs, reloc);
+||            }
+||        }
+||    }
+||}
+||
 ||void j_context_store (Dst_DECL, gconstpointer buffer, gsize bufsz)
 ||{
 ||  const gsize n_dwords = (bufsz / 4);
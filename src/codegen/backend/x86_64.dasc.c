@@ -26,19 +26,21 @@
 # include <codegen/debug/gdb.h>
 #endif // DEVELOPER
 #include <lexer/token.h>
+#include <sys/syscall.h>
 
 #ifndef __INTELLISENSE__
 |.arch x64
 |.include codegen/backend/common.dasc.c
 |
-|.define self, gpointer:rbp [-1]
-|.define runner, gpointer:rbp [-2]
+|.define self, rbx
+|.define runner, r15
+|.define saved1, gpointer:rbp [-1]
+|.define saved2, gpointer:rbp [-2]
 |.define error, gpointer:rbp [-3]
 |.define tmperr, gpointer:rbp [-4]
 |.define pipes, gpointer:rbp [-5]
+|.define report, gpointer:rbp [-6]
 |.define rtmp, r10
-|.define rsv1, rbx
-|.define rsv2, r15
 |
 |.if PLATFORM == 'linux'
 | .define c_arg1, rdi
@@ -58,6 +60,25 @@
 ||const guint j_gdb_default_mach = bfd_mach_x86_64;
 ||typedef union _JInvokeStdfile JInvokeStdfile;
 ||
+|.macro j_arithmetic_compare, condition
+|   cmp rax, rcx
+|   set..condition al
+|   movzx eax, al
+|.endmacro
+|.macro j_frame_enter, size
+|   push rbp
+|   mov rbp, rsp
+|   sub rsp, size
+|   mov saved1, self
+|   mov saved2, runner
+|   mov self, c_arg1
+|   mov runner, c_arg2
+|.endmacro
+|.macro j_frame_leave
+|   mov self, saved1
+|   mov runner, saved2
+|   leave
+|.endmacro
 |.macro j_load_gtype, register, gtype
 ||#if GLIB_SIZEOF_SIZE_T != GLIB_SIZEOF_LONG || !defined __cplusplus
 |   mov64 register, ((guintptr) gtype)
@@ -65,6 +86,94 @@
 |   mov register, ((GType) gtype)
 ||#endif
 |.endmacro
+|.macro j_load_string, register, value
+||  if (Dst->eager)
+||    {
+|     lea register, [=>(j_tag_once_string_as_pc (Dst, value))]
+||    }
+||  else
+||    {
+|     mov64 register, ((guintptr) j_context_intern (Dst, value))
+||    }
+|.endmacro
+|.macro j_spawn_adjust_io
+|   j_spawn_adjust_io_file stdin, STDIN_FILENO
+|   j_spawn_adjust_io_file stdout, STDOUT_FILENO
+|.endmacro
+|.macro j_spawn_adjust_io_file, file, fileno
+||  switch (invoke-> .. file .. _type)
+||  {
+||    case J_INVOKE_STD_FILE_TYPE_FILE:
+||    if (invoke-> .. file .. .filename == NULL)
+||      break;
+||    else
+||      {
+|         j_load_string c_arg1, invoke-> .. file .. .filename
+|         mov c_arg2, (j_invoke_get_open_flags (fileno, invoke->stdout_mode == J_INVOKE_STD_FILE_MODE_APPEND))
+|         mov c_arg3, (j_invoke_get_open_mode (fileno, invoke->stdout_mode == J_INVOKE_STD_FILE_MODE_APPEND))
+|         mov eax, SYS_open
+|         syscall
+|         j_spawn_check J_SPAWN_STEP_OPEN, invoke-> .. file .. .filename
+|
+|         mov c_arg1, rax
+|         mov c_arg2, fileno
+|         mov eax, SYS_dup2
+|         syscall
+|         j_spawn_check J_SPAWN_STEP_DUP2, NULL
+|
+||        /* syscall leaves c_arg1 alone */
+|         mov eax, SYS_close
+|         syscall
+||        break;
+||      }
+||    case J_INVOKE_STD_FILE_TYPE_PIPE:
+|       mov c_arg1, pipes
+|       lea c_arg1, JPipe:c_arg1 [invoke-> .. file .. .fd] [(gint) fileno]
+|       movsxd c_arg1, dword [c_arg1]
+|       mov c_arg2, (fileno)
+|       mov eax, SYS_dup2
+|       syscall
+|       j_spawn_check J_SPAWN_STEP_DUP2, NULL
+||      break;
+||  }
+|.endmacro
+|.macro j_spawn_check, step, subject
+|   test rax, rax
+|   jns >9
+|     neg rax
+|     mov c_arg4, rax
+|     lea rtmp, report
+|     movsxd c_arg1, dword [rtmp + 4]
+|     mov c_arg2, step
+||
+||  if ((subject) == NULL)
+||    {
+|       xor c_arg3, c_arg3
+||    }
+||  else
+||    {
+|       j_load_string c_arg3, (subject)
+||    }
+|
+|     call extern j_spawn_fail
+|   9:
+|.endmacro
+|.macro j_spawn_signal_default, signo
+||/* Kernel's struct sigaction, all zeroes is SIG_DFL with an empty mask */
+|   sub rsp, #gpointer * 4
+|   xor eax, eax
+|   mov [rsp], rax
+|   mov [rsp + 8], rax
+|   mov [rsp + 16], rax
+|   mov [rsp + 24], rax
+|   mov c_arg1, signo
+|   mov c_arg2, rsp
+|   xor c_arg3, c_arg3
+|   mov r10, (_NSIG / 8)
+|   mov eax, SYS_rt_sigaction
+|   syscall
+|   add rsp, #gpointer * 4
+|.endmacro
 |.macro j_step_adjust_io
 |   j_step_adjust_io_file stdin, STDIN_FILENO
 |   j_step_adjust_io_file stdout, STDOUT_FILENO
@@ -84,39 +193,32 @@
 ||      break;
 ||    else
 ||      {
-|         lea c_arg1, [=>(j_tag_once_string_as_pc (Dst, invoke-> .. file .. .filename))]
+||        if (Dst->eager)
+||          {
+|           lea c_arg1, [=>(j_tag_once_string_as_pc (Dst, invoke-> .. file .. .filename))]
+||          }
+||        else
+||          {
+|           mov64 c_arg1, ((guintptr) j_context_intern (Dst, invoke-> .. file .. .filename))
+||          }
 |         mov c_arg2, (j_invoke_get_open_flags (fileno, invoke->stdout_mode == J_INVOKE_STD_FILE_MODE_APPEND))
 |         mov c_arg3, (j_invoke_get_open_mode (fileno, invoke->stdout_mode == J_INVOKE_STD_FILE_MODE_APPEND)) 
 |         lea c_arg4, tmperr
 |         call extern j_open
 |
-|         mov c_arg2, tmperr
-|         test c_arg2, c_arg2
-|         jz >9
-|           mov c_arg1, error
-|           call extern g_propagate_error
-|           leave
-|           ret
-|         9:
-|           sub rsp, #gpointer * 2
-|           mov [rsp], rax
-|           mov c_arg1, rax
-|           mov c_arg2, fileno
-|           lea c_arg3, tmperr
-|           call extern j_dup2
+|         j_step_check j_stub_propagate
+|         sub rsp, #gpointer * 2
+|         mov [rsp], rax
+|         mov c_arg1, rax
+|         mov c_arg2, fileno
+|         lea c_arg3, tmperr
+|         call extern j_dup2
 |
-|           mov c_arg2, tmperr
-|           test c_arg2, c_arg2
-|           jz >9
-|             mov c_arg1, error
-|             call extern g_propagate_error
-|             leave
-|             ret
-|           9:
-|             mov c_arg1, [rsp]
-|             mov c_arg2, 0
-|             add rsp, #gpointer * 2
-|             call extern g_close
+|         j_step_check j_stub_propagate
+|         mov c_arg1, [rsp]
+|         mov c_arg2, 0
+|         add rsp, #gpointer * 2
+|         call extern g_close
 ||        break;
 ||      }
 ||    case J_INVOKE_STD_FILE_TYPE_PIPE:
@@ -127,17 +229,17 @@
 |       lea c_arg3, tmperr
 |       call extern j_dup2
 |
-|       mov c_arg2, tmperr
-|       test c_arg2, c_arg2
-|       jz >9
-|         mov c_arg1, error
-|         call extern g_propagate_error
-|         leave
-|         ret
-|       9:
+|       j_step_check j_stub_propagate
 ||      break;
 ||  }
 |.endmacro
+|.macro j_step_branch_jump, tag
+|   mov c_arg1, self
+|   mov c_arg2, runner
+|   mov c_arg3, error
+|   j_frame_leave
+|   jmp =>(j_tag_as_pc (tag))
+|.endmacro
 |.macro j_step_branch_put_last
 |   mov rax, RetRemove
 |   ret
@@ -150,30 +252,36 @@
 |   lea rtmp, [=>(j_tag_as_pc (tag))]
 |   mov JClosure:closure->entry, rtmp
 |.endmacro
+|.macro j_step_check, stub
+|   mov c_arg2, tmperr
+|   test c_arg2, c_arg2
+|   jnz =>(j_tag_once_symbol_as_pc (Dst, stub))
+|.endmacro
 |.macro j_step_fork
 |   lea c_arg1, tmperr
 |   call extern j_fork
 |
-|   mov c_arg2, tmperr
-|   test c_arg2, c_arg2
-|   jz >9
-|     mov c_arg1, error
-|     call extern g_propagate_error
-|     leave
-|     ret
-|   9:
+|   j_step_check j_stub_propagate
 |.endmacro
 |.macro j_step_fork_and_report, error_code
 |   j_step_fork
 |   test rax, rax
 |   jz >9
-|     leave
+|     j_frame_leave
 |     ret
 |   9:
 |     j_step_adjust_io
 |     j_step_report error_code
-|     leave
-|     ret
+|.endmacro
+|.macro j_step_fork_or_settle, error_code
+||  if (walker->n_pipes == 0 && j_invoke_is_inline (invoke))
+||    {
+|       j_step_settle error_code
+||    }
+||  else
+||    {
+|       j_step_fork_and_report error_code
+||    }
 |.endmacro
 |.macro j_step_load_arg, index_, register
 ||  G_STMT_START
@@ -184,7 +292,14 @@
 ||      switch (__argument->type)
 ||      {
 ||        case J_ARGUMENT_TYPE_DATA:
-|           lea register, [=>(j_tag_as_pc (& argument_tags [__argument->index]))]
+||          if (Dst->eager)
+||            {
+|             lea register, [=>(j_tag_as_pc (& argument_tags [__argument->index]))]
+||            }
+||          else
+||            {
+|             mov64 register, ((guintptr) argument_strings [__argument->index])
+||            }
 ||          break;
 ||        case J_ARGUMENT_TYPE_EXPANSION:
 |           mov register, self
@@ -196,13 +311,217 @@
 ||  G_STMT_END;
 |.endmacro
 |.macro j_step_report, error_code
-|   mov c_arg1, error
 |   mov c_arg2, error_code
-|   call extern j_set_closure_error_exit
+|   jmp =>(j_tag_once_symbol_as_pc (Dst, j_stub_report))
 |.endmacro
+|.macro j_step_settle, error_code
+|   mov rax, self
+|   mov dword JClosure:rax->condition, error_code
+|   xor eax, eax
+|   j_frame_leave
+|   ret
+|.endmacro
+||
+||static void emit_arithmetic (Dst_DECL, JWalker* walker, JExpansion* expansion, JTag* division)
+||{
+||  JArithmetic* code = NULL;
+||  guint depth = 0;
+||  guint i;
+||
+||/*
+|| * Operands live on the machine stack, so calls out
+|| * pad it back to 16-bytes alignment whenever an odd
+|| * number of them are pushed
+|| */
+||  for (i = 0; i < expansion->n_ops; ++i)
+||    {
+||      switch ((code = j_walker_get_arithmetic (walker, expansion->first_op + i))->opcode)
+||        {
+||          case J_ARITHMETIC_OPCODE_CONSTANT:
+||            if (code->value >= G_MININT32 && code->value <= G_MAXINT32)
+||              {
+|               push ((gint32) code->value)
+||              }
+||            else
+||              {
+|               mov64 rax, ((guint64) code->value)
+|               push rax
+||              }
+||            ++depth;
+||            break;
+||
+||          case J_ARITHMETIC_OPCODE_VARIABLE:
+||            if (depth % 2 == 1)
+||              {
+|               sub rsp, #gpointer
+||              }
+|           mov c_arg1, runner
+|           j_load_string c_arg2, code->name
+|           lea c_arg3, tmperr
+|           call extern j_arithmetic_load
+|           j_step_check j_stub_propagate_fail
+||            if (depth % 2 == 1)
+||              {
+|               add rsp, #gpointer
+||              }
+|           push rax
+||            ++depth;
+||            break;
+||
+||          case J_ARITHMETIC_OPCODE_BNOT:
+|           not qword [rsp]
+||            break;
+||          case J_ARITHMETIC_OPCODE_NEG:
+|           neg qword [rsp]
+||            break;
+||          case J_ARITHMETIC_OPCODE_NOT:
+|           xor eax, eax
+|           cmp qword [rsp], 0
+|           sete al
+|           mov [rsp], rax
+||            break;
+||
+||          default:
+|           pop rcx
+|           pop rax
+||
+||            switch (code->opcode)
+||              {
+||                case J_ARITHMETIC_OPCODE_ADD:
+|                 add rax, rcx
+||                  break;
+||                case J_ARITHMETIC_OPCODE_BAND:
+|                 and rax, rcx
+||                  break;
+||                case J_ARITHMETIC_OPCODE_BOR:
+|                 or rax, rcx
+||                  break;
+||                case J_ARITHMETIC_OPCODE_BXOR:
+|                 xor rax, rcx
+||                  break;
+||                case J_ARITHMETIC_OPCODE_DIV:
+||                case J_ARITHMETIC_OPCODE_MOD:
+||                  if (*division == NULL)
+||                    j_tag_init (Dst, division);
+||
+|                 test rcx, rcx
+|                 jz =>(j_tag_as_pc (division))
+|                 cmp rcx, -1
+|                 jne >1
+||                  if (code->opcode == J_ARITHMETIC_OPCODE_DIV)
+||                    {
+|                     neg rax
+||                    }
+||                  else
+||                    {
+|                     xor eax, eax
+||                    }
+|                 jmp >2
+|                 1:
+|                 cqo
+|                 idiv rcx
+||                  if (code->opcode == J_ARITHMETIC_OPCODE_MOD)
+||                    {
+|                     mov rax, rdx
+||                    }
+|                 2:
+||                  break;
+||                case J_ARITHMETIC_OPCODE_EQ:
+|                 j_arithmetic_compare e
+||                  break;
+||                case J_ARITHMETIC_OPCODE_GE:
+|                 j_arithmetic_compare ge
+||                  break;
+||                case J_ARITHMETIC_OPCODE_GT:
+|                 j_arithmetic_compare g
+||                  break;
+||                case J_ARITHMETIC_OPCODE_LAND:
+|                 test rax, rax
+|                 setne al
+|                 test rcx, rcx
+|                 setne cl
+|                 and al, cl
+|                 movzx eax, al
+||                  break;
+||                case J_ARITHMETIC_OPCODE_LE:
+|                 j_arithmetic_compare le
+||                  break;
+||                case J_ARITHMETIC_OPCODE_LOR:
+|                 or rax, rcx
+|                 setne al
+|                 movzx eax, al
+||                  break;
+||                case J_ARITHMETIC_OPCODE_LT:
+|                 j_arithmetic_compare l
+||                  break;
+||                case J_ARITHMETIC_OPCODE_MUL:
+|                 imul rax, rcx
+||                  break;
+||                case J_ARITHMETIC_OPCODE_NE:
+|                 j_arithmetic_compare ne
+||                  break;
+||                case J_ARITHMETIC_OPCODE_SHL:
+|                 shl rax, cl
+||                  break;
+||                case J_ARITHMETIC_OPCODE_SHR:
+|                 sar rax, cl
+||                  break;
+||                case J_ARITHMETIC_OPCODE_SUB:
+|                 sub rax, rcx
+||                  break;
+||                default: g_assert_not_reached ();
+||              }
+||
+|           push rax
+||            --depth;
+||            break;
+||        }
+||    }
+||#if DEVELOPER == 1
+||  g_assert (depth == 1);
+||#endif // DEVELOPER
+||}
+||
+||static void emit_argv (Dst_DECL, JInvoke* invoke, const JTag* argument_tags, const gchar** argument_strings, guint n_arguments, JTag* tag)
+||{
+||  JArgument* arguments = & invoke->target;
+||  JFixup fixup = {0};
+||  guint i;
+||
+||/*
+|| * NULL terminated argv template, data arguments are
+|| * patched in by j_context_relocate () once encoded
+|| */
+||  j_tag_init (Dst, tag);
+||
+|.data
+|.align 8
+|=>(j_tag_as_pc (tag)):
+||
+||  for (i = 0; i <= n_arguments; ++i)
+||    {
+|       .dword 0
+|       .dword 0
+||
+||      if (i < n_arguments && arguments [i].type == J_ARGUMENT_TYPE_DATA)
+||        {
+||          fixup.array = *tag;
+||          fixup.slot = i;
+||
+||          if (Dst->eager)
+||            fixup.target = argument_tags [arguments [i].index];
+||          else
+||            fixup.address = argument_strings [arguments [i].index];
+||          g_array_append_val (Dst->fixups, fixup);
+||        }
+||    }
+||
+||  j_context_leave_data (Dst);
+||}
 ||
 ||void j_context_emit_absolute_jump (Dst_DECL, gpointer address, const JTag* tag)
 ||{
+||  j_context_mark (Dst, tag, "trampoline");
 |=>(j_tag_as_pc (tag)):
 |   mov64 rax, ((guintptr) address)
 |   jmp rax
@@ -210,14 +529,15 @@
 ||
 ||void j_context_emit_chain_empty (Dst_DECL, const JTag* tag, const JTag* tag_next)
 ||{
+||  j_context_mark_step (Dst, tag, "chain_empty");
 |=>(j_tag_as_pc (tag)):
-|   j_step_branch_set_tag, c_arg1, tag_next
-|   mov rax, RetContinue
-|   ret
+|   mov dword JClosure:c_arg1->condition, 0
+|   jmp =>(j_tag_as_pc (tag_next))
 ||}
 ||
 ||void j_context_emit_chain_last (Dst_DECL, const JTag* tag)
 ||{
+||  j_context_mark_step (Dst, tag, "chain_last");
 |=>(j_tag_as_pc (tag)):
 |   sub rsp, #gpointer
 |   mov qword JClosure:c_arg1->entry, 0
@@ -231,14 +551,14 @@
 ||
 ||void j_context_emit_chain_step (Dst_DECL, JWalker* walker, const JTag* tag, const JTag* tag_next)
 ||{
-||  guint n_expansions = g_queue_get_length (&walker->expansions);
+||  guint n_expansions = j_walker_n_expansions (walker);
 ||
 ||  if (n_expansions > Dst->max_expansions)
 ||    {
 ||      Dst->max_expansions = n_expansions;
 ||    }
 ||
-||  if (g_queue_get_length (&walker->expansions) == 0)
+||  if (n_expansions == 0)
 ||    j_context_emit_chain_step_expression (Dst, walker, tag, tag_next);
 ||  else
 ||    {
@@ -254,8 +574,8 @@
 ||{
 ||/*
 || * Stack (should be 16-bytes aligned):
-|| * > JClosure* self; (argument #1)
-|| * > JRunner* runner; (argument #2)
+|| * > saved rbx; (self lives there, argument #1)
+|| * > saved r15; (runner lives there, argument #2)
 || * > GError** error; (argument #3)
 || * before self goes other two 8-bytes slots
 || * - return address (pushed by call, caller)
@@ -267,16 +587,14 @@
 || + sizeof (GError**)
 ||  ; stacksize += 16 - (stacksize % 16);
 ||
+||  j_context_mark_step (Dst, tag, "chain_step_detach");
 |=>(j_tag_as_pc (tag)):
-|   push rbp
-|   mov rbp, rsp
-|   sub rsp, stacksize
-|   mov self, c_arg1
-|   mov runner, c_arg2
+|   j_frame_enter stacksize
 |   mov error, c_arg3
 |
+|   call extern j_ast_get_type
 |   mov c_arg1, error
-|   j_load_gtype c_arg2, J_TYPE_AST
+|   mov c_arg2, rax
 |   mov c_arg3, self
 |   mov c_arg3, JClosure:c_arg3->detachables
 |   mov c_arg3, gpointer:c_arg3 [index]
@@ -284,21 +602,78 @@
 |   call extern j_set_closure_error_irq
 |   mov rax, self
 |   j_step_branch_set_tag rax, tag_next
-|   leave
+|   j_frame_leave
+|   mov rax, RetContinue
+|   ret
+||}
+||
+||void j_context_emit_chain_step_function (Dst_DECL, guint index, const JTag* tag, const JTag* tag_next)
+||{
+||/*
+|| * Stack (should be 16-bytes aligned):
+|| * > saved rbx; (self lives there, argument #1)
+|| * > saved r15; (runner lives there, argument #2)
+|| * > GError** error; (argument #3)
+|| * before self goes other two 8-bytes slots
+|| * - return address (pushed by call, caller)
+|| * - frame pointer (pushed at function entry, callee)
+|| */
+||  gsize stacksize = 0
+|| + sizeof (JClosure*)
+|| + sizeof (JRunner*)
+|| + sizeof (GError**)
+||  ; stacksize += 16 - (stacksize % 16);
+||
+||  j_context_mark_step (Dst, tag, "chain_step_function");
+|=>(j_tag_as_pc (tag)):
+|   j_frame_enter stacksize
+|   mov error, c_arg3
+|
+|   mov c_arg1, runner
+|   mov c_arg2, self
+|   mov c_arg2, JClosure:c_arg2->detachables
+|   mov c_arg2, gpointer:c_arg2 [index]
+|   call extern j_runner_function_define
+|
+|   mov rax, self
+|   mov dword JClosure:rax->condition, 0
+|   j_step_branch_jump tag_next
+||}
+||
+||void j_context_emit_chain_step_lazy (Dst_DECL, guint index, const JTag* tag)
+||{
+||/*
+|| * Arguments are forwarded untouched, so the
+|| * stub only needs to keep the stack aligned
+|| */
+||  j_context_mark_step (Dst, tag, "chain_step_lazy");
+|=>(j_tag_as_pc (tag)):
+|   sub rsp, #gpointer
+|   mov c_arg4, index
+|   call extern j_closure_lazy
+|   add rsp, #gpointer
+|   ret
+||}
+||
+||void j_context_emit_chain_yield (Dst_DECL, const JTag* tag, const JTag* tag_next)
+||{
+||  j_context_mark_step (Dst, tag, "chain_yield");
+|=>(j_tag_as_pc (tag)):
+|   j_step_branch_set_tag, c_arg1, tag_next
 |   mov rax, RetContinue
 |   ret
 ||}
 ||
 ||void j_context_emit_chain_step_expansions (Dst_DECL, JWalker* walker, const JTag* tag, const JTag* tag_next)
 ||{
-||  GList* list;
+||  JTag division = NULL;
 ||  JTag splice;
 ||  guint i;
 ||
 ||/*
 || * Stack (should be 16-bytes aligned):
-|| * > JClosure* self; (argument #1)
-|| * > JRunner* runner; (argument #2)
+|| * > saved rbx; (self lives there, argument #1)
+|| * > saved r15; (runner lives there, argument #2)
 || * > GError** error; (argument #3)
 || * > GError* tmperr; (local variable)
 || * > JPipes* pipes; (local variable) (if any)
@@ -314,82 +689,126 @@
 || + sizeof (JPipe)
 ||  ; stacksize += 16 - (stacksize % 16);
 ||
+||  j_context_mark_step (Dst, tag, "chain_step_expansions");
 |=>(j_tag_as_pc (tag)):
-|   push rbp
-|   mov rbp, rsp
-|   sub rsp, stacksize
-|   mov self, c_arg1
-|   mov runner, c_arg2
+|   j_frame_enter stacksize
 |   mov error, c_arg3
 |   mov qword tmperr, 0
 ||
-||  for (list = g_queue_peek_head_link (&walker->expansions), i = 0; list; list = list->next, ++i)
+||  for (i = 0; i < j_walker_n_expansions (walker); ++i)
 ||    {
-||      JTag tag_head = list->data;
+||      JExpansion* expansion = j_walker_get_expansion (walker, i);
+||      JTag tag_head = expansion->tag;
+||
+||      switch (expansion->type)
+||        {
+||          case J_EXPANSION_TYPE_ARITHMETIC:
+||            emit_arithmetic (Dst, walker, expansion, &division);
+|             pop c_arg2
+|             mov c_arg1, self
+|             mov c_arg1, JClosure:c_arg1->expansion_values
+|             lea c_arg1, gpointer:c_arg1 [i]
+|             call extern j_expand_int
+||            continue;
+||
+||          case J_EXPANSION_TYPE_BUILTIN:
+|             mov c_arg1, runner
+|             mov c_arg2, self
+|             mov c_arg2, JClosure:c_arg2->expansion_values
+|             lea c_arg2, gpointer:c_arg2 [i]
+|             j_load_string c_arg3, expansion->builtin
+||            if (expansion->value == NULL)
+||              {
+|               mov c_arg4, 0
+||              }
+||            else
+||              {
+|               j_load_string c_arg4, expansion->value
+||              }
+|             call extern j_expand_builtin
+||            continue;
+||
+||          case J_EXPANSION_TYPE_FILE:
+|             mov c_arg1, self
+|             mov c_arg1, JClosure:c_arg1->expansion_values
+|             lea c_arg1, gpointer:c_arg1 [i]
+|             j_load_string c_arg2, expansion->value
+|             lea c_arg3, tmperr
+|             call extern j_expand_file
+|
+|             j_step_check j_stub_propagate_fail
+||            continue;
+||
+||          case J_EXPANSION_TYPE_VARIABLE:
+||            if (Dst->eager || g_ascii_isdigit (*expansion->value))
+||              {
+|               mov c_arg1, runner
+|               j_load_string c_arg2, expansion->value
+|               call extern j_runner_variable_get
+|               mov c_arg2, rax
+||              }
+||            else
+||              {
+||                guint slot = j_variable_slot (expansion->value);
+|               mov rax, runner
+|               add rax, J_RUNNER_VARIABLES_OFFSET
+|               mov c_arg2, 0
+|               cmp dword JVariables:rax->n_values, slot
+|               jbe >1
+|               mov rax, JVariables:rax->values
+|               mov c_arg2, gpointer:rax [slot]
+|             1:
+||              }
+|             mov c_arg1, self
+|             mov c_arg1, JClosure:c_arg1->expansion_values
+|             lea c_arg1, gpointer:c_arg1 [i]
+|             call extern j_expand_value
+||            continue;
+||        }
 ||
 |       lea c_arg1, [rsp]
 |       mov c_arg2, 1
 |       lea c_arg3, tmperr
 |       call extern j_pipe_init_many
 |
-|       mov c_arg2, tmperr
-|       test c_arg2, c_arg2
+|       j_step_check j_stub_propagate_fail
+|       j_step_fork
+|       test rax, rax
 |       jz >1
-|         mov c_arg1, error
-|         call extern g_propagate_error
-|         mov rax, self
-|         j_step_branch_set_fail rax
-|         leave
-|         mov rax, RetRemove
-|         ret
-|       1:
-|         j_step_fork
-|         test rax, rax
-|         jz >1
-|           mov c_arg2, rax
-|           mov c_arg1, self
-|           lea c_arg1, JClosure:c_arg1->waitq
-|           call extern g_queue_push_tail
+|         mov c_arg2, rax
+|         mov c_arg1, self
+|         lea c_arg1, JClosure:c_arg1->waitq
+|         call extern g_queue_push_tail
 |
-|           movsxd c_arg1, dword JPipe:rsp [0] [1]
-|           mov c_arg2, 0
-|           call extern g_close
+|         movsxd c_arg1, dword JPipe:rsp [0] [1]
+|         mov c_arg2, 0
+|         call extern g_close
 |
-|           mov eax, dword JPipe:rsp [0] [0]
-|           mov c_arg1, self
-|           mov c_arg1, JClosure:c_arg1->expansion_pipes
-|           mov dword JPipeEnd:c_arg1 [i], eax
-|           jmp >2
-|         1:
-|           mov c_arg1, self
-|           lea c_arg1, JClosure:c_arg1->waitq
-|           call extern g_queue_clear
+|         mov eax, dword JPipe:rsp [0] [0]
+|         mov c_arg1, self
+|         mov c_arg1, JClosure:c_arg1->expansion_pipes
+|         mov dword JPipeEnd:c_arg1 [i], eax
+|         jmp >2
+|       1:
+|         mov c_arg1, self
+|         lea c_arg1, JClosure:c_arg1->waitq
+|         call extern g_queue_clear
 |
-|           movsxd c_arg1, dword JPipe:rsp [0] [1]
-|           mov c_arg2, (STDOUT_FILENO)
-|           lea c_arg3, tmperr
-|           call extern j_dup2
+|         movsxd c_arg1, dword JPipe:rsp [0] [1]
+|         mov c_arg2, (STDOUT_FILENO)
+|         lea c_arg3, tmperr
+|         call extern j_dup2
 |
-|           mov c_arg2, tmperr
-|           test c_arg2, c_arg2
-|           jz >1
-|             mov c_arg1, error
-|             call extern g_propagate_error
-|             mov rax, self
-|             j_step_branch_set_fail rax
-|             leave
-|             mov rax, RetRemove
-|             ret
-|           1:
-|             mov c_arg1, rsp
-|             mov c_arg2, 1
-|             call extern j_pipe_clear_many
+|         j_step_check j_stub_propagate_fail
+|         mov c_arg1, rsp
+|         mov c_arg2, 1
+|         call extern j_pipe_clear_many
 |
-|             mov rax, self
-|             j_step_branch_set_tag rax, &tag_head
-|             leave
-|             mov rax, RetContinue
-|             ret
+|         mov rax, self
+|         j_step_branch_set_tag rax, &tag_head
+|         j_frame_leave
+|         mov rax, RetContinue
+|         ret
 |       2:
 ||    }
 ||
@@ -397,106 +816,90 @@
 ||
 |   mov rax, self
 |   j_step_branch_set_tag rax, &splice
-|   leave
+|   j_frame_leave
 |   mov rax, RetContinue
 |   ret
+||
+||  if (division != NULL)
+||    {
+|=>(j_tag_as_pc (&division)):
+|     mov rsp, rbp
+|     sub rsp, stacksize
+|     call extern j_closure_error_quark
+|     mov c_arg1, error
+|     mov c_arg2, rax
+|     mov c_arg3, J_CLOSURE_ERROR_FAILED
+|     j_load_string c_arg4, "division by zero"
+|     call extern g_set_error_literal
+|     mov rax, self
+|     j_step_branch_set_fail rax
+|     j_frame_leave
+|     mov rax, RetRemove
+|     ret
+||    }
 |
 ||/*
 || * Stack (should be 16-bytes aligned):
-|| * > JClosure* self; (argument #1)
-|| * > JRunner* runner; (argument #2)
+|| * > saved rbx; (self lives there, argument #1)
+|| * > saved r15; (runner lives there, argument #2)
 || * > GError** error; (argument #3)
 || * > GError* tmperr; (local variable)
-|| * > GIOChannel* channel; (local variable)
 || * before self goes other two 8-bytes slots
 || * - return address (pushed by call, caller)
 || * - frame pointer (pushed at function entry, callee)
 || */
+||  j_context_mark_step (Dst, &splice, "chain_step_splice");
 |=>(j_tag_as_pc (&splice)):
-|   push rbp
-|   mov rbp, rsp
-|   sub rsp, #gpointer * 6
-|   mov self, c_arg1
-|   mov runner, c_arg2
+|   j_frame_enter #gpointer * 6
 |   mov error, c_arg3
 |   mov qword tmperr, 0
 ||
-||  for (list = g_queue_peek_head_link (&walker->expansions), i = 0; list; list = list->next, ++i)
+||  for (i = 0; i < j_walker_n_expansions (walker); ++i)
+||  if (j_walker_get_expansion (walker, i)->type == J_EXPANSION_TYPE_FORK)
 ||    {
-||      if (i > 0)
-||        {
-|           mov c_arg1, self
-||        }
-|
-|       mov c_arg1, JClosure:c_arg1->expansion_values
-|       lea c_arg1, gpointer:c_arg1 [i]
-|       lea c_arg2, [extern g_free]
-|       call extern g_clear_pointer
-|
 |       mov c_arg1, self
-|       mov c_arg1, JClosure:c_arg1->expansion_pipes
-|       movsxd c_arg1, dword JPipeEnd:c_arg1 [i]
-|       call extern g_io_channel_unix_new
-|
-|       mov [rsp], rax
-|       mov c_arg1, rax
-|       mov c_arg2, self
-|       mov c_arg2, JClosure:c_arg2->expansion_values
-|       lea c_arg2, gpointer:c_arg2 [i]
-|       mov c_arg3, 0
-|       lea c_arg4, tmperr
-|       call extern g_io_channel_read_to_end
-|
-|       mov c_arg1, [rsp]
-|       mov c_arg2, 0
-|       mov c_arg3, 0
-|       call extern g_io_channel_shutdown
-|       mov c_arg1, [rsp]
-|       call extern g_io_channel_unref
+|       mov c_arg2, i
+|       lea c_arg3, tmperr
+|       call extern j_closure_capture
 |
-|       mov c_arg2, tmperr
-|       test c_arg2, c_arg2
-|       jz >1
-|         mov c_arg1, error
-|         call extern g_propagate_error
-|         mov rax, self
-|         j_step_branch_set_fail rax
-|         leave
-|         mov rax, RetRemove
-|         ret
-|       1:
+|       j_step_check j_stub_propagate_fail
 ||    }
 ||
 |   mov rax, self
 |   j_step_branch_set_tag rax, tag_next
-|   leave
+|   j_frame_leave
 |   mov rax, RetContinue
 |   ret
 ||}
 ||
 ||void j_context_emit_chain_step_expression (Dst_DECL, JWalker* walker, const JTag* tag, const JTag* tag_next)
 ||{
+||  J_VARARRAY_DECL (argument_strings, const gchar*, 32);
+||  J_VARARRAY_INIT (argument_strings, j_walker_n_arguments (walker));
 ||  J_VARARRAY_DECL (argument_tags, JTag, 32);
-||  J_VARARRAY_INIT (argument_tags, g_queue_get_length (&walker->arguments));
+||  J_VARARRAY_INIT (argument_tags, j_walker_n_arguments (walker));
 ||  J_VARARRAY_DECL (invocation_tags, JTag, 32);
-||  J_VARARRAY_INIT (invocation_tags, g_queue_get_length (&walker->invocations));
+||  J_VARARRAY_INIT (invocation_tags, j_walker_n_invocations (walker));
 ||
-||  GList* list;
 ||  guint i, j;
 ||
-||  for (list = g_queue_peek_head_link (&walker->arguments), i = 0; list; list = list->next, ++i)
+||  for (i = 0; i < j_walker_n_arguments (walker); ++i)
 ||    {
-||      j_tag_once_string (Dst, & argument_tags [i], list->data);
+||      if (Dst->eager)
+||        j_tag_once_string (Dst, & argument_tags [i], j_walker_get_argument (walker, i));
+||      else
+||        argument_strings [i] = j_context_intern (Dst, j_walker_get_argument (walker, i));
 ||    }
 ||
 ||/*
 || * Stack (should be 16-bytes aligned):
-|| * > JClosure* self; (argument #1)
-|| * > JRunner* runner; (argument #2)
+|| * > saved rbx; (self lives there, argument #1)
+|| * > saved r15; (runner lives there, argument #2)
 || * > GError** error; (argument #3)
 || * > GError* tmperr; (local variable)
 || * > JPipes* pipes; (local variable) (if any)
 || * > JPipes pipes_ []; (local variable) (if any)
+|| * > JPipe report; (local variable) (invocations only)
 || * before self goes other two 8-bytes slots
 || * - return address (pushed by call, caller)
 || * - frame pointer (pushed at function entry, callee)
@@ -510,12 +913,9 @@
 || + sizeof (JPipe) * (walker->n_pipes)
 ||  ; stacksize += 16 - (stacksize % 16);
 ||
+||  j_context_mark_step (Dst, tag, "chain_step_expression");
 |=>(j_tag_as_pc (tag)):
-|   push rbp
-|   mov rbp, rsp
-|   sub rsp, stacksize
-|   mov self, c_arg1
-|   mov runner, c_arg2
+|   j_frame_enter stacksize
 |   mov error, c_arg3
 |   mov qword tmperr, 0
 ||
@@ -527,20 +927,10 @@
 |       lea c_arg3, tmperr
 |       call extern j_pipe_init_many
 |
-|       mov c_arg2, tmperr
-|       test c_arg2, c_arg2
-|       jz >1
-|         mov c_arg1, error
-|         call extern g_propagate_error
-|         mov rax, self
-|         j_step_branch_set_fail rax
-|         leave
-|         mov rax, RetRemove
-|         ret
-|       1:
+|       j_step_check j_stub_propagate_fail
 ||    }
 ||
-||  for (i = 0; i < g_queue_get_length (&walker->invocations); ++i)
+||  for (i = 0; i < j_walker_n_invocations (walker); ++i)
 ||    {
 ||      j_tag_init (Dst, & invocation_tags [i]);
 ||
@@ -550,21 +940,14 @@
 |       lea c_arg4, tmperr
 |       call =>(j_tag_as_pc (& invocation_tags [i]))
 |
-|       mov c_arg2, tmperr
-|       test c_arg2, c_arg2
-|       jz >1
-|         mov c_arg1, error
-|         call extern g_propagate_error
-|         mov rax, self
-|         j_step_branch_set_fail rax
-|         leave
-|         mov rax, RetRemove
-|         ret
-|       1:
-|         mov c_arg2, rax
-|         mov c_arg1, self
-|         lea c_arg1, JClosure:c_arg1->waitq
-|         call extern g_queue_push_tail
+|       j_step_check j_stub_propagate_fail
+|       test rax, rax
+|       jz >2
+|       mov c_arg2, rax
+|       mov c_arg1, self
+|       lea c_arg1, JClosure:c_arg1->waitq
+|       call extern g_queue_push_tail
+|       2:
 ||    }
 ||
 ||  if (walker->n_pipes > 0)
@@ -574,24 +957,30 @@
 |       mov c_arg2, (walker->n_pipes)
 |       call extern j_pipe_clear_many
 ||    }
+||  else
+||    {
+||      /* Builtins settled in the parent leave nothing to wait for */
+|       mov rax, self
+|       cmp dword JClosure:rax->waitq.length, 0
+|       jne >1
+|         j_step_branch_jump tag_next
+|       1:
+||    }
 ||
 |   mov rax, self
 |   j_step_branch_set_tag rax, tag_next
-|   leave
+|   j_frame_leave
 |   mov rax, RetContinue
 |   ret
 ||
-||  for (list = g_queue_peek_head_link (&walker->invocations), i = 0; list; list = list->next, ++i)
+||  for (i = 0; i < j_walker_n_invocations (walker); ++i)
 ||    {
-||      JInvoke* invoke = list->data;
-||      gsize framesz = stacksize - sizeof (JPipe) * (walker->n_pipes);
+||      JInvoke* invoke = j_walker_get_invoke (walker, i);
+||      gsize framesz = stacksize - sizeof (JPipe) * (walker->n_pipes) + sizeof (JPipe);
 ||          framesz += 16 - (framesz % 16);
+||      j_context_mark_step (Dst, & invocation_tags [i], "chain_step_invoke");
 |=>(j_tag_as_pc (& invocation_tags [i])):
-|       push rbp
-|       mov rbp, rsp
-|       sub rsp, framesz
-|       mov self, c_arg1
-|       mov runner, c_arg2
+|       j_frame_enter framesz
 |       mov error, c_arg4
 |       mov qword tmperr, 0
 ||
@@ -602,50 +991,103 @@
 ||
 ||      if (invoke->target_type == J_INVOKE_TARGET_TYPE_REGULAR)
 ||        {
-|           j_step_fork
+||          if (walker->n_pipes == 0 && j_invoke_is_inline (invoke))
+||            {
+|               mov c_arg1, runner
+|               j_step_load_arg 0, c_arg2
+|               call extern j_runner_function_prepare
+|
+|               test rax, rax
+|               jz >1
+|                 sub rsp, #gpointer * 2
+|                 mov [rsp], rax
+||
+||              for (j = 1; j <= invoke->n_arguments; ++j)
+||                {
+|                   mov c_arg1, runner
+|                   mov c_arg2, [rsp]
+|                   j_step_load_arg j, c_arg3
+|                   call extern j_runner_function_push
+||                }
+|
+|                 call extern g_ptr_array_get_type
+|                 mov c_arg2, rax
+|                 mov c_arg3, [rsp]
+|                 j_frame_leave
+|
+||              /* Dirty trick */
+|                 pop rax
+|                 mov c_arg1, error
+|                 call extern j_set_closure_error_irq
+|                 mov rax, self
+|                 j_step_branch_set_tag rax, tag_next
+|                 j_frame_leave
+|                 mov rax, RetContinue
+|                 ret
+|               1:
+||            }
+||
+|           lea c_arg1, report
+|           lea c_arg2, tmperr
+|           call extern j_spawn_fork
+|
+|           j_step_check j_stub_propagate
 |           test rax, rax
 |           jz >1
-|             leave
+|             mov c_arg1, rax
+|             lea c_arg2, report
+|             call extern j_spawn_finish
+|             j_frame_leave
 |             ret
 |           1:
-|             j_step_adjust_io
+||          /* The child either execs or exits, so it may use the stack freely */
+|             j_spawn_adjust_io
 ||            guint n_arguments = invoke->n_arguments + 1;
 ||            guint allocsz = (n_arguments + 1) * sizeof (gchar*);
 ||                 allocsz += 16 + (allocsz % 16);
-||            gboolean use_malloc = allocsz > 1024;
+||            gboolean use_static = TRUE;
+||            JTag argv_tag;
+||
+||            for (j = 0; j < n_arguments; ++j)
+||              {
+||                if ((& invoke->target) [j].type != J_ARGUMENT_TYPE_DATA)
+||                  use_static = FALSE;
+||              }
+||
+||            emit_argv (Dst, invoke, argument_tags, argument_strings, n_arguments, &argv_tag);
 ||
-|             mov c_arg1, SIGINT
-|             mov c_arg2, SIG_DFL
-|             call extern signal
+|             j_spawn_signal_default SIGINT
 ||
-||            if (use_malloc)
+||            if (use_static)
 ||              {
-|                 mov c_arg1, allocsz
-|                 call extern g_malloc
+|                 lea c_arg2, [=>(j_tag_as_pc (&argv_tag))]
+|                 mov c_arg1, gpointer:c_arg2 [0]
 ||              }
 ||            else
 ||              {
-|                 sub rsp, allocsz
-|                 mov rax, rsp
-||              }
+|               sub rsp, allocsz
+|               mov c_arg1, rsp
+|               lea c_arg2, [=>(j_tag_as_pc (&argv_tag))]
+|               mov c_arg3, ((n_arguments + 1) * sizeof (gchar*))
+|               call extern memcpy
 ||
-||            for (j = 0; j < n_arguments; ++j)
-||              {
-|                 j_step_load_arg j, rcx
-|                 mov gpointer:Rq (use_malloc ? 0 : 4) [j], rcx
-||              }
+||                for (j = 0; j < n_arguments; ++j)
+||                if ((& invoke->target) [j].type != J_ARGUMENT_TYPE_DATA)
+||                  {
+|                     j_step_load_arg j, rcx
+|                     mov gpointer:rsp [j], rcx
+||                  }
 |
-|             mov qword gpointer:Rq (use_malloc ? 0 : 4) [n_arguments], 0
-|             mov c_arg1, gpointer:Rq (use_malloc ? 0 : 4) [0]
-|             lea c_arg2, gpointer:Rq (use_malloc ? 0 : 4) [0]
-|             lea c_arg3, tmperr
-|             call extern j_execvp
+|               mov c_arg1, gpointer:rsp [0]
+|               mov c_arg2, rsp
+||              }
 |
-|             mov c_arg1, error
-|             mov c_arg2, tmperr
-|             call extern g_propagate_error
-|             leave
-|             ret
+|             mov c_arg3, runner
+|             add c_arg3, J_RUNNER_VARIABLES_OFFSET
+|             mov c_arg3, JVariables:c_arg3->envp
+|             lea rtmp, report
+|             movsxd c_arg4, dword [rtmp + 4]
+|             call extern j_spawn_exec
 ||        }
 ||      else if (invoke->target_type == J_INVOKE_TARGET_TYPE_BUILTIN)
 ||        {
@@ -685,7 +1127,7 @@
 |                         jz >2
 |                           mov c_arg1, [rsp]
 |                           call extern g_error_free
-|                           leave
+|                           j_frame_leave
 |                           ret
 |                         2:
 |                           mov c_arg1, error
@@ -693,7 +1135,7 @@
 |                           call extern g_propagate_error
 |                           mov qword error, 0
 |                           j_step_adjust_io
-|                           leave
+|                           j_frame_leave
 |                           ret
 |                       1:
 |                         mov gpointer:rsp [1], rax
@@ -723,7 +1165,7 @@
 |                     call extern g_object_unref
 |
 |                     mov c_arg3, gpointer:rsp [1]
-|                     leave
+|                     j_frame_leave
 |
 ||                  /* Dirty trick */
 |                     pop rax
@@ -732,7 +1174,7 @@
 |                     call extern j_set_closure_error_irq
 |                     mov rax, self
 |                     j_step_branch_set_tag rax, tag_next
-|                     leave
+|                     j_frame_leave
 |                     mov rax, RetContinue
 |                     ret
 ||                }
@@ -741,7 +1183,7 @@
 ||            {
 ||              if (walker->n_pipes > 0 || invoke->n_arguments == 0)
 ||                {
-|                   j_step_fork_and_report 0
+|                   j_step_fork_or_settle 0
 ||                }
 ||              else
 ||                {
@@ -752,7 +1194,7 @@
 |                   mov c_arg2, tmperr
 |                   test c_arg2, c_arg2
 |                   jnz >1
-|                     j_step_fork_and_report 0
+|                     j_step_fork_or_settle 0
 |                   1:
 |                     sub rsp, #gpointer * 2
 |                     mov [rsp], c_arg2
@@ -762,7 +1204,7 @@
 |                     jz >1
 |                       mov c_arg1, [rsp]
 |                       call extern g_error_free
-|                       leave
+|                       j_frame_leave
 |                       ret
 |                     1:
 |                       mov c_arg1, error
@@ -770,10 +1212,19 @@
 |                       call extern g_propagate_error
 |                       mov qword error, 0
 |                       j_step_adjust_io
-|                       leave
+|                       j_frame_leave
 |                       ret
 ||                }
 ||            }
+||          else if (value == J_TOKEN_BUILTIN_DUMPJIT)
+||            {
+||              if (walker->n_pipes == 0)
+||                {
+|                   call extern j_dump_toggle
+||                }
+|
+|               j_step_fork_or_settle 0
+||            }
 ||          else if (value == J_TOKEN_BUILTIN_EXIT)
 ||            {
 ||              if (walker->n_pipes > 0)
@@ -785,8 +1236,6 @@
 ||                  if (invoke->n_arguments == 0)
 ||                    {
 |                       j_step_report 0
-|                       leave
-|                       ret
 ||                    }
 ||                  else
 ||                    {
@@ -798,8 +1247,6 @@
 |                       test c_arg2, c_arg2
 |                       jnz >1
 |                         j_step_report rax
-|                         leave
-|                         ret
 |                       1:
 |                         sub rsp, #gpointer * 2
 |                         mov [rsp], c_arg2
@@ -809,7 +1256,7 @@
 |                         jz >1
 |                           mov c_arg1, [rsp]
 |                           call extern g_error_free
-|                           leave
+|                           j_frame_leave
 |                           ret
 |                         1:
 |                           mov c_arg1, error
@@ -817,14 +1264,25 @@
 |                           call extern g_propagate_error
 |                           mov qword error, 0
 |                           j_step_adjust_io
-|                           leave
+|                           j_frame_leave
 |                           ret
 ||                    }
 ||                }
 ||            }
+||          else if (value == J_TOKEN_BUILTIN_EXPORT)
+||            {
+||              if (invoke->n_arguments > 0)
+||                {
+|                   j_step_load_arg 1, c_arg2
+|                   mov c_arg1, runner
+|                   call extern j_runner_variable_export
+||                }
+|
+|               j_step_fork_or_settle 0
+||            }
 ||          else if (value == J_TOKEN_BUILTIN_FALSE)
 ||            {
-|               j_step_fork_and_report 1
+|               j_step_fork_or_settle 1
 ||            }
 ||          else if (value == J_TOKEN_BUILTIN_FG)
 ||            {
@@ -833,15 +1291,16 @@
 |                   j_step_fork
 |                   test rax, rax
 |                   jz >1
-|                     leave
+|                     j_frame_leave
 |                     ret
 |                   1:
+|                     call extern j_closure_error_quark
 |                     mov c_arg1, error
-|                     mov c_arg2, J_CLOSURE_ERROR
+|                     mov c_arg2, rax
 |                     mov c_arg3, J_CLOSURE_ERROR_FAILED
-|                     lea c_arg4, [=>j_tag_once_string_as_pc (Dst, "fg ! (no job control)")]
+|                     j_load_string c_arg4, "fg ! (no job control)"
 |                     call extern g_set_error_literal
-|                     leave
+|                     j_frame_leave
 |                     ret
 ||                }
 ||              else
@@ -853,15 +1312,16 @@
 |                     j_step_fork
 |                     test rax, rax
 |                     jz >2
-|                       leave
+|                       j_frame_leave
 |                       ret
 |                     2:
+|                       call extern j_closure_error_quark
 |                       mov c_arg1, error
-|                       mov c_arg2, J_CLOSURE_ERROR
+|                       mov c_arg2, rax
 |                       mov c_arg3, J_CLOSURE_ERROR_FAILED
-|                       lea c_arg4, [=>j_tag_once_string_as_pc (Dst, "fg ! (no job control)")]
+|                       j_load_string c_arg4, "fg ! (no job control)"
 |                       call extern g_set_error_literal
-|                       leave
+|                       j_frame_leave
 |                       ret
 |                   1:
 ||
@@ -882,7 +1342,7 @@
 |                         jz >2
 |                           mov c_arg1, [rsp]
 |                           call extern g_error_free
-|                           leave
+|                           j_frame_leave
 |                           ret
 |                         2:
 |                           mov c_arg1, error
@@ -890,7 +1350,7 @@
 |                           call extern g_propagate_error
 |                           mov qword error, 0
 |                           j_step_adjust_io
-|                           leave
+|                           j_frame_leave
 |                           ret
 |                       1:
 ||                    }
@@ -914,28 +1374,32 @@
 |                     j_step_fork
 |                     test rax, rax
 |                     jz >2
-|                       leave
+|                       j_frame_leave
 |                       ret
 |                     2:
+|                       call extern j_closure_error_quark
 |                       mov c_arg1, error
-|                       mov c_arg2, J_CLOSURE_ERROR
+|                       mov c_arg2, rax
 |                       mov c_arg3, J_CLOSURE_ERROR_FAILED
-|                       lea c_arg4, [=>j_tag_once_string_as_pc (Dst, "fg ! (no such job)")]
+|                       j_load_string c_arg4, "fg ! (no such job)"
 |                       call extern g_set_error_literal
-|                       leave
+|                       j_frame_leave
 |                       ret
 |                   1:
-|                     mov c_arg3, rax
-|                     leave
+|                     sub rsp, #gpointer * 2
+|                     mov [rsp], rax
+|                     call extern j_closure_get_type
+|                     mov c_arg2, rax
+|                     mov c_arg3, [rsp]
+|                     j_frame_leave
 |
 ||                  /* Dirty trick */
 |                     pop rax
 |                     mov c_arg1, error
-|                     j_load_gtype c_arg2, J_TYPE_CLOSURE
 |                     call extern j_set_closure_error_irq
 |                     mov rax, self
 |                     j_step_branch_set_tag rax, tag_next
-|                     leave
+|                     j_frame_leave
 |                     mov rax, RetContinue
 |                     ret
 ||                }
@@ -951,7 +1415,7 @@
 |                   j_step_fork
 |                   test rax, rax
 |                   jz >1
-|                     leave
+|                     j_frame_leave
 |                     ret
 |                   1:
 |                     j_step_adjust_io
@@ -959,18 +1423,17 @@
 |                     mov c_arg1, runner
 |                     call extern j_runner_variable_print
 |                     j_step_report 0
-|                     leave
-|                     ret
 ||                }
 ||            }
 ||          else if (value == J_TOKEN_BUILTIN_HELP
 ||                || value == J_TOKEN_BUILTIN_HISTORY
-||                || value == J_TOKEN_BUILTIN_JOBS)
+||                || value == J_TOKEN_BUILTIN_JOBS
+||                || value == J_TOKEN_BUILTIN_STATS)
 ||            {
 |               j_step_fork
 |               test rax, rax
 |               jz >1
-|                 leave
+|                 j_frame_leave
 |                 ret
 |               1:
 |                 j_step_adjust_io
@@ -1006,11 +1469,14 @@
 |                     mov c_arg1, runner
 |                     call extern j_runner_job_print_all
 ||                  }
+||                else if (value == J_TOKEN_BUILTIN_STATS)
+||                  {
+|                     mov c_arg1, runner
+|                     call extern j_stats_print
+||                  }
 ||                else g_assert_not_reached ();
 |
 |                 j_step_report 0
-|                 leave
-|                 ret
 ||            }
 ||          else if (value == J_TOKEN_BUILTIN_SET)
 ||            {
@@ -1019,15 +1485,13 @@
 |                   j_step_fork
 |                   test rax, rax
 |                   jz >1
-|                     leave
+|                     j_frame_leave
 |                     ret
 |                   1:
 |                     j_step_adjust_io
 |                     mov c_arg1, runner
 |                     call extern j_runner_variable_print_all
 |                     j_step_report 0
-|                     leave
-|                     ret
 ||                }
 ||              else
 ||                {
@@ -1035,25 +1499,25 @@
 |                   j_step_load_arg 2, c_arg3
 |                   mov c_arg1, runner
 |                   call extern j_runner_variable_set
-|                   j_step_fork_and_report 0
+|                   j_step_fork_or_settle 0
 ||                }
 ||            }
 ||          else if (value == J_TOKEN_BUILTIN_TRUE)
 ||            {
-|               j_step_fork_and_report 0
+|               j_step_fork_or_settle 0
 ||            }
 ||          else if (value == J_TOKEN_BUILTIN_UNSET)
 ||            {
 ||              if (invoke->n_arguments == 0)
 ||                {
-|                   j_step_fork_and_report 0
+|                   j_step_fork_or_settle 0
 ||                }
 ||              else
 ||                {
 |                   j_step_load_arg 1, c_arg2
 |                   mov c_arg1, runner
 |                   call extern j_runner_variable_remove
-|                   j_step_fork_and_report 0
+|                   j_step_fork_or_settle 0
 ||                }
 ||            }
 ||          else g_assert_not_reached ();
@@ -1061,23 +1525,123 @@
 ||      else g_assert_not_reached ();
 ||    }
 ||
+||  J_VARARRAY_CLEAR (argument_strings);
 ||  J_VARARRAY_CLEAR (argument_tags);
 ||  J_VARARRAY_CLEAR (invocation_tags);
 ||}
 ||
-||void j_context_emit_test (Dst_DECL, const JTag* tag, const JTag* tag_direct, const JTag* tag_reverse)
+||void j_context_emit_loop (Dst_DECL, JWalker* walker, const JTag* tag, const JTag* tag_loop, const JTag* tag_body, const JTag* tag_next)
 ||{
-|=>(j_tag_as_pc (tag)):
-|   movsxd rax, dword JClosure:c_arg1->condition
-|   test rax, rax
+||  J_VARARRAY_DECL (argument_strings, const gchar*, 32);
+||  J_VARARRAY_INIT (argument_strings, j_walker_n_arguments (walker));
+||  J_VARARRAY_DECL (argument_tags, JTag, 32);
+||  J_VARARRAY_INIT (argument_tags, j_walker_n_arguments (walker));
+||
+||  JInvoke* invoke = j_walker_get_invoke (walker, 0);
+||  guint n_expansions = j_walker_n_expansions (walker);
+||  JTag intercept;
+||  guint i;
+||
+||  for (i = 0; i < j_walker_n_arguments (walker); ++i)
+||    {
+||      if (Dst->eager)
+||        j_tag_once_string (Dst, & argument_tags [i], j_walker_get_argument (walker, i));
+||      else
+||        argument_strings [i] = j_context_intern (Dst, j_walker_get_argument (walker, i));
+||    }
+||
+||  if (n_expansions > Dst->max_expansions)
+||    {
+||      Dst->max_expansions = n_expansions;
+||    }
+||
+||  if (n_expansions == 0)
+||    j_tag_copy (tag, &intercept);
+||  else
+||    {
+||      j_tag_init (Dst, &intercept);
+||      j_context_emit_chain_step_expansions (Dst, walker, tag, &intercept);
+||    }
+||
+||/*
+|| * Stack (should be 16-bytes aligned):
+|| * > saved rbx; (self lives there, argument #1)
+|| * > saved r15; (runner lives there, argument #2)
+|| * > GError** error; (argument #3)
+|| * before self goes other two 8-bytes slots
+|| * - return address (pushed by call, caller)
+|| * - frame pointer (pushed at function entry, callee)
+|| */
+||  gsize stacksize = 0
+|| + sizeof (JClosure*)
+|| + sizeof (JRunner*)
+|| + sizeof (GError**)
+||  ; stacksize += 16 - (stacksize % 16);
+||
+||/*
+|| * The words are snapshotted into a loop frame once, so
+|| * every iteration only pays for the loop_next step
+|| */
+||  j_context_mark (Dst, &intercept, "loop_enter");
+|=>(j_tag_as_pc (&intercept)):
+|   j_frame_enter stacksize
+|   mov error, c_arg3
+|   call extern j_closure_loop_enter
+||
+||  for (i = 1; i <= invoke->n_arguments; ++i)
+||    {
+|       j_step_load_arg i, c_arg2
+|       mov c_arg1, self
+|       call extern j_closure_loop_push
+||    }
+||
+|   mov rax, self
+|   mov dword JClosure:rax->condition, 0
+|   j_step_branch_jump tag_loop
+||
+||  j_context_mark (Dst, tag_loop, "loop_next");
+|=>(j_tag_as_pc (tag_loop)):
+|   j_frame_enter stacksize
+|   mov error, c_arg3
+|   j_step_load_arg 0, c_arg3
+|   call extern j_closure_loop_next
+|
+|   mov rcx, self
+|   mov dword JClosure:rcx->condition, 0
+|   test eax, eax
 |   jz >1
-|     j_step_branch_set_tag, c_arg1, tag_reverse
-|     mov rax, RetContinue
-|     ret
+|     j_step_branch_jump tag_body
 |   1:
-|     j_step_branch_set_tag, c_arg1, tag_direct
-|     mov rax, RetContinue
-|     ret
+|     j_step_branch_jump tag_next
+||
+||  J_VARARRAY_CLEAR (argument_strings);
+||  J_VARARRAY_CLEAR (argument_tags);
+||}
+||
+||void j_context_emit_test (Dst_DECL, guint site, const JTag* tag, const JTag* tag_direct, const JTag* tag_reverse)
+||{
+||  j_context_mark (Dst, tag, "test");
+|=>(j_tag_as_pc (tag)):
+|   mov eax, dword JClosure:c_arg1->condition
+|   mov dword JClosure:c_arg1->condition, 0
+||
+||  if (Dst->profiling == FALSE)
+||    {
+|     test eax, eax
+|     jnz =>(j_tag_as_pc (tag_reverse))
+|     jmp =>(j_tag_as_pc (tag_direct))
+||    }
+||  else
+||    {
+|     mov rtmp, JClosure:c_arg1->branches
+|     test eax, eax
+|     jnz >1
+|     add dword [rtmp + (site * 2 + 0) * 4], 1
+|     jmp =>(j_tag_as_pc (tag_direct))
+|1:
+|     add dword [rtmp + (site * 2 + 1) * 4], 1
+|     jmp =>(j_tag_as_pc (tag_reverse))
+||    }
 ||}
 ||
 ||void j_once_init_branch_fail (Dst_DECL)
@@ -1085,4 +1649,35 @@
 |   j_step_branch_put_last
 ||}
 ||
+||/*
+|| * Shared tails for the error checks, reached by a jump
+|| * from inside a step or invocation frame
+|| */
+||void j_once_init_stub_propagate (Dst_DECL)
+||{
+|   mov c_arg1, error
+|   call extern g_propagate_error
+|   j_frame_leave
+|   ret
+||}
+||
+||void j_once_init_stub_propagate_fail (Dst_DECL)
+||{
+|   mov c_arg1, error
+|   call extern g_propagate_error
+|   mov rax, self
+|   j_step_branch_set_fail rax
+|   j_frame_leave
+|   mov rax, RetRemove
+|   ret
+||}
+||
+||void j_once_init_stub_report (Dst_DECL)
+||{
+|   mov c_arg1, error
+|   call extern j_set_closure_error_exit
+|   j_frame_leave
+|   ret
+||}
+||
 #endif // __INTELLISENSE__
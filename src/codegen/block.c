@@ -19,7 +19,9 @@
 #ifdef G_OS_WIN32
 # include <windows.h>
 #else // !G_OS_WIN32
+# include <errno.h>
 # include <sys/mman.h>
+# include <unistd.h>
 # if !defined(MAP_ANONYMOUS) && defined(MAP_ANON)
 #   define MAP_ANONYMOUS MAP_ANON
 # endif // !MAP_ANONYMOUS && MAP_ANON
@@ -27,11 +29,23 @@
 
 static const JBlock __null = {0};
 
+/*
+ * Where the host allows it, code lives in a memfd mapped twice: the
+ * encoder writes through 'alias' (read-write) and the closure runs from
+ * 'ptr' (read-execute), so no page ever turns from writable to
+ * executable. j_block_protect () drops the writable view, or flips
+ * the single mapping when 'alias' is 'ptr'
+ */
+
 void j_block_clear (JBlock* block)
 {
+  if (block->ptr == NULL)
+    return;
 #ifdef G_OS_WIN32
   VirtualFree (block->ptr, block->sz, 0);
 #else // !G_OS_WIN32
+  if (block->alias != NULL && block->alias != block->ptr)
+    munmap (block->alias, block->sz);
   munmap (block->ptr, block->sz);
 #endif // G_OS_WIN32
   *block = __null;
@@ -39,10 +53,98 @@ void j_block_clear (JBlock* block)
 
 void j_block_init (JBlock* block, gsize sz)
 {
+  j_block_init_near (block, sz, NULL);
+}
+
+gpointer j_block_hint (gconstpointer near, gsize sz)
+{
+#ifdef G_OS_WIN32
+  gsize page = 65536;
+#else // !G_OS_WIN32
+  gsize page = (gsize) sysconf (_SC_PAGESIZE);
+#endif // G_OS_WIN32
+  gsize span = (sz + page - 1) & ~(page - 1);
+
+  /* Just below 'near', so rel32 references into it stay in range */
+  if (near == NULL || GPOINTER_TO_SIZE (near) <= span)
+    return NULL;
+return (guint8*) near - span;
+}
+
+#if HAVE_MEMFD_CREATE
+static gboolean dual_refused (gint errno_value)
+{
+  /* The host forbids it for good, anything else might pass next time */
+  switch (errno_value)
+    {
+      case EACCES:
+      case EINVAL:
+      case ENOSYS:
+      case EPERM:
+        return TRUE;
+      default:
+        return FALSE;
+    }
+}
+#endif // HAVE_MEMFD_CREATE
+
+static gboolean init_dual (JBlock* block, gsize sz, gpointer hint)
+{
+#if HAVE_MEMFD_CREATE
+  static gint unsupported = FALSE;
+  gpointer ptr = MAP_FAILED;
+  gpointer alias = MAP_FAILED;
+  guint flags = MFD_CLOEXEC;
+  gint fd = -1, e;
+
+  if (g_atomic_int_get (&unsupported))
+    return FALSE;
+#ifdef MFD_EXEC
+  flags |= MFD_EXEC;
+#endif // MFD_EXEC
+
+  if ((fd = memfd_create ("jash-jit", flags)) < 0)
+    {
+      if (dual_refused (errno))
+        g_atomic_int_set (&unsupported, TRUE);
+      return FALSE;
+    }
+
+  if (ftruncate (fd, sz) < 0)
+    return (close (fd), FALSE);
+
+  if ((ptr = mmap (hint, sz, PROT_READ | PROT_EXEC, MAP_SHARED, fd, 0)) == MAP_FAILED)
+    {
+      if (e = errno, close (fd), dual_refused (e))
+        g_atomic_int_set (&unsupported, TRUE);
+      return FALSE;
+    }
+
+  if ((alias = mmap (NULL, sz, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0)) == MAP_FAILED)
+    return (munmap (ptr, sz), close (fd), FALSE);
+
+  block->ptr = ptr;
+  block->alias = alias;
+  block->sz = sz;
+return (close (fd), TRUE);
+#else // !HAVE_MEMFD_CREATE
+return FALSE;
+#endif // HAVE_MEMFD_CREATE
+}
+
+void j_block_init_near (JBlock* block, gsize sz, gconstpointer near)
+{
+  gpointer hint = j_block_hint (near, sz);
 #if G_OS_WIN32
-  block->ptr = VirtualAlloc (0, block->sz = sz, MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE);
+  if ((block->ptr = VirtualAlloc (hint, block->sz = sz, MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE)) == NULL)
+    block->ptr = VirtualAlloc (0, block->sz = sz, MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE);
+  block->alias = block->ptr;
 #else // !G_OS_WIN32
-  block->ptr = mmap (0, block->sz = sz, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  if (init_dual (block, sz, hint) == FALSE)
+    {
+      block->ptr = mmap (hint, block->sz = sz, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+      block->alias = block->ptr;
+    }
 #endif // G_OS_WIN32
 }
 
@@ -56,6 +158,13 @@ void j_block_protect (JBlock* block)
     }
   G_STMT_END;
 #else // !G_OS_WIN32
-  mprotect (block->ptr, block->sz, PROT_READ | PROT_EXEC);
+  /* Dual mapped blocks are executable from the start, only the writable view has to go */
+  if (block->alias == block->ptr)
+    mprotect (block->ptr, block->sz, PROT_READ | PROT_EXEC);
+  else if (block->alias != NULL)
+    {
+      munmap (block->alias, block->sz);
+      block->alias = NULL;
+    }
 #endif // G_OS_WIN32
 }
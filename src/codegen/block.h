@@ -27,15 +27,20 @@ extern "C" {
   struct _JBlock
   {
     gpointer ptr;
+    gpointer alias;
     gsize sz;
   };
 
-  #define J_BLOCK_INIT { NULL, 0, }
+  #define J_BLOCK_INIT { NULL, NULL, 0, }
+  #define j_block_alias(block) (({ JBlock* __block = ((block)); __block->alias; }))
+  #define j_block_delta(block) (({ JBlock* __block = ((block)); (gssize) (__block->ptr - __block->alias); }))
   #define j_block_ptr(block) (({ JBlock* __block = ((block)); __block->ptr; }))
   #define j_block_sz(block) (({ JBlock* __block = ((block)); __block->sz; }))
 
   G_GNUC_INTERNAL void j_block_clear (JBlock* block);
+  G_GNUC_INTERNAL gpointer j_block_hint (gconstpointer near, gsize sz);
   G_GNUC_INTERNAL void j_block_init (JBlock* block, gsize sz);
+  G_GNUC_INTERNAL void j_block_init_near (JBlock* block, gsize sz, gconstpointer near);
   G_GNUC_INTERNAL void j_block_protect (JBlock* block);
 
 #if __cplusplus
@@ -55,7 +55,7 @@ void j_set_closure_error_done (GError** error, int value)
 #if DEVELOPER == 1
   error_pointer = g_error_new (J_CLOSURE_ERROR, J_CLOSURE_ERROR_DONE, "done %i", value);
 #else // !DEVELOPER
-  error_pointer = g_error_new_literal (J_CLOSURE_ERROR, J_CLOSURE_ERROR_IRQ, "done");
+  error_pointer = g_error_new_literal (J_CLOSURE_ERROR, J_CLOSURE_ERROR_DONE, "done");
 #endif // DEVELOPER
   error_value = j_closure_error_value (error_pointer);
 
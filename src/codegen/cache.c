@@ -0,0 +1,342 @@
+/* Copyright 2023 MarcosHCK
+ * This file is part of JASH.
+ *
+ * JASH is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * JASH is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with JASH. If not, see <http://www.gnu.org/licenses/>.
+ */
+#include <config.h>
+#include <codegen/cache.h>
+#include <codegen/codegen.h>
+#include <fcntl.h>
+#include <glib/gstdio.h>
+#ifndef G_OS_WIN32
+# include <sys/mman.h>
+# include <sys/stat.h>
+#endif // G_OS_WIN32
+
+#define J_CACHE_MAGIC "JASHJIT"
+#define J_CACHE_BUILD_ID_SIZE (64)
+typedef struct _JCacheHeader JCacheHeader;
+
+/*
+ * Entry layout (native byte order, the build id pins it to this binary):
+ * > encoded block (page aligned, copied into a fresh JBlock on load)
+ * > JReloc relocs [relocs_count]
+ * > guint64 detachables [detachables_size] (serialized trees)
+ * > JCacheHeader header (last bytes of the file)
+ */
+
+struct _JCacheHeader
+{
+  gchar magic [8];
+  gchar build_id [J_CACHE_BUILD_ID_SIZE];
+  guint64 block_base;
+  guint64 block_size;
+  guint64 entry;
+  guint64 max_expansions;
+  guint64 relocs_offset;
+  guint64 relocs_count;
+  guint64 detachables_offset;
+  guint64 detachables_count;
+  guint64 detachables_size;
+};
+
+enum
+{
+  NODE_TYPE = 0,
+  NODE_STRING = 1,
+  NODE_INTERN = 2,
+};
+
+G_STATIC_ASSERT (sizeof (JCacheHeader) % sizeof (guint64) == 0);
+G_STATIC_ASSERT (sizeof (JReloc) == sizeof (guint64));
+
+gchar* j_cache_key (const gchar* source, gsize length)
+{
+  GChecksum* checksum = g_checksum_new (G_CHECKSUM_SHA256);
+  const gchar* build_id = j_context_get_build_id ();
+  gchar* key = NULL;
+
+  g_checksum_update (checksum, (const guchar*) build_id, -1);
+  g_checksum_update (checksum, (const guchar*) source, length);
+  key = g_strdup (g_checksum_get_string (checksum));
+return (g_checksum_free (checksum), key);
+}
+
+static void tree_save (GArray* words, JAst* ast, JBlock* block)
+{
+  JAst* parent = j_ast_get_parent (ast);
+  JAst* child = NULL;
+  guint64 node [3];
+
+  if (parent == NULL || j_ast_get_ast_type (parent) != J_AST_TYPE_DATA)
+    {
+      node [0] = NODE_TYPE;
+      node [1] = (guint64) j_ast_get_ast_type (ast);
+    }
+  else
+    {
+      const guint8* begin = j_block_ptr (block);
+      const guint8* value = ast->data;
+
+      if (value >= begin && value < begin + j_block_sz (block))
+        {
+          node [0] = NODE_STRING;
+          node [1] = (guint64) (value - begin);
+        }
+      else
+        {
+          /* builtin names are compared by their interned address */
+          node [0] = NODE_INTERN;
+          node [1] = (guint64) strlen ((const gchar*) value);
+        }
+    }
+
+  node [2] = (guint64) j_ast_n_children (ast);
+  g_array_append_vals (words, node, G_N_ELEMENTS (node));
+
+  if (node [0] == NODE_INTERN)
+    {
+      guint first = words->len;
+      guint count = (node [1] + sizeof (guint64)) / sizeof (guint64);
+
+      g_array_set_size (words, first + count);
+      memcpy (& g_array_index (words, guint64, first), ast->data, node [1]);
+    }
+
+  for (child = j_ast_get_first_child (ast); child; child = j_ast_get_next_sibling (child))
+    tree_save (words, child, block);
+}
+
+static JAst* tree_load (const guint64* words, gsize n_words, gsize* position, gpointer base, gsize size)
+{
+  guint64 kind, value, n_children, i;
+  gpointer data = NULL;
+  JAst* ast = NULL;
+
+  if (*position + 3 > n_words)
+    return NULL;
+
+  kind = words [(*position)++];
+  value = words [(*position)++];
+  n_children = words [(*position)++];
+
+  switch (kind)
+    {
+      case NODE_TYPE:
+        data = GUINT_TO_POINTER ((guint) value);
+        break;
+      case NODE_STRING:
+        if (value >= size)
+          return NULL;
+        data = base + value;
+        break;
+      case NODE_INTERN:
+        {
+          gsize count = (value + sizeof (guint64)) / sizeof (guint64);
+
+          if (*position + count > n_words)
+            return NULL;
+          if (memchr (words + *position, 0, count * sizeof (guint64)) == NULL)
+            return NULL;
+
+          data = (gpointer) g_intern_string ((const gchar*) (words + *position));
+          *position += count;
+          break;
+        }
+      default: return NULL;
+    }
+
+  ast = g_node_new (data);
+
+  for (i = 0; i < n_children; ++i)
+    {
+      JAst* child;
+
+      if ((child = tree_load (words, n_words, position, base, size)) != NULL)
+        g_node_append (ast, child);
+      else
+        {
+          j_ast_free (ast);
+          return NULL;
+        }
+    }
+return ast;
+}
+
+gboolean j_cache_load (const gchar* filename, JCacheEntry* entry)
+{
+#ifdef G_OS_WIN32
+  return FALSE;
+#else // !G_OS_WIN32
+  const JCacheHeader* header = NULL;
+  const JReloc* relocs = NULL;
+  const guint64* words = NULL;
+  struct stat st = {0};
+  gpointer alias = NULL;
+  gpointer base = NULL;
+  gpointer file = NULL;
+  gsize position = 0;
+  gsize size = 0;
+  gint fd = -1;
+  guint i;
+
+  #define reject(reason) \
+    G_STMT_START \
+      { \
+        g_debug ("(" G_STRLOC "): %s: rejected (%s)", filename, (reason)); \
+        goto reject; \
+      } \
+    G_STMT_END
+
+  if ((fd = g_open (filename, O_RDONLY, 0)) < 0)
+    return FALSE;
+  if (fstat (fd, &st) < 0 || (gsize) st.st_size < sizeof (JCacheHeader))
+    return (g_close (fd, NULL), FALSE);
+
+  file = mmap (NULL, size = st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  g_close (fd, NULL);
+
+  if (G_UNLIKELY (file == MAP_FAILED))
+    return FALSE;
+
+  header = file + size - sizeof (JCacheHeader);
+
+  if (memcmp (header->magic, J_CACHE_MAGIC, sizeof (J_CACHE_MAGIC)) != 0)
+    reject ("bad magic");
+  if (memcmp (header->build_id, j_context_get_build_id (), J_CACHE_BUILD_ID_SIZE) != 0)
+    reject ("stale build id");
+  if (header->block_size > header->relocs_offset
+    || header->entry >= header->block_size
+    || header->relocs_offset + header->relocs_count * sizeof (JReloc) > header->detachables_offset
+    || header->detachables_offset + header->detachables_size * sizeof (guint64) > size - sizeof (JCacheHeader))
+    reject ("bad layout");
+
+  /* Copied out rather than mapped, so the code gets the same W^X treatment as freshly emitted code */
+  j_block_init_near (&entry->block, header->block_size, j_extern_arena ());
+  memcpy (alias = j_block_alias (&entry->block), file, header->block_size);
+  base = j_block_ptr (&entry->block);
+
+  relocs = file + header->relocs_offset;
+  words = file + header->detachables_offset;
+
+  for (i = 0; i < header->relocs_count; ++i)
+    {
+      const gchar* name = j_context_get_extern_name (relocs [i].index);
+      gpointer address = alias + relocs [i].offset;
+
+      if (relocs [i].index == J_RELOC_INDEX_BLOCK)
+        {
+          guint64 value = 0;
+
+          if (relocs [i].offset + sizeof (gpointer) > header->block_size)
+            reject ("bad relocation");
+
+          memcpy (&value, address, sizeof (guint64));
+
+          if (value < header->block_base || value - header->block_base >= header->block_size)
+            reject ("bad relocation");
+          else
+            {
+              value = GPOINTER_TO_SIZE (base) + (value - header->block_base);
+              memcpy (address, &value, sizeof (guint64));
+            }
+        }
+      else if (name == NULL || relocs [i].offset + sizeof (gint32) > header->block_size)
+        reject ("bad relocation");
+      else
+        {
+          gint32 value = j_extern_search (NULL, base + relocs [i].offset, relocs [i].index, name, relocs [i].type);
+          memcpy (address, &value, sizeof (gint32));
+        }
+    }
+
+  entry->detachables = g_new0 (JAst*, header->detachables_count);
+  entry->n_detachables = header->detachables_count;
+
+  for (i = 0; i < header->detachables_count; ++i)
+    {
+      if ((entry->detachables [i] = tree_load (words, header->detachables_size, &position, base, header->block_size)) == NULL)
+        reject ("bad detachable");
+    }
+
+  entry->entry = header->entry;
+  entry->max_expansions = header->max_expansions;
+  munmap (file, size);
+  #undef reject
+return TRUE;
+reject:
+  for (i = 0; i < entry->n_detachables; ++i)
+    if (entry->detachables [i] != NULL)
+      j_ast_free (entry->detachables [i]);
+
+  g_clear_pointer (&entry->detachables, g_free);
+  entry->n_detachables = 0;
+  j_block_clear (&entry->block);
+  munmap (file, size);
+return FALSE;
+#endif // G_OS_WIN32
+}
+
+gboolean j_cache_store (const gchar* filename, JCacheEntry* entry, GError** error)
+{
+  static const guint8 padding [sizeof (guint64)] = {0};
+  GByteArray* bytes = g_byte_array_sized_new (j_block_sz (&entry->block) + sizeof (JCacheHeader));
+  GArray* words = g_array_new (FALSE, TRUE, sizeof (guint64));
+  JCacheHeader header = {0};
+  gchar* dirname = NULL;
+  gboolean result;
+  guint i;
+
+  #define align() \
+    G_STMT_START \
+      { \
+        guint __rest = bytes->len % sizeof (guint64); \
+        if (__rest > 0) \
+          g_byte_array_append (bytes, padding, sizeof (guint64) - __rest); \
+      } \
+    G_STMT_END
+
+  for (i = 0; i < entry->n_detachables; ++i)
+    tree_save (words, entry->detachables [i], &entry->block);
+
+  memcpy (header.magic, J_CACHE_MAGIC, sizeof (J_CACHE_MAGIC));
+  memcpy (header.build_id, j_context_get_build_id (), J_CACHE_BUILD_ID_SIZE);
+  header.block_base = GPOINTER_TO_SIZE (j_block_ptr (&entry->block));
+  header.block_size = j_block_sz (&entry->block);
+  header.entry = entry->entry;
+  header.max_expansions = entry->max_expansions;
+
+  g_byte_array_append (bytes, j_block_ptr (&entry->block), j_block_sz (&entry->block));
+  align ();
+
+  header.relocs_offset = bytes->len;
+  header.relocs_count = entry->n_relocs;
+  g_byte_array_append (bytes, (const guint8*) entry->relocs, entry->n_relocs * sizeof (JReloc));
+
+  header.detachables_offset = bytes->len;
+  header.detachables_count = entry->n_detachables;
+  header.detachables_size = words->len;
+  g_byte_array_append (bytes, (const guint8*) words->data, words->len * sizeof (guint64));
+  g_byte_array_append (bytes, (const guint8*) &header, sizeof (JCacheHeader));
+  #undef align
+
+  dirname = g_path_get_dirname (filename);
+  g_mkdir_with_parents (dirname, 0700);
+  g_free (dirname);
+
+  result = g_file_set_contents (filename, (const gchar*) bytes->data, bytes->len, error);
+  g_byte_array_unref (bytes);
+  g_array_unref (words);
+return result;
+}
@@ -0,0 +1,48 @@
+/* Copyright 2023 MarcosHCK
+ * This file is part of JASH.
+ *
+ * JASH is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * JASH is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with JASH. If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef __JASH_CODEGEN_CACHE__
+#define __JASH_CODEGEN_CACHE__ 1
+#include <codegen/block.h>
+#include <codegen/context.h>
+#include <parser/ast.h>
+
+typedef struct _JCacheEntry JCacheEntry;
+
+#if __cplusplus
+extern "C" {
+#endif // __cplusplus
+
+  struct _JCacheEntry
+  {
+    JBlock block;
+    gsize entry;
+    guint max_expansions;
+    JReloc* relocs;
+    guint n_relocs;
+    JAst** detachables;
+    guint n_detachables;
+  };
+
+  G_GNUC_INTERNAL gchar* j_cache_key (const gchar* source, gsize length);
+  G_GNUC_INTERNAL gboolean j_cache_load (const gchar* filename, JCacheEntry* entry);
+  G_GNUC_INTERNAL gboolean j_cache_store (const gchar* filename, JCacheEntry* entry, GError** error);
+
+#if __cplusplus
+}
+#endif // __cplusplus
+
+#endif // __JASH_CODEGEN_CACHE__
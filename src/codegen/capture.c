@@ -0,0 +1,200 @@
+/* Copyright 2023 MarcosHCK
+ * This file is part of JASH.
+ *
+ * JASH is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * JASH is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with JASH. If not, see <http://www.gnu.org/licenses/>.
+ */
+#include <config.h>
+#include <codegen/capture.h>
+#include <codegen/context.h>
+#include <codegen/vararray.h>
+#include <errno.h>
+#include <glib/gstdio.h>
+#include <poll.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#define J_CAPTURE_CHUNK (4096)
+static const JCapture __null = J_CAPTURE_INIT;
+
+void j_capture_clear (JCapture* capture)
+{
+  g_free (capture->data);
+
+  if (capture->spill >= 0)
+    g_close (capture->spill, NULL);
+  *capture = __null;
+}
+
+void j_capture_init (JCapture* capture)
+{
+  *capture = __null;
+}
+
+static gint spill_open (GError** error)
+{
+  gchar* filename = NULL;
+  gint fd = -1;
+#if HAVE_MEMFD_CREATE
+  if ((fd = memfd_create ("jash-capture", MFD_CLOEXEC)) >= 0)
+    return fd;
+#endif // HAVE_MEMFD_CREATE
+  if ((fd = g_file_open_tmp ("jash-capture-XXXXXX", &filename, error)) >= 0)
+    {
+      g_unlink (filename);
+      g_free (filename);
+    }
+return fd;
+}
+
+static gboolean spill_write (gint fd, const gchar* data, gsize length, GError** error)
+{
+  gssize done = 0;
+
+  while (length > 0)
+    {
+      if ((done = write (fd, data, length)) < 0)
+        {
+          if (errno == EINTR)
+            continue;
+
+          j_set_closure_error_pipe (error, errno, "write ()!");
+          return FALSE;
+        }
+
+      data += done;
+      length -= done;
+    }
+return TRUE;
+}
+
+/* Returns FALSE once 'fd' hits end-of-file (or fails) */
+static gboolean capture_read (JCapture* capture, gint fd, GError** error)
+{
+  GError* tmperr = NULL;
+  gssize done = 0;
+
+  if (capture->allocated - capture->length < J_CAPTURE_CHUNK)
+    {
+      if (capture->spill < 0 && capture->allocated >= J_CAPTURE_SPILL)
+        {
+          if ((capture->spill = spill_open (&tmperr)), G_UNLIKELY (tmperr != NULL))
+            {
+              g_propagate_error (error, tmperr);
+              return FALSE;
+            }
+        }
+
+      if (capture->spill >= 0)
+        {
+          if (!spill_write (capture->spill, capture->data, capture->length, error))
+            return FALSE;
+          capture->length = 0;
+        }
+      else
+        {
+          capture->allocated = MAX (capture->allocated * 2, J_CAPTURE_CHUNK);
+          capture->data = g_realloc (capture->data, capture->allocated);
+        }
+    }
+
+  do done = read (fd, capture->data + capture->length, capture->allocated - capture->length);
+  while (done < 0 && errno == EINTR);
+
+  if (done < 0)
+    j_set_closure_error_pipe (error, errno, "read ()!");
+  else
+    capture->length += done;
+return done > 0;
+}
+
+gboolean j_capture_drain (JCapture* captures, gint* fds, guint n_captures, gint timeout, GError** error)
+{
+  J_VARARRAY_DECL (pollfds, struct pollfd, 8);
+  J_VARARRAY_INIT (pollfds, n_captures);
+  GError* tmperr = NULL;
+  guint i, n_open = 0;
+
+  /* poll() skips negative descriptors, so closed slots stay in place */
+  for (i = 0; i < n_captures; ++i)
+    {
+      pollfds [i].fd = fds [i];
+      pollfds [i].events = POLLIN;
+      pollfds [i].revents = 0;
+      n_open += (fds [i] >= 0) ? 1 : 0;
+    }
+
+  if (n_open > 0 && poll (pollfds, n_captures, timeout) > 0)
+  for (i = 0; i < n_captures; ++i)
+  if ((pollfds [i].revents & (POLLIN | POLLHUP | POLLERR)) != 0)
+    {
+      if (!capture_read (& captures [i], fds [i], &tmperr))
+        {
+          g_close (fds [i], NULL);
+          fds [i] = -1;
+
+          if (G_UNLIKELY (tmperr != NULL))
+            {
+              g_propagate_error (error, tmperr);
+              break;
+            }
+        }
+    }
+
+  J_VARARRAY_CLEAR (pollfds);
+return n_open == 0;
+}
+
+gchar* j_capture_finish (JCapture* capture, gint* fd, GError** error)
+{
+  GError* tmperr = NULL;
+  gchar* value = NULL;
+  goffset size = 0;
+
+  if (*fd >= 0)
+    {
+      while (capture_read (capture, *fd, &tmperr));
+
+      g_close (*fd, NULL);
+      *fd = -1;
+
+      if (G_UNLIKELY (tmperr != NULL))
+        {
+          g_propagate_error (error, tmperr);
+          return (j_capture_clear (capture), NULL);
+        }
+    }
+
+  if (capture->spill < 0)
+    {
+      value = g_realloc (capture->data, capture->length + 1);
+      value [capture->length] = '\0';
+      capture->data = NULL;
+    }
+  else
+    {
+      if (!spill_write (capture->spill, capture->data, capture->length, error))
+        return (j_capture_clear (capture), NULL);
+
+      value = g_malloc ((size = lseek (capture->spill, 0, SEEK_END)) + 1);
+
+      if (pread (capture->spill, value, size, 0) != size)
+        {
+          j_set_closure_error_pipe (error, errno, "pread ()!");
+          return (g_free (value), j_capture_clear (capture), NULL);
+        }
+
+      value [size] = '\0';
+    }
+return (j_capture_clear (capture), value);
+}
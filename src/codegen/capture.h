@@ -0,0 +1,47 @@
+/* Copyright 2023 MarcosHCK
+ * This file is part of JASH.
+ *
+ * JASH is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * JASH is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with JASH. If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef __JASH_CODEGEN_CAPTURE__
+#define __JASH_CODEGEN_CAPTURE__ 1
+#include <glib.h>
+
+typedef struct _JCapture JCapture;
+
+#define J_CAPTURE_INIT { NULL, 0, 0, -1, }
+#define J_CAPTURE_SPILL (1 << 20)
+
+#if __cplusplus
+extern "C" {
+#endif // __cplusplus
+
+  struct _JCapture
+  {
+    gchar* data;
+    gsize length;
+    gsize allocated;
+    gint spill;
+  };
+
+  G_GNUC_INTERNAL void j_capture_clear (JCapture* capture);
+  G_GNUC_INTERNAL gboolean j_capture_drain (JCapture* captures, gint* fds, guint n_captures, gint timeout, GError** error);
+  G_GNUC_INTERNAL gchar* j_capture_finish (JCapture* capture, gint* fd, GError** error);
+  G_GNUC_INTERNAL void j_capture_init (JCapture* capture);
+
+#if __cplusplus
+}
+#endif // __cplusplus
+
+#endif // __JASH_CODEGEN_CAPTURE__
@@ -17,12 +17,17 @@
 #ifndef __JASH_CODEGEN_CLOSURE__
 #define __JASH_CODEGEN_CLOSURE__ 1
 #include <codegen/block.h>
+#include <codegen/capture.h>
+#include <codegen/codegen.h>
 #if DEVELOPER == 1
 # include <codegen/debug/gdb.h>
 #endif // DEVELOPER
 #include <runtime/runner.h>
 
 typedef struct _JClosure JClosure;
+typedef struct _JLazy JLazy;
+typedef struct _JLoop JLoop;
+typedef struct _JProfile JProfile;
 typedef gint JPipeEnd;
 
 typedef enum
@@ -46,6 +51,14 @@ typedef enum
   J_CLOSURE_STATUS_WAITING = (1 << 2),
 } JClosureStatus;
 
+typedef enum
+{
+  J_PROFILE_STATE_RECORDING,
+  J_PROFILE_STATE_COMPILING,
+  J_PROFILE_STATE_READY,
+  J_PROFILE_STATE_DONE,
+} JProfileState;
+
 typedef JClosureStatus (*JClosureCallback) (JClosure* closure, JRunner* runner, GError** error);
 
 #if __cplusplus
@@ -56,10 +69,20 @@ extern "C" {
   {
     GClosure closure;
     JBlock block;
+    guint* branches;
+    guint branches_count;
     gboolean condition;
     gpointer* detachables;
     guint detachables_count;
     JClosureCallback entry;
+    JClosureCallback head;
+    JLazy* lazies;
+    guint lazies_count;
+    GQueue loops;
+    JProfile* profile;
+    gchar** strings;
+    guint strings_count;
+    JCapture* expansion_captures;
     JPipeEnd* expansion_pipes;
     gchar** expansion_values;
     guint expansions_count;
@@ -69,7 +92,41 @@ extern "C" {
 #endif // DEVELOPER
   };
 
+  struct _JLazy
+  {
+    JAst* ast;
+    JBlock block;
+    gpointer continuation;
+    JClosureCallback entry;
+  };
+
+  struct _JLoop
+  {
+    GPtrArray* values;
+    guint index;
+  };
+
+  struct _JProfile
+  {
+    JAst* ast;
+    guint* branches;
+    guint branches_count;
+    JClosure* relaid;
+    guint runs;
+    gint state;
+  };
+
+  #define J_PROFILE_THRESHOLD (16)
+
+  G_GNUC_INTERNAL void j_closure_capture (JClosure* closure, guint index, GError** error);
+  G_GNUC_INTERNAL JClosure* j_closure_new (JCodegen* codegen, gsize closure_size, guint max_expansions);
   G_GNUC_INTERNAL void j_closure_kill (JClosure* closure);
+  G_GNUC_INTERNAL JClosureStatus j_closure_lazy (JClosure* closure, JRunner* runner, GError** error, guint index);
+  G_GNUC_INTERNAL void j_closure_loop_enter (JClosure* closure);
+  G_GNUC_INTERNAL gboolean j_closure_loop_next (JClosure* closure, JRunner* runner, const gchar* name);
+  G_GNUC_INTERNAL void j_closure_loop_push (JClosure* closure, const gchar* value);
+  G_GNUC_INTERNAL void j_closure_rewind (JClosure* closure);
+  G_GNUC_INTERNAL JClosureStatus j_closure_step (JClosure* closure, JRunner* runner, GError** error);
   G_GNUC_INTERNAL void j_closure_stop (JClosure* closure);
   G_GNUC_INTERNAL void j_closure_term (JClosure* closure);
 
@@ -15,9 +15,11 @@
  * along with JASH. If not, see <http://www.gnu.org/licenses/>.
  */
 #include <config.h>
+#include <codegen/cache.h>
 #include <codegen/closure.h>
 #include <codegen/codegen.h>
 #include <codegen/context.h>
+#include <codegen/debug/stats.h>
 #include <codegen/externs.h>
 #if DEVELOPER == 1
 # include <codegen/debug/gdb.h>
@@ -33,12 +35,16 @@ typedef struct _JCodegenClass JCodegenClass;
 #define _j_ast_free0(var) ((var == NULL) ? NULL : (var = (j_ast_free (var), NULL)))
 typedef struct _GValue JClosureErrorPrivate;
 static void j_closure_error_private_init (JClosureErrorPrivate* priv);
+static void closure_relayout (JClosure* jc);
+static GClosure* codegen_emit (JCodegen* self, JAst* ast, const gchar* cache_key, gboolean profiling, JProfile* profile, GError** error);
+static void profile_free (JProfile* profile);
 #define j_closure_error_private_copy g_value_copy
 #define j_closure_error_private_clear g_value_unset
 
 struct _JCodegen
 {
   GObject parent;
+  gchar* cache_dir;
 };
 
 struct _JCodegenClass
@@ -51,6 +57,15 @@ G_DEFINE_EXTENDED_ERROR (JClosureError, j_closure_error);
 G_DEFINE_FINAL_TYPE (JCodegen, j_codegen, G_TYPE_OBJECT);
 G_DEFINE_QUARK (j-codegen-error-quark, j_codegen_error);
 
+enum
+{
+  prop_0,
+  prop_cache_dir,
+  prop_number,
+};
+
+static GParamSpec* properties [prop_number] = {0};
+
 static void j_closure_error_private_init (JClosureErrorPrivate* priv)
 {
 #ifdef HAVE_MEMSET
@@ -61,7 +76,56 @@ static void j_closure_error_private_init (JClosureErrorPrivate* priv)
 #endif // HAVE_MEMSET
 }
 
-static void j_codegen_class_init (JCodegenClass* klass) { }
+static void j_codegen_class_finalize (GObject* pself)
+{
+  JCodegen* self = (gpointer) pself;
+  _g_free0 (self->cache_dir);
+G_OBJECT_CLASS (j_codegen_parent_class)->finalize (pself);
+}
+
+static void j_codegen_class_get_property (GObject* pself, guint property_id, GValue* value, GParamSpec* pspec)
+{
+  JCodegen* self = (gpointer) pself;
+
+  switch (property_id)
+  {
+    case prop_cache_dir:
+      g_value_set_string (value, self->cache_dir);
+      break;
+    default:
+      G_OBJECT_WARN_INVALID_PROPERTY_ID (pself, property_id, pspec);
+      break;
+  }
+}
+
+static void j_codegen_class_set_property (GObject* pself, guint property_id, const GValue* value, GParamSpec* pspec)
+{
+  JCodegen* self = (gpointer) pself;
+
+  switch (property_id)
+  {
+    case prop_cache_dir:
+      g_free (self->cache_dir);
+      self->cache_dir = g_value_dup_string (value);
+      break;
+    default:
+      G_OBJECT_WARN_INVALID_PROPERTY_ID (pself, property_id, pspec);
+      break;
+  }
+}
+
+static void j_codegen_class_init (JCodegenClass* klass)
+{
+  G_OBJECT_CLASS (klass)->finalize = j_codegen_class_finalize;
+  G_OBJECT_CLASS (klass)->get_property = j_codegen_class_get_property;
+  G_OBJECT_CLASS (klass)->set_property = j_codegen_class_set_property;
+
+  const guint flags1 = G_PARAM_STATIC_STRINGS | G_PARAM_READWRITE;
+
+  properties [prop_cache_dir] = g_param_spec_string ("cache-dir", "cache-dir", "cache-dir", NULL, flags1);
+  g_object_class_install_properties (G_OBJECT_CLASS (klass), prop_number, properties);
+}
+
 static void j_codegen_init (JCodegen* self) { }
 
 JCodegen* j_codegen_new ()
@@ -69,6 +133,12 @@ JCodegen* j_codegen_new ()
   return g_object_new (J_TYPE_CODEGEN, NULL);
 }
 
+const gchar* j_codegen_get_cache_dir (JCodegen* codegen)
+{
+  g_return_val_if_fail (J_IS_CODEGEN (codegen), NULL);
+  return codegen->cache_dir;
+}
+
 GValue* j_closure_error_value (const GError* error)
 {
   return j_closure_error_get_private (error);
@@ -102,6 +172,26 @@ void j_closure_stop (JClosure* closure)
   closure_kill (closure, SIGSTOP);
 }
 
+static void loop_free (JLoop* loop)
+{
+  g_ptr_array_unref (loop->values);
+  g_slice_free (JLoop, loop);
+}
+
+void j_closure_rewind (JClosure* closure)
+{
+  g_return_if_fail (closure != NULL);
+  g_return_if_fail (closure->head != NULL);
+
+  if (closure->profile != NULL)
+    closure_relayout (closure);
+
+  closure->condition = 0;
+  closure->entry = closure->head;
+  g_queue_clear_full (&closure->loops, (GDestroyNotify) loop_free);
+  g_queue_clear (&closure->waitq);
+}
+
 void j_closure_term (JClosure* closure)
 {
   g_return_if_fail (closure != NULL);
@@ -112,32 +202,63 @@ static void closure_nofity (gpointer __null__, JClosure* jc)
 {
   guint i;
 #if DEVELOPER == 1
-  j_gdb_unregister (jc->debug_object);
-  j_gdb_free (jc->debug_object);
+  if (jc->debug_object != NULL)
+    {
+      j_gdb_unregister (jc->debug_object);
+      j_gdb_free (jc->debug_object);
+    }
 #endif // DEVELOPER
 
   for (i = 0; i < jc->expansions_count; ++i)
-    _g_free0 (jc->expansion_values [i]);
+    {
+      _g_free0 (jc->expansion_values [i]);
+      j_capture_clear (& jc->expansion_captures [i]);
+
+      if (jc->expansion_pipes [i] >= 0)
+        g_close (jc->expansion_pipes [i], NULL);
+    }
+   _g_free0 (jc->expansion_captures);
    _g_free0 (jc->expansion_values);
    _g_free0 (jc->expansion_pipes);
   for (i = 0; i < jc->detachables_count; ++i)
     _j_ast_free0 (jc->detachables [i]);
+   _g_free0 (jc->detachables);
+  for (i = 0; i < jc->lazies_count; ++i)
+    {
+      _j_ast_free0 (jc->lazies [i].ast);
+      j_block_clear (& jc->lazies [i].block);
+    }
+   _g_free0 (jc->lazies);
+  g_queue_clear_full (&jc->loops, (GDestroyNotify) loop_free);
+  for (i = 0; i < jc->strings_count; ++i)
+    g_ref_string_release (jc->strings [i]);
+   _g_free0 (jc->strings);
 
   g_queue_clear (&jc->waitq);
+  _g_free0 (jc->branches);
+  g_clear_pointer (&jc->profile, profile_free);
   j_block_clear (&jc->block);
 }
 
-static void closure_marshal (JClosure* jc, GValue* return_value, guint n_param_values, const GValue* param_values)
+JClosureStatus j_closure_step (JClosure* closure, JRunner* runner, GError** error)
 {
-  g_return_if_fail (return_value != NULL);
-  g_return_if_fail (n_param_values == 2);
-  g_return_if_fail (param_values != NULL);
-  GClosure* gc = (gpointer) jc;
-  JRunner* runner = g_value_get_object (param_values + 0);
-  GError** error = g_value_get_pointer (param_values + 1);
+  g_return_val_if_fail (closure != NULL, J_CLOSURE_STATUS_REMOVE);
+  g_return_val_if_fail (J_IS_RUNNER (runner), J_CLOSURE_STATUS_REMOVE);
+  JClosure* jc = (closure);
+  JClosureStatus next;
   GError* tmperr = NULL;
   GList* link;
 
+  if (jc->waitq.length > 0 && jc->expansions_count > 0)
+    {
+      /* Keep expansion children from blocking on a full pipe while they are waited for */
+      if ((j_capture_drain (jc->expansion_captures, jc->expansion_pipes, jc->expansions_count, 0, &tmperr)), G_UNLIKELY (tmperr != NULL))
+        {
+          g_propagate_error (error, tmperr);
+          return J_CLOSURE_STATUS_REMOVE;
+        }
+    }
+
   while ((link = g_queue_peek_head_link (&jc->waitq)) != NULL)
     {
       gint pid = GPOINTER_TO_INT (link->data);
@@ -146,16 +267,14 @@ static void closure_marshal (JClosure* jc, GValue* return_value, guint n_param_v
       if ((result = j_waitpid (pid, &status, WNOHANG, &tmperr)), G_UNLIKELY (tmperr != NULL))
         {
           g_propagate_error (error, tmperr);
-          g_value_set_int (return_value, J_CLOSURE_STATUS_REMOVE);
-          return;
+          return J_CLOSURE_STATUS_REMOVE;
         }
       else
         {
           if (result == 0)
             {
               /* Still running */
-              g_value_set_int (return_value, J_CLOSURE_STATUS_WAITING);
-              return;
+              return J_CLOSURE_STATUS_WAITING;
             }
           else
             {
@@ -170,13 +289,30 @@ static void closure_marshal (JClosure* jc, GValue* return_value, guint n_param_v
         }
     }
 
-  g_value_set_int (return_value, jc->entry (jc, runner, error));
+  next = jc->entry (jc, runner, error);
   jc->condition = 0;
+return next;
+}
+
+static void closure_marshal (JClosure* jc, GValue* return_value, guint n_param_values, const GValue* param_values)
+{
+  g_return_if_fail (return_value != NULL);
+  g_return_if_fail (n_param_values == 2);
+  g_return_if_fail (param_values != NULL);
+  JRunner* runner = g_value_get_object (param_values + 0);
+  GError** error = g_value_get_pointer (param_values + 1);
+  g_value_set_int (return_value, j_closure_step (jc, runner, error));
+}
+
+static gboolean detachable_is_builtin (JAst* ast)
+{
+  JAst* parent = j_ast_get_parent (ast);
+return parent != NULL && j_ast_get_ast_type (parent) == J_AST_TYPE_BUILTIN;
 }
 
 static gboolean detachable_link (JAst* ast, Dst_DECL)
 {
-  if (j_ast_get_ast_type (ast) == J_AST_TYPE_DATA)
+  if (j_ast_get_ast_type (ast) == J_AST_TYPE_DATA && !detachable_is_builtin (ast))
     {
       JAst* child;
       JTag tag;
@@ -185,87 +321,309 @@ static gboolean detachable_link (JAst* ast, Dst_DECL)
 #endif // DEVELOPER
       child = j_ast_get_first_child (ast);
 
-      j_tag_once_string (Dst, &tag, child->data);
-      j_tag_copy (&tag, &child->data);
+      if (Dst->eager == FALSE)
+        child->data = (gpointer) j_context_intern (Dst, child->data);
+      else
+        {
+          j_tag_once_string (Dst, &tag, child->data);
+          j_tag_copy (&tag, &child->data);
+        }
     }
 return FALSE;
 }
 
 static gboolean detachable_encode (JAst* ast, gpointer* data)
 {
-  if (j_ast_get_ast_type (ast) == J_AST_TYPE_DATA)
+  if (j_ast_get_ast_type (ast) == J_AST_TYPE_DATA && !detachable_is_builtin (ast))
     {
       JContext* Dst = data [0];
-      JClosure* jc = data [1];
+      gpointer base = data [1];
       JAst* child;
       JTag tag;
 
       child = j_ast_get_first_child (ast);
-      child->data = j_tag_as_offset (Dst, &child->data) + j_block_ptr (&jc->block);
+
+      if (Dst->eager == TRUE)
+        child->data = j_tag_as_offset (Dst, &child->data) + base;
     }
 return FALSE;
 }
 
-GClosure* j_codegen_emit (JCodegen* codegen, JAst* ast, GError** error)
+static void trees_link (Dst_DECL)
 {
-  g_return_val_if_fail (J_IS_CODEGEN (codegen), NULL);
-  g_return_val_if_fail (ast != NULL, NULL);
-  g_return_val_if_fail (error == NULL || *error == NULL, NULL);
-  JCodegen* self = (codegen);
-  JContext context = {0};
+  const GTraverseType order = (GTraverseType) G_PRE_ORDER;
+  const GTraverseFlags flags = (GTraverseFlags) G_TRAVERSE_NON_LEAVES;
+  const GNodeTraverseFunc func = (GNodeTraverseFunc) detachable_link;
+  GList* list;
+
+  for (list = g_queue_peek_head_link (&Dst->detachables); list; list = list->next)
+    {
+      list->data = j_ast_copy (list->data);
+      g_node_traverse (list->data, order, flags, -1, func, Dst);
+    }
+
+  for (list = g_queue_peek_head_link (&Dst->lazies); list; list = list->next)
+    {
+      JLazyStub* stub = list->data;
+      stub->ast = j_ast_copy (stub->ast);
+      g_node_traverse (stub->ast, order, flags, -1, func, Dst);
+    }
+}
+
+static void trees_clear (Dst_DECL)
+{
+  JLazyStub* stub;
+
+  g_queue_clear_full (&Dst->detachables, (GDestroyNotify) g_node_destroy);
+
+  while ((stub = g_queue_pop_head (&Dst->lazies)) != NULL)
+    {
+      j_ast_free (stub->ast);
+      g_slice_free (JLazyStub, stub);
+    }
+}
+
+static void strings_adopt (JClosure* jc, Dst_DECL)
+{
+  GHashTableIter iter;
+  gpointer string;
+  guint i;
+
+  if (g_hash_table_size (Dst->strings) > 0)
+    {
+      i = jc->strings_count;
+      jc->strings_count += g_hash_table_size (Dst->strings);
+      jc->strings = g_renew (gchar*, jc->strings, jc->strings_count);
+
+      g_hash_table_iter_init (&iter, Dst->strings);
+
+      while (g_hash_table_iter_next (&iter, &string, NULL))
+        {
+          jc->strings [i++] = string;
+          g_hash_table_iter_steal (&iter);
+        }
+    }
+}
+
+static void trees_adopt (JClosure* jc, Dst_DECL, gpointer base)
+{
+  const GTraverseType order = (GTraverseType) G_PRE_ORDER;
+  const GTraverseFlags flags = (GTraverseFlags) G_TRAVERSE_NON_LEAVES;
+  const GNodeTraverseFunc func = (GNodeTraverseFunc) detachable_encode;
+  gpointer data [] = { Dst, base, };
+  JLazyStub* stub;
+  GList* list;
+  guint i;
+
+  if (Dst->detachables.length > 0)
+    {
+      i = jc->detachables_count;
+      jc->detachables_count += Dst->detachables.length;
+      jc->detachables = g_renew (gpointer, jc->detachables, jc->detachables_count);
+
+      for (list = g_queue_peek_head_link (&Dst->detachables); list; list = list->next, ++i)
+        {
+          jc->detachables [i] = list->data;
+          g_node_traverse (list->data, order, flags, -1, func, data);
+        }
+
+      g_queue_clear (&Dst->detachables);
+    }
+
+  if (Dst->lazies.length > 0)
+    {
+      i = jc->lazies_count;
+      jc->lazies_count += Dst->lazies.length;
+      jc->lazies = g_renew (JLazy, jc->lazies, jc->lazies_count);
+
+      for (; (stub = g_queue_pop_head (&Dst->lazies)) != NULL; ++i)
+        {
+          JLazy* lazy = & jc->lazies [i];
+
+          g_node_traverse (stub->ast, order, flags, -1, func, data);
+
+          lazy->ast = stub->ast;
+          lazy->block.ptr = NULL;
+          lazy->block.alias = NULL;
+          lazy->block.sz = 0;
+          lazy->continuation = j_tag_as_offset (Dst, &stub->tag_next) + base;
+          lazy->entry = NULL;
+          g_slice_free (JLazyStub, stub);
+        }
+    }
+}
+
+static void closure_grow (JClosure* jc, guint max_expansions)
+{
+  guint i;
+
+  if (max_expansions > jc->expansions_count)
+    {
+      jc->expansion_captures = g_renew (JCapture, jc->expansion_captures, max_expansions);
+      jc->expansion_pipes = g_renew (JPipeEnd, jc->expansion_pipes, max_expansions);
+      jc->expansion_values = g_renew (gchar*, jc->expansion_values, max_expansions);
+
+      for (i = jc->expansions_count; i < max_expansions; ++i)
+        {
+          j_capture_init (& jc->expansion_captures [i]);
+          jc->expansion_pipes [i] = -1;
+          jc->expansion_values [i] = NULL;
+        }
+
+      jc->expansions_count = max_expansions;
+    }
+}
+
+static void lazy_compile (JClosure* jc, guint index, GError** error)
+{
+  JContext* context = NULL;
+  JBlock block = J_BLOCK_INIT;
   JTag tag = {0};
-  GClosure* gc = NULL;
-  JClosure* jc = NULL;
-  GError* tmperr = NULL;
   size_t sz = 0;
   gint result = 0;
-  guint i;
+  gint64 lap = 0;
+
+  lap = g_get_monotonic_time ();
+  context = j_context_acquire (g_node_n_nodes (jc->lazies [index].ast, G_TRAVERSE_ALL));
+  context->detachables_base = jc->detachables_count;
+  context->lazies_base = jc->lazies_count;
 
-  j_context_init (&context);
-  j_tag_init (&context, &tag);
-  j_context_generate (&context, ast, &tag);
+  j_tag_init (context, &tag);
+  j_context_generate_lazy (context, jc->lazies [index].ast, jc->lazies [index].continuation, &tag);
+  trees_link (context);
+  j_context_finish (context);
+  lap = j_stats_lap (J_STATS_TIMER_GENERATE, lap);
 
-  if (context.detachables.length > 0)
+  if ((result = dasm_link (context, &sz)), G_UNLIKELY (result != 0))
     {
-      GList* list;
+      g_set_error_literal (error, J_CODEGEN_ERROR, J_CODEGEN_ERROR_PROGRAM_LINK, "dasm_link()!: failed");
+      trees_clear (context);
+      j_context_release (context);
+      return;
+    }
 
-      for (list = g_queue_peek_head_link (&context.detachables); list; list = list->next)
-      {
-        const GTraverseType order = (GTraverseType) G_PRE_ORDER;
-        const GTraverseFlags flags = (GTraverseFlags) G_TRAVERSE_NON_LEAVES;
-        const GNodeTraverseFunc func = (GNodeTraverseFunc) detachable_link;
+  lap = j_stats_lap (J_STATS_TIMER_LINK, lap);
+  j_block_init_near (&block, sz, j_extern_arena ());
+  context->delta = j_block_delta (&block);
 
-        list->data = j_ast_copy (list->data);
-        g_node_traverse (list->data, order, flags, -1, func, &context);
-      }
+  if ((result = dasm_encode (context, j_block_alias (&block))), G_UNLIKELY (result != 0))
+    {
+      g_set_error_literal (error, J_CODEGEN_ERROR, J_CODEGEN_ERROR_PROGRAM_ENCODE, "dasm_encode()!: failed");
+      trees_clear (context);
+      j_context_release (context);
+      j_block_clear (&block);
+      return;
     }
 
-  j_context_finish (&context);
+  j_context_relocate (context, &block);
+  j_context_emit_dump (context, j_block_ptr (&block));
+  j_context_emit_perfmap (context, j_block_ptr (&block));
+  j_context_account (context);
+  lap = j_stats_lap (J_STATS_TIMER_ENCODE, lap);
+  closure_grow (jc, context->max_expansions);
+  strings_adopt (jc, context);
+  trees_adopt (jc, context, j_block_ptr (&block));
+
+  jc->lazies [index].block = block;
+  jc->lazies [index].entry = j_tag_as_offset (context, &tag) + j_block_ptr (&block);
+  j_block_protect (&jc->lazies [index].block);
+  j_context_release (context);
+  j_stats_lap (J_STATS_TIMER_PROTECT, lap);
+}
 
-  if ((result = dasm_link (&context, &sz)), G_UNLIKELY (result != 0))
+JClosureStatus j_closure_lazy (JClosure* closure, JRunner* runner, GError** error, guint index)
+{
+  g_return_val_if_fail (closure != NULL, J_CLOSURE_STATUS_REMOVE);
+  g_return_val_if_fail (index < closure->lazies_count, J_CLOSURE_STATUS_REMOVE);
+  GError* tmperr = NULL;
+
+  if (G_UNLIKELY (closure->lazies [index].entry == NULL))
     {
-      g_set_error_literal (error, J_CODEGEN_ERROR, J_CODEGEN_ERROR_PROGRAM_LINK, "dasm_link()!: failed");
-      j_context_clear (&context);
+      if ((lazy_compile (closure, index, &tmperr)), G_UNLIKELY (tmperr != NULL))
+        {
+          g_propagate_error (error, tmperr);
+          return J_CLOSURE_STATUS_REMOVE;
+        }
+    }
+return (closure->entry = closure->lazies [index].entry, J_CLOSURE_STATUS_CONTINUE);
+}
+
+void j_closure_capture (JClosure* closure, guint index, GError** error)
+{
+  g_return_if_fail (index < closure->expansions_count);
+  GError* tmperr = NULL;
+  gchar* value = NULL;
+
+  if ((value = j_capture_finish (& closure->expansion_captures [index], & closure->expansion_pipes [index], &tmperr)), G_UNLIKELY (tmperr != NULL))
+    g_propagate_error (error, tmperr);
+  else
+    {
+      g_free (closure->expansion_values [index]);
+      closure->expansion_values [index] = value;
+    }
+}
+
+/*
+ * Loop frames form a stack, as a nested loop always runs
+ * to completion before its enclosing loop steps again
+ */
+void j_closure_loop_enter (JClosure* closure)
+{
+  g_return_if_fail (closure != NULL);
+  JLoop* loop = g_slice_new (JLoop);
+
+  loop->values = g_ptr_array_new_with_free_func (g_free);
+  loop->index = 0;
+  g_queue_push_head (&closure->loops, loop);
+}
+
+gboolean j_closure_loop_next (JClosure* closure, JRunner* runner, const gchar* name)
+{
+  g_return_val_if_fail (closure != NULL, FALSE);
+  g_return_val_if_fail (closure->loops.length > 0, FALSE);
+  JLoop* loop = g_queue_peek_head (&closure->loops);
+
+  if (loop->index < loop->values->len)
+    {
+      j_runner_variable_set (runner, name, g_ptr_array_index (loop->values, loop->index++));
+      return TRUE;
     }
+return (loop_free (g_queue_pop_head (&closure->loops)), FALSE);
+}
+
+void j_closure_loop_push (JClosure* closure, const gchar* value)
+{
+  g_return_if_fail (closure != NULL);
+  g_return_if_fail (closure->loops.length > 0);
+  JLoop* loop = g_queue_peek_head (&closure->loops);
 
-  gc = g_closure_new_simple (sizeof (JClosure), g_object_ref (codegen));
-  jc = (JClosure*) gc;
+  if (value != NULL)
+    g_ptr_array_add (loop->values, g_strdup (value));
+}
+
+JClosure* j_closure_new (JCodegen* codegen, gsize closure_size, guint max_expansions)
+{
+  g_return_val_if_fail (J_IS_CODEGEN (codegen), NULL);
+  g_return_val_if_fail (closure_size >= sizeof (JClosure), NULL);
+  GClosure* gc = g_closure_new_simple (closure_size, g_object_ref (codegen));
+  JClosure* jc = (JClosure*) gc;
 
-  jc->expansion_pipes = (context.max_expansions == 0) ? NULL : g_new (JPipeEnd, context.max_expansions);
-  jc->expansion_values = (context.max_expansions == 0) ? NULL : g_new0 (gchar*, context.max_expansions);
-  jc->expansions_count = context.max_expansions;
+  jc->expansion_captures = (max_expansions == 0) ? NULL : g_new (JCapture, max_expansions);
+  jc->expansion_pipes = (max_expansions == 0) ? NULL : g_new (JPipeEnd, max_expansions);
+  jc->expansion_values = (max_expansions == 0) ? NULL : g_new0 (gchar*, max_expansions);
+  jc->expansions_count = max_expansions;
 
   if (jc->expansion_pipes != NULL)
     {
 #if HAVE_MEMSET
-      memset (jc->expansion_pipes, -1, sizeof (JPipeEnd) * context.max_expansions);
+      memset (jc->expansion_pipes, -1, sizeof (JPipeEnd) * max_expansions);
 #else // HAVE_MEMSET
       JPipeEnd* ptr = jc->expansion_pipes;
       guint blocksz = 8;
-      guint n_block = (context.max_expansions + (blocksz - 1)) / blocksz;
+      guint n_block = (max_expansions + (blocksz - 1)) / blocksz;
       guint i;
 
-      switch (context.max_expansions % blocksz)
+      switch (max_expansions % blocksz)
         {
           case 0: do
           {
@@ -282,6 +640,14 @@ GClosure* j_codegen_emit (JCodegen* codegen, JAst* ast, GError** error)
 #endif // HAME_MEMSET
     }
 
+  if (jc->expansion_captures != NULL)
+    {
+      JCapture* capture = jc->expansion_captures;
+
+      while (capture < jc->expansion_captures + max_expansions)
+        j_capture_init (capture++);
+    }
+
   g_closure_add_finalize_notifier (gc, codegen, (GClosureNotify) g_object_unref);
   g_closure_add_finalize_notifier (gc, NULL, (GClosureNotify) closure_nofity);
   g_closure_set_marshal (gc, (GClosureMarshal) closure_marshal);
@@ -292,41 +658,284 @@ GClosure* j_codegen_emit (JCodegen* codegen, JAst* ast, GError** error)
       g_closure_sink (gc);
     }
 
+  g_queue_init (&jc->loops);
   g_queue_init (&jc->waitq);
-  j_block_init (&jc->block, sz);
+return jc;
+}
+
+static gchar* cache_filename (JCodegen* self, const gchar* cache_key)
+{
+  gchar* basename = g_strconcat (cache_key, ".jit", NULL);
+  gchar* filename = g_build_filename (self->cache_dir, basename, NULL);
+return (g_free (basename), filename);
+}
+
+static void cache_store (JCodegen* self, const gchar* cache_key, JClosure* jc, Dst_DECL, const JTag* tag)
+{
+  JCacheEntry entry = {0};
+  GError* tmperr = NULL;
+  gchar* filename = NULL;
+
+  entry.block = jc->block;
+  entry.entry = j_tag_as_offset (Dst, tag);
+  entry.max_expansions = jc->expansions_count;
+  entry.relocs = (JReloc*) Dst->relocs->data;
+  entry.n_relocs = Dst->relocs->len;
+  entry.detachables = (JAst**) jc->detachables;
+  entry.n_detachables = jc->detachables_count;
 
-  if ((result = dasm_encode (&context, j_block_ptr (&jc->block))), G_UNLIKELY (result != 0))
+  if ((j_cache_store (filename = cache_filename (self, cache_key), &entry, &tmperr)), G_UNLIKELY (tmperr != NULL))
+    {
+      g_warning ("(" G_STRLOC "): %s: %u: %s", g_quark_to_string (tmperr->domain), tmperr->code, tmperr->message);
+      g_error_free (tmperr);
+    }
+
+  g_free (filename);
+}
+
+GClosure* j_codegen_emit (JCodegen* codegen, JAst* ast, GError** error)
+{
+  return j_codegen_emit_full (codegen, ast, NULL, error);
+}
+
+GClosure* j_codegen_emit_full (JCodegen* codegen, JAst* ast, const gchar* cache_key, GError** error)
+{
+  g_return_val_if_fail (J_IS_CODEGEN (codegen), NULL);
+  g_return_val_if_fail (ast != NULL, NULL);
+  g_return_val_if_fail (error == NULL || *error == NULL, NULL);
+  return codegen_emit (codegen, ast, cache_key, FALSE, NULL, error);
+}
+
+/*
+ * Only worth it for closures which get rewound and run again,
+ * as branch counts are read back on rewind
+ */
+GClosure* j_codegen_emit_profiled (JCodegen* codegen, JAst* ast, GError** error)
+{
+  g_return_val_if_fail (J_IS_CODEGEN (codegen), NULL);
+  g_return_val_if_fail (ast != NULL, NULL);
+  g_return_val_if_fail (error == NULL || *error == NULL, NULL);
+  return codegen_emit (codegen, ast, NULL, TRUE, NULL, error);
+}
+
+static GClosure* codegen_emit (JCodegen* self, JAst* ast, const gchar* cache_key, gboolean profiling, JProfile* profile, GError** error)
+{
+  JContext* context = NULL;
+  JTag tag = {0};
+  JClosure* jc = NULL;
+  size_t sz = 0;
+  gint result = 0;
+  gint64 lap = 0;
+
+  lap = g_get_monotonic_time ();
+  context = j_context_acquire (g_node_n_nodes (ast, G_TRAVERSE_ALL));
+  context->eager = cache_key != NULL && self->cache_dir != NULL;
+
+  if (profile != NULL)
+    {
+      context->profile = profile->branches;
+      context->n_profile = profile->branches_count / 2;
+    }
+
+  context->profiling = profiling && profile == NULL && context->eager == FALSE;
+
+  j_tag_init (context, &tag);
+  j_context_generate (context, ast, &tag);
+  trees_link (context);
+  j_context_finish (context);
+  lap = j_stats_lap (J_STATS_TIMER_GENERATE, lap);
+
+  if ((result = dasm_link (context, &sz)), G_UNLIKELY (result != 0))
+    {
+      g_set_error_literal (error, J_CODEGEN_ERROR, J_CODEGEN_ERROR_PROGRAM_LINK, "dasm_link()!: failed");
+      trees_clear (context);
+      return (j_context_release (context), NULL);
+    }
+
+  lap = j_stats_lap (J_STATS_TIMER_LINK, lap);
+  jc = j_closure_new (self, sizeof (JClosure), context->max_expansions);
+  j_block_init_near (&jc->block, sz, j_extern_arena ());
+  context->delta = j_block_delta (&jc->block);
+
+  if (cache_key != NULL && self->cache_dir != NULL)
+    {
+      context->base = j_block_alias (&jc->block);
+      context->relocs = g_array_new (FALSE, FALSE, sizeof (JReloc));
+    }
+
+  if ((result = dasm_encode (context, j_block_alias (&jc->block))), G_UNLIKELY (result != 0))
     {
       g_set_error_literal (error, J_CODEGEN_ERROR, J_CODEGEN_ERROR_PROGRAM_ENCODE, "dasm_encode()!: failed");
-      g_closure_unref (gc);
-      j_context_clear (&context);
+      trees_clear (context);
+      g_closure_unref ((GClosure*) jc);
+      return (j_context_release (context), NULL);
     }
 
-  if (context.detachables.length == 0)
-    jc->detachables = NULL;
-  else
+  j_context_relocate (context, &jc->block);
+  j_context_emit_dump (context, j_block_ptr (&jc->block));
+  j_context_emit_perfmap (context, j_block_ptr (&jc->block));
+  j_context_account (context);
+  lap = j_stats_lap (J_STATS_TIMER_ENCODE, lap);
+  strings_adopt (jc, context);
+  trees_adopt (jc, context, j_block_ptr (&jc->block));
+
+#if DEVELOPER == 1
+  j_context_emit_debuginfo (context);
+  j_gdb_register (jc->debug_object = j_gdb_builder_end (&context->debug_builder));
+#endif // DEVELOPER
+  jc->entry = j_tag_as_offset (context, &tag) + j_block_ptr (&jc->block);
+  jc->head = jc->entry;
+
+  if (context->profiling && context->n_sites > 0)
     {
-      GList* list;
-      gpointer data [] = { &context, jc, };
+      jc->branches_count = context->n_sites * 2;
+      jc->branches = g_new0 (guint, jc->branches_count);
+      jc->profile = g_slice_new0 (JProfile);
+      jc->profile->ast = j_ast_copy (ast);
+    }
 
-      jc->detachables = g_new (gpointer, context.detachables.length);
-      jc->detachables_count = context.detachables.length;
+  if (context->relocs != NULL)
+    cache_store (self, cache_key, jc, context, &tag);
 
-      for (list = g_queue_peek_head_link (&context.detachables); list; list = list->next)
-        {
-          const GTraverseType order = (GTraverseType) G_PRE_ORDER;
-          const GTraverseFlags flags = (GTraverseFlags) G_TRAVERSE_NON_LEAVES;
-          const GNodeTraverseFunc func = (GNodeTraverseFunc) detachable_encode;
+  j_block_protect (&jc->block);
+  j_context_release (context);
+  j_stats_lap (J_STATS_TIMER_PROTECT, lap);
+  j_stats_add (J_STATS_COUNTER_CLOSURES, 1);
+return (GClosure*) jc;
+}
 
-          jc->detachables [i] = list->data;
-          g_node_traverse (list->data, order, flags, -1, func, data);
-        }
+static void profile_free (JProfile* profile)
+{
+  if (profile->relaid != NULL)
+    g_closure_unref ((GClosure*) profile->relaid);
+
+  _j_ast_free0 (profile->ast);
+  _g_free0 (profile->branches);
+  g_slice_free (JProfile, profile);
+}
+
+static void relayout_compile (JClosure* jc, gpointer __null__)
+{
+  JProfile* profile = jc->profile;
+  GClosure* relaid = NULL;
+  GError* tmperr = NULL;
+
+  if ((relaid = codegen_emit (jc->closure.data, profile->ast, NULL, FALSE, profile, &tmperr)), G_UNLIKELY (tmperr != NULL))
+    {
+      g_warning ("(" G_STRLOC "): %s: %u: %s", g_quark_to_string (tmperr->domain), tmperr->code, tmperr->message);
+      g_error_free (tmperr);
+      g_atomic_int_set (&profile->state, J_PROFILE_STATE_DONE);
     }
+  else
+    {
+      profile->relaid = (JClosure*) relaid;
+      j_stats_add (J_STATS_COUNTER_RELAYOUTS, 1);
+      g_atomic_int_set (&profile->state, J_PROFILE_STATE_READY);
+    }
+
+  g_closure_unref ((GClosure*) jc);
+}
+
+static GThreadPool* relayout_pool (void)
+{
+  static GThreadPool* pool = NULL;
+
+  if (g_once_init_enter (&pool))
+    g_once_init_leave (&pool, g_thread_pool_new ((GFunc) relayout_compile, NULL, 1, FALSE, NULL));
+return pool;
+}
 
+#define closure_swap(a,b,field) \
+  G_STMT_START \
+    { \
+      __typeof__ ((a)->field) __tmp = (a)->field; \
+      (a)->field = (b)->field; \
+      (b)->field = __tmp; \
+    } \
+  G_STMT_END
+
+static void closure_adopt (JClosure* jc, JClosure* other)
+{
+  closure_swap (jc, other, block);
+  closure_swap (jc, other, branches);
+  closure_swap (jc, other, branches_count);
+  closure_swap (jc, other, detachables);
+  closure_swap (jc, other, detachables_count);
+  closure_swap (jc, other, head);
+  closure_swap (jc, other, lazies);
+  closure_swap (jc, other, lazies_count);
+  closure_swap (jc, other, strings);
+  closure_swap (jc, other, strings_count);
+  closure_swap (jc, other, expansion_captures);
+  closure_swap (jc, other, expansion_pipes);
+  closure_swap (jc, other, expansion_values);
+  closure_swap (jc, other, expansions_count);
 #if DEVELOPER == 1
-  j_context_emit_debuginfo (&context);
-  j_gdb_register (jc->debug_object = j_gdb_builder_end (&context.debug_builder));
+  closure_swap (jc, other, debug_object);
 #endif // DEVELOPER
-  jc->entry = j_tag_as_offset (&context, &tag) + j_block_ptr (&jc->block);
-return (j_block_protect (&jc->block), j_context_clear (&context), gc);
+}
+
+/*
+ * Only reached between runs, when nothing executes the
+ * closure, so its code can be swapped for the re-laid one
+ */
+static void closure_relayout (JClosure* jc)
+{
+  JProfile* profile = jc->profile;
+
+  switch (g_atomic_int_get (&profile->state))
+    {
+      case J_PROFILE_STATE_RECORDING:
+        if (++profile->runs >= J_PROFILE_THRESHOLD)
+          {
+            profile->branches = g_memdup2 (jc->branches, sizeof (guint) * jc->branches_count);
+            profile->branches_count = jc->branches_count;
+            g_atomic_int_set (&profile->state, J_PROFILE_STATE_COMPILING);
+            g_thread_pool_push (relayout_pool (), g_closure_ref ((GClosure*) jc), NULL);
+          }
+        break;
+      case J_PROFILE_STATE_READY:
+        closure_adopt (jc, profile->relaid);
+        g_clear_pointer (&jc->profile, profile_free);
+        break;
+      case J_PROFILE_STATE_DONE:
+        g_clear_pointer (&jc->profile, profile_free);
+        break;
+      default:
+        break;
+    }
+}
+
+gchar* j_codegen_cache_key (const gchar* source, gsize length)
+{
+  g_return_val_if_fail (source != NULL || length == 0, NULL);
+  return j_cache_key (source, length);
+}
+
+GClosure* j_codegen_load (JCodegen* codegen, const gchar* cache_key)
+{
+  g_return_val_if_fail (J_IS_CODEGEN (codegen), NULL);
+  g_return_val_if_fail (cache_key != NULL, NULL);
+  JCodegen* self = (codegen);
+  JCacheEntry entry = {0};
+  JClosure* jc = NULL;
+  gchar* filename = NULL;
+  gboolean hit = FALSE;
+
+  if (self->cache_dir == NULL)
+    return NULL;
+
+  hit = j_cache_load (filename = cache_filename (self, cache_key), &entry);
+  g_free (filename);
+
+  if (hit == FALSE)
+    return NULL;
+
+  jc = j_closure_new (self, sizeof (JClosure), entry.max_expansions);
+  jc->block = entry.block;
+  jc->detachables = (gpointer*) entry.detachables;
+  jc->detachables_count = entry.n_detachables;
+  jc->entry = j_block_ptr (&jc->block) + entry.entry;
+  jc->head = jc->entry;
+return (j_block_protect (&jc->block), (GClosure*) jc);
 }
@@ -47,7 +47,13 @@ extern "C" {
   G_GNUC_INTERNAL GQuark j_codegen_error_quark (void) G_GNUC_CONST;
   G_GNUC_INTERNAL GType j_codegen_get_type (void) G_GNUC_CONST;
   G_GNUC_INTERNAL JCodegen* j_codegen_new ();
+  G_GNUC_INTERNAL gchar* j_codegen_cache_key (const gchar* source, gsize length);
   G_GNUC_INTERNAL GClosure* j_codegen_emit (JCodegen* codegen, JAst* ast, GError** error);
+  G_GNUC_INTERNAL GClosure* j_codegen_emit_full (JCodegen* codegen, JAst* ast, const gchar* cache_key, GError** error);
+  G_GNUC_INTERNAL GClosure* j_codegen_emit_profiled (JCodegen* codegen, JAst* ast, GError** error);
+  G_GNUC_INTERNAL const gchar* j_codegen_get_cache_dir (JCodegen* codegen);
+  G_GNUC_INTERNAL GClosure* j_codegen_interpret (JCodegen* codegen, JAst* ast, GError** error);
+  G_GNUC_INTERNAL GClosure* j_codegen_load (JCodegen* codegen, const gchar* cache_key);
 
 #if __cplusplus
 }
@@ -18,6 +18,7 @@
 #define __JASH_CODEGEN_CONTEXT__ 1
 #include <codegen/block.h>
 #include <codegen/codegen.h>
+#include <codegen/externs.h>
 #if DEVELOPER == 1
 # include <codegen/debug/gdb.h>
 # define DASM_CHECKS
@@ -27,9 +28,12 @@
 
 typedef struct _JContext JContext;
 typedef struct _JExtern JExtern;
+typedef struct _JFixup JFixup;
+typedef struct _JLazyStub JLazyStub;
+typedef struct _JMark JMark;
 typedef const gchar JOnceID;
 typedef struct _JOnceInit JOnceInit;
-typedef gint JPipe [2];
+typedef struct _JReloc JReloc;
 typedef struct _JWalker JWalker;
 
 typedef void (*JCallback) ();
@@ -39,7 +43,7 @@ typedef void (*JCallback) ();
 
 #define DASM_FDEF G_GNUC_INTERNAL
 #define DASM_EXTERN(ctx, addr, idx, type) \
-    (j_extern_search ((ctx), (addr), extern_names [(idx)], (type)))
+    (j_extern_search ((ctx), (addr), (idx), extern_names [(idx)], (type)))
 #define DASM_M_GROW(ctx, t, p, sz, need) \
     G_STMT_START \
       { \
@@ -73,11 +77,29 @@ extern "C"
   
     guint maxpc;
     guint nextpc;
+    guint n_steps;
 
     guint max_expansions;
+    guint cold;
+    guint n_sites;
+    const guint* profile;
+    guint n_profile;
+    gboolean profiling;
     GQueue detachables;
+    guint detachables_base;
+    GQueue lazies;
+    guint lazies_base;
+    gboolean eager;
     GHashTable* symbols;
     GHashTable* strtab;
+    GHashTable* strings;
+
+    gpointer base;
+    gssize delta;
+    GArray* fixups;
+    GArray* marks;
+    GArray* relocs;
+    GPtrArray* walkers;
 #if DEVELOPER == 1
     GHashTable* debug_info;
     JGdbBuilder debug_builder;
@@ -90,12 +112,43 @@ extern "C"
     JCallback address;
   };
 
+  struct _JFixup
+  {
+    JTag array;
+    guint slot;
+    JTag target;
+    gconstpointer address;
+  };
+
+  struct _JLazyStub
+  {
+    JAst* ast;
+    JTag tag_next;
+  };
+
+  struct _JMark
+  {
+    JTag tag;
+    const gchar* name;
+  };
+
   struct _JOnceInit
   {
     gint name;
     void (*callback) (Dst_DECL);
   };
 
+  struct _JReloc
+  {
+    guint32 offset;
+    guint16 index;
+    guint16 type;
+  };
+
+  #define J_CONTEXT_LAYOUT_VERSION (1)
+  #define J_CONTEXT_POOL_SIZE (4)
+  #define J_RELOC_INDEX_BLOCK (G_MAXUINT16)
+
   #define j_context_allocpc(context) \
     (({ \
         JContext* __context = ((context)); \
@@ -113,6 +166,8 @@ extern "C"
 
   G_GNUC_INTERNAL void j_builtin_help (JRunner* runner, const gchar* parameter);
 
+  G_GNUC_INTERNAL void j_context_account (Dst_DECL);
+  G_GNUC_INTERNAL JContext* j_context_acquire (guint n_nodes);
   G_GNUC_INTERNAL void j_context_clear (Dst_DECL);
   G_GNUC_INTERNAL void j_context_emit_absolute_jump (Dst_DECL, gpointer address, const JTag* tag);
 #if DEVELOPER == 1
@@ -124,17 +179,42 @@ extern "C"
   G_GNUC_INTERNAL void j_context_emit_chain_step_detach (Dst_DECL, guint index, const JTag* tag, const JTag* tag_next);
   G_GNUC_INTERNAL void j_context_emit_chain_step_expansions (Dst_DECL, JWalker* walker, const JTag* tag, const JTag* tag_next);
   G_GNUC_INTERNAL void j_context_emit_chain_step_expression (Dst_DECL, JWalker* walker, const JTag* tag, const JTag* tag_next);
-  G_GNUC_INTERNAL void j_context_emit_test (Dst_DECL, const JTag* tag, const JTag* tag_direct, const JTag* tag_reverse);
+  G_GNUC_INTERNAL void j_context_emit_chain_step_function (Dst_DECL, guint index, const JTag* tag, const JTag* tag_next);
+  G_GNUC_INTERNAL void j_context_emit_chain_step_lazy (Dst_DECL, guint index, const JTag* tag);
+  G_GNUC_INTERNAL void j_context_emit_chain_yield (Dst_DECL, const JTag* tag, const JTag* tag_next);
+  G_GNUC_INTERNAL void j_context_emit_dump (Dst_DECL, gpointer base);
+  G_GNUC_INTERNAL void j_context_emit_loop (Dst_DECL, JWalker* walker, const JTag* tag, const JTag* tag_loop, const JTag* tag_body, const JTag* tag_next);
+  G_GNUC_INTERNAL void j_context_emit_perfmap (Dst_DECL, gpointer base);
+  G_GNUC_INTERNAL void j_context_emit_test (Dst_DECL, guint site, const JTag* tag, const JTag* tag_direct, const JTag* tag_reverse);
+  G_GNUC_INTERNAL void j_context_enter_cold (Dst_DECL);
   G_GNUC_INTERNAL void j_context_finish (Dst_DECL);
   G_GNUC_INTERNAL void j_context_generate (Dst_DECL, JAst* ast, const JTag* tag);
+  G_GNUC_INTERNAL void j_context_generate_lazy (Dst_DECL, JAst* ast, gpointer continuation, const JTag* tag);
+  G_GNUC_INTERNAL const gchar* j_context_get_build_id (void);
+  G_GNUC_INTERNAL const gchar* j_context_get_extern_name (guint index);
   G_GNUC_INTERNAL void j_context_init (Dst_DECL);
+  G_GNUC_INTERNAL const gchar* j_context_intern (Dst_DECL, const gchar* value);
+  G_GNUC_INTERNAL void j_context_leave_cold (Dst_DECL);
+  G_GNUC_INTERNAL void j_context_leave_data (Dst_DECL);
+  G_GNUC_INTERNAL void j_context_mark (Dst_DECL, const JTag* tag, const gchar* name);
+  G_GNUC_INTERNAL void j_context_mark_step (Dst_DECL, const JTag* tag, const gchar* name);
+  G_GNUC_INTERNAL void j_context_relocate (Dst_DECL, JBlock* block);
+  G_GNUC_INTERNAL void j_context_release (Dst_DECL);
+  G_GNUC_INTERNAL void j_context_reset (Dst_DECL);
   G_GNUC_INTERNAL void j_context_store (Dst_DECL, gconstpointer buffer, gsize bufsz);
+  G_GNUC_INTERNAL JWalker* j_context_walker_acquire (Dst_DECL);
+  G_GNUC_INTERNAL void j_context_walker_release (Dst_DECL, JWalker* walker);
 
+  G_GNUC_INTERNAL gconstpointer j_extern_arena (void);
   G_GNUC_INTERNAL const JExtern* j_extern_lookup (const gchar* name, size_t length);
-  G_GNUC_INTERNAL const gint32 j_extern_search (Dst_DECL, gconstpointer address, const gchar* name, int type);
+  G_GNUC_INTERNAL const gchar* j_extern_name (gconstpointer address);
+  G_GNUC_INTERNAL const gint32 j_extern_search (Dst_DECL, gconstpointer address, guint index, const gchar* name, int type);
 
   G_GNUC_INTERNAL void j_once_init (Dst_DECL, GHashTable* table, JOnceID* once, JTag* tag);
   G_GNUC_INTERNAL void j_once_init_branch_fail (Dst_DECL);
+  G_GNUC_INTERNAL void j_once_init_stub_propagate (Dst_DECL);
+  G_GNUC_INTERNAL void j_once_init_stub_propagate_fail (Dst_DECL);
+  G_GNUC_INTERNAL void j_once_init_stub_report (Dst_DECL);
   G_GNUC_INTERNAL const JOnceInit* j_once_lookup (const gchar* name, size_t length);
 
   G_GNUC_INTERNAL void j_set_closure_error_chdir (GError** error, int errno_value, const gchar* fmt, ...) G_GNUC_PRINTF (3, 4);
@@ -0,0 +1,192 @@
+/* Copyright 2023 MarcosHCK
+ * This file is part of JASH.
+ *
+ * JASH is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * JASH is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with JASH. If not, see <http://www.gnu.org/licenses/>.
+ */
+#include <config.h>
+#include <codegen/debug/dump.h>
+#if DEVELOPER == 1
+# include <bfd.h>
+# include <codegen/debug/gdb.h>
+# include <dis-asm.h>
+#endif // DEVELOPER
+
+/*
+ * Closures are dumped to stderr as they are compiled,
+ * with libopcodes disassembly on developer builds and
+ * raw bytes everywhere else
+ */
+
+G_LOCK_DEFINE_STATIC (dump);
+static gint enabled = -1;
+
+#if DEVELOPER == 1
+typedef struct _JDumpStream JDumpStream;
+
+struct _JDumpStream
+{
+  GString* buffer;
+  JDumpSymbolize symbolize;
+  gpointer user_data;
+};
+
+static int dump_fprintf (void* stream, const char* fmt, ...) G_GNUC_PRINTF (2, 3);
+static int dump_fprintf (void* stream, const char* fmt, ...)
+{
+  va_list l;
+
+  va_start (l, fmt);
+  g_string_append_vprintf (((JDumpStream*) stream)->buffer, fmt, l);
+  va_end (l);
+return 0;
+}
+
+# ifdef HAVE_STYLED_DISASSEMBLER
+static int dump_fprintf_styled (void* stream, enum disassembler_style style, const char* fmt, ...) G_GNUC_PRINTF (3, 4);
+static int dump_fprintf_styled (void* stream, enum disassembler_style style, const char* fmt, ...)
+{
+  va_list l;
+
+  va_start (l, fmt);
+  g_string_append_vprintf (((JDumpStream*) stream)->buffer, fmt, l);
+  va_end (l);
+return 0;
+}
+# endif // HAVE_STYLED_DISASSEMBLER
+
+static void dump_print_address (bfd_vma address, struct disassemble_info* info)
+{
+  JDumpStream* stream = info->stream;
+  const gchar* name = stream->symbolize (GSIZE_TO_POINTER (address), stream->user_data);
+
+  g_string_append_printf (stream->buffer, "%p", GSIZE_TO_POINTER (address));
+
+  if (name != NULL)
+    g_string_append_printf (stream->buffer, " <%s>", name);
+}
+#endif // DEVELOPER
+
+static void dump_hex (GString* buffer, gconstpointer start, gsize size)
+{
+  const guint8* bytes = start;
+  gsize i, j;
+
+  for (i = 0; i < size; i += 16)
+    {
+      g_string_append_printf (buffer, "    %p ", start + i);
+
+      for (j = i; j < i + 16 && j < size; ++j)
+        g_string_append_printf (buffer, " %02x", bytes [j]);
+
+      g_string_append_c (buffer, '\n');
+    }
+}
+
+void j_dump_code (GString* buffer, gconstpointer start, gsize size, JDumpSymbolize symbolize, gpointer user_data)
+{
+  const guint8* bytes = start;
+  const gchar* name = NULL;
+  gint32 displacement;
+  gsize i;
+#if DEVELOPER == 1
+  JDumpStream stream = { buffer, symbolize, user_data, };
+  struct disassemble_info info;
+  disassembler_ftype disassemble;
+  int length = 0;
+
+# ifdef HAVE_STYLED_DISASSEMBLER
+  init_disassemble_info (&info, &stream, dump_fprintf, dump_fprintf_styled);
+# else // !HAVE_STYLED_DISASSEMBLER
+  init_disassemble_info (&info, &stream, dump_fprintf);
+# endif // HAVE_STYLED_DISASSEMBLER
+
+  info.arch = (enum bfd_architecture) j_gdb_default_arch;
+  info.mach = j_gdb_default_mach;
+  info.buffer = (bfd_byte*) start;
+  info.buffer_vma = (bfd_vma) GPOINTER_TO_SIZE (start);
+  info.buffer_length = size;
+  info.print_address_func = dump_print_address;
+  disassemble_init_for_target (&info);
+
+  if ((disassemble = disassembler (info.arch, FALSE, info.mach, NULL)) != NULL)
+    {
+      for (i = 0; i < size; i += length)
+        {
+          g_string_append_printf (buffer, "    %p  ", start + i);
+
+          if ((length = disassemble (info.buffer_vma + i, &info)) <= 0)
+            break;
+
+          g_string_append_c (buffer, '\n');
+        }
+      return;
+    }
+#endif // DEVELOPER
+
+  dump_hex (buffer, start, size);
+
+  /* Without a disassembler only rel32 calls are told apart */
+  for (i = 0; i + 5 <= size; ++i)
+  if (bytes [i] == 0xe8)
+    {
+      memcpy (&displacement, bytes + i + 1, sizeof (displacement));
+      displacement = GINT32_FROM_LE (displacement);
+
+      if ((name = symbolize (start + i + 5 + displacement, user_data)) != NULL)
+        g_string_append_printf (buffer, "    %p  call <%s>\n", start + i, name);
+    }
+}
+
+void j_dump_data (GString* buffer, gconstpointer start, gsize size)
+{
+  dump_hex (buffer, start, size);
+}
+
+gboolean j_dump_enabled (void)
+{
+  const gchar* value = NULL;
+  gint good;
+
+  if ((good = g_atomic_int_get (&enabled)) < 0)
+    {
+      value = g_getenv (J_DUMP_JIT_ENV);
+      good = value != NULL && value [0] != '\0' && g_strcmp0 (value, "0") != 0;
+      g_atomic_int_compare_and_exchange (&enabled, -1, good);
+      good = g_atomic_int_get (&enabled);
+    }
+return good > 0;
+}
+
+void j_dump_string (GString* buffer, gconstpointer address, const gchar* value)
+{
+  gchar* escaped = g_strescape (value, NULL);
+  g_string_append_printf (buffer, "    %p \"%s\"\n", address, escaped);
+  g_free (escaped);
+}
+
+void j_dump_toggle (void)
+{
+  gint value;
+
+  do value = j_dump_enabled ();
+  while (!g_atomic_int_compare_and_exchange (&enabled, value, !value));
+}
+
+void j_dump_write (const gchar* text)
+{
+  /* Closures compiled ahead on the worker thread must not interleave */
+  G_LOCK (dump);
+  g_printerr ("%s", text);
+  G_UNLOCK (dump);
+}
@@ -0,0 +1,40 @@
+/* Copyright 2023 MarcosHCK
+ * This file is part of JASH.
+ *
+ * JASH is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * JASH is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with JASH. If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef __JASH_CODEGEN_DEBUG_DUMP__
+#define __JASH_CODEGEN_DEBUG_DUMP__ 1
+#include <glib.h>
+
+#define J_DUMP_JIT_ENV "JASH_DUMP_JIT"
+
+#if __cplusplus
+extern "C" {
+#endif // __cplusplus
+
+  typedef const gchar* (*JDumpSymbolize) (gconstpointer address, gpointer user_data);
+
+  G_GNUC_INTERNAL void j_dump_code (GString* buffer, gconstpointer start, gsize size, JDumpSymbolize symbolize, gpointer user_data);
+  G_GNUC_INTERNAL void j_dump_data (GString* buffer, gconstpointer start, gsize size);
+  G_GNUC_INTERNAL gboolean j_dump_enabled (void);
+  G_GNUC_INTERNAL void j_dump_string (GString* buffer, gconstpointer address, const gchar* value);
+  G_GNUC_INTERNAL void j_dump_toggle (void);
+  G_GNUC_INTERNAL void j_dump_write (const gchar* text);
+
+#if __cplusplus
+}
+#endif // __cplusplus
+
+#endif // __JASH_CODEGEN_DEBUG_DUMP__
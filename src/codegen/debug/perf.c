@@ -0,0 +1,92 @@
+/* Copyright 2023 MarcosHCK
+ * This file is part of JASH.
+ *
+ * JASH is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * JASH is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with JASH. If not, see <http://www.gnu.org/licenses/>.
+ */
+#include <config.h>
+#include <codegen/debug/perf.h>
+#include <errno.h>
+#include <glib/gstdio.h>
+#include <stdio.h>
+#ifndef G_OS_WIN32
+# include <unistd.h>
+#endif // G_OS_WIN32
+
+/*
+ * perf (1) looks up /tmp/perf-<pid>.map to name anonymous
+ * executable mappings, one "<start> <size> <name>" per line
+ */
+
+G_LOCK_DEFINE_STATIC (perf_map);
+static FILE* perf_map = NULL;
+static gboolean perf_failed = FALSE;
+static gint perf_pid = 0;
+
+gboolean j_perf_enabled (void)
+{
+#ifdef G_OS_WIN32
+  return FALSE;
+#else // !G_OS_WIN32
+  static gsize enabled = 0;
+
+  if (g_once_init_enter (&enabled))
+    {
+      const gchar* value = g_getenv (J_PERF_MAP_ENV);
+      gboolean good = value != NULL && value [0] != '\0' && g_strcmp0 (value, "0") != 0;
+      g_once_init_leave (&enabled, good ? 2 : 1);
+    }
+return enabled == 2;
+#endif // G_OS_WIN32
+}
+
+void j_perf_write (gconstpointer address, gsize size, const gchar* name)
+{
+#ifndef G_OS_WIN32
+  gchar* filename = NULL;
+
+  if (size == 0)
+    return;
+
+  G_LOCK (perf_map);
+
+  /* Forked children compile on their own, into their own map */
+  if (perf_pid != (gint) getpid ())
+    {
+      g_clear_pointer (&perf_map, fclose);
+      perf_failed = FALSE;
+      perf_pid = (gint) getpid ();
+    }
+
+  /* A map that could not be opened is warned about once per process */
+  if (perf_map == NULL && perf_failed == FALSE)
+    {
+      filename = g_strdup_printf ("/tmp/perf-%i.map", perf_pid);
+
+      if ((perf_map = g_fopen (filename, "a")) == NULL)
+        {
+          g_warning ("(" G_STRLOC "): %s: %s", filename, g_strerror (errno));
+          perf_failed = TRUE;
+        }
+      else
+        setvbuf (perf_map, NULL, _IOLBF, 0);
+
+      g_free (filename);
+    }
+
+  if (perf_map != NULL)
+    fprintf (perf_map, "%" G_GINTPTR_MODIFIER "x %" G_GSIZE_MODIFIER "x jash::%s\n", (guintptr) address, size, name);
+
+  G_UNLOCK (perf_map);
+#endif // !G_OS_WIN32
+}
@@ -0,0 +1,117 @@
+/* Copyright 2023 MarcosHCK
+ * This file is part of JASH.
+ *
+ * JASH is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * JASH is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with JASH. If not, see <http://www.gnu.org/licenses/>.
+ */
+#include <config.h>
+#include <codegen/debug/stats.h>
+
+G_LOCK_DEFINE_STATIC (stats);
+static guint64 counters [J_STATS_COUNTER_NUMBER] = {0};
+static gint64 timers [J_STATS_TIMER_NUMBER] = {0};
+static guint laps [J_STATS_TIMER_NUMBER] = {0};
+
+static const gchar* counter_names [J_STATS_COUNTER_NUMBER] =
+{
+  "tokens",
+  "ast nodes",
+  "closures",
+  "code bytes",
+  "data bytes",
+  "labels",
+  "relayouts",
+  "steps",
+  "trampolines",
+};
+
+static const gchar* timer_names [J_STATS_TIMER_NUMBER] =
+{
+  "lexer",
+  "parser",
+  "generate",
+  "link",
+  "encode",
+  "protect",
+};
+
+void j_stats_add (JStatsCounter counter, guint64 value)
+{
+  g_return_if_fail (counter < J_STATS_COUNTER_NUMBER);
+
+  G_LOCK (stats);
+  counters [counter] += value;
+  G_UNLOCK (stats);
+}
+
+gint64 j_stats_lap (JStatsTimer timer, gint64 since)
+{
+  g_return_val_if_fail (timer < J_STATS_TIMER_NUMBER, 0);
+  gint64 now = g_get_monotonic_time ();
+
+  G_LOCK (stats);
+  timers [timer] += now - since;
+  laps [timer] += 1;
+  G_UNLOCK (stats);
+return now;
+}
+
+static GString* format (JRunner* runner)
+{
+  GString* buffer = g_string_sized_new (512);
+  guint64 closures, steps;
+  guint i;
+
+  G_LOCK (stats);
+
+  for (i = 0; i < J_STATS_TIMER_NUMBER; ++i)
+    g_string_append_printf (buffer, "%-12s %10.3lf ms (%u)\n", timer_names [i], timers [i] / 1000.0, laps [i]);
+  for (i = 0; i < J_STATS_COUNTER_NUMBER; ++i)
+    g_string_append_printf (buffer, "%-12s %10" G_GUINT64_FORMAT "\n", counter_names [i], counters [i]);
+
+  if (counters [J_STATS_COUNTER_CLOSURES] > 0)
+    {
+      closures = counters [J_STATS_COUNTER_CLOSURES];
+      g_string_append_printf (buffer, "%-12s %10.1lf\n", "bytes/closure", counters [J_STATS_COUNTER_CODE_BYTES] / (gdouble) closures);
+      g_string_append_printf (buffer, "%-12s %10.1lf\n", "steps/closure", counters [J_STATS_COUNTER_STEPS] / (gdouble) closures);
+    }
+
+  if (counters [J_STATS_COUNTER_STEPS] > 0)
+    {
+      steps = counters [J_STATS_COUNTER_STEPS];
+      g_string_append_printf (buffer, "%-12s %10.1lf\n", "bytes/step", counters [J_STATS_COUNTER_CODE_BYTES] / (gdouble) steps);
+    }
+
+  G_UNLOCK (stats);
+
+  if (runner != NULL)
+    {
+      g_string_append_printf (buffer, "%-12s %10u\n", "interpreted", j_runner_get_tier_count (runner, J_RUNNER_TIER_INTERPRETER));
+      g_string_append_printf (buffer, "%-12s %10u\n", "compiled", j_runner_get_tier_count (runner, J_RUNNER_TIER_COMPILER));
+    }
+return buffer;
+}
+
+void j_stats_print (JRunner* runner)
+{
+  GString* buffer = format (runner);
+  g_print ("%s", buffer->str);
+  g_string_free (buffer, TRUE);
+}
+
+void j_stats_printerr (JRunner* runner)
+{
+  GString* buffer = format (runner);
+  g_printerr ("%s", buffer->str);
+  g_string_free (buffer, TRUE);
+}
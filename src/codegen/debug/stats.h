@@ -0,0 +1,59 @@
+/* Copyright 2023 MarcosHCK
+ * This file is part of JASH.
+ *
+ * JASH is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * JASH is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with JASH. If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef __JASH_CODEGEN_DEBUG_STATS__
+#define __JASH_CODEGEN_DEBUG_STATS__ 1
+#include <runtime/runner.h>
+
+#if __cplusplus
+extern "C" {
+#endif // __cplusplus
+
+  typedef enum
+  {
+    J_STATS_COUNTER_TOKENS,
+    J_STATS_COUNTER_AST_NODES,
+    J_STATS_COUNTER_CLOSURES,
+    J_STATS_COUNTER_CODE_BYTES,
+    J_STATS_COUNTER_DATA_BYTES,
+    J_STATS_COUNTER_LABELS,
+    J_STATS_COUNTER_RELAYOUTS,
+    J_STATS_COUNTER_STEPS,
+    J_STATS_COUNTER_TRAMPOLINES,
+    J_STATS_COUNTER_NUMBER,
+  } JStatsCounter;
+
+  typedef enum
+  {
+    J_STATS_TIMER_LEXER,
+    J_STATS_TIMER_PARSER,
+    J_STATS_TIMER_GENERATE,
+    J_STATS_TIMER_LINK,
+    J_STATS_TIMER_ENCODE,
+    J_STATS_TIMER_PROTECT,
+    J_STATS_TIMER_NUMBER,
+  } JStatsTimer;
+
+  G_GNUC_INTERNAL void j_stats_add (JStatsCounter counter, guint64 value);
+  G_GNUC_INTERNAL gint64 j_stats_lap (JStatsTimer timer, gint64 since);
+  G_GNUC_INTERNAL void j_stats_print (JRunner* runner);
+  G_GNUC_INTERNAL void j_stats_printerr (JRunner* runner);
+
+#if __cplusplus
+}
+#endif // __cplusplus
+
+#endif // __JASH_CODEGEN_DEBUG_STATS__
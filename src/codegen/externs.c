@@ -15,18 +15,99 @@
  * along with JASH. If not, see <http://www.gnu.org/licenses/>.
  */
 #include <config.h>
+#include <codegen/capture.h>
+#include <codegen/closure.h>
 #include <codegen/codegen.h>
 #include <codegen/context.h>
+#include <codegen/debug/stats.h>
 #include <codegen/externs.h>
 #include <codegen/walker.h>
+#include <dossier/dossier.h>
 #include <errno.h>
 #include <fcntl.h>
 #include <glib/gstdio.h>
 #include <glib-object.h>
+#include <limits.h>
+#include <signal.h>
+#include <sys/syscall.h>
 #include <sys/types.h>
 #include <sys/stat.h>
+#include <term/readline.h>
 #include <wait.h>
 
+typedef struct _JSpawnReport JSpawnReport;
+
+G_LOCK_DEFINE_STATIC (expand_print);
+static GString* expand_buffer = NULL;
+
+struct _JSpawnReport
+{
+  gint step;
+  gint errno_value;
+  gsize length;
+};
+
+gboolean j_arithmetic_apply (JArithmeticOpcode opcode, gint64 lhs, gint64 rhs, gint64* result, GError** error)
+{
+  switch (opcode)
+    {
+      case J_ARITHMETIC_OPCODE_BNOT: *result = ~lhs; break;
+      case J_ARITHMETIC_OPCODE_NEG: *result = (gint64) (- (guint64) lhs); break;
+      case J_ARITHMETIC_OPCODE_NOT: *result = !lhs; break;
+      case J_ARITHMETIC_OPCODE_ADD: *result = (gint64) ((guint64) lhs + (guint64) rhs); break;
+      case J_ARITHMETIC_OPCODE_BAND: *result = lhs & rhs; break;
+      case J_ARITHMETIC_OPCODE_BOR: *result = lhs | rhs; break;
+      case J_ARITHMETIC_OPCODE_BXOR: *result = lhs ^ rhs; break;
+      case J_ARITHMETIC_OPCODE_EQ: *result = lhs == rhs; break;
+      case J_ARITHMETIC_OPCODE_GE: *result = lhs >= rhs; break;
+      case J_ARITHMETIC_OPCODE_GT: *result = lhs > rhs; break;
+      case J_ARITHMETIC_OPCODE_LAND: *result = lhs && rhs; break;
+      case J_ARITHMETIC_OPCODE_LE: *result = lhs <= rhs; break;
+      case J_ARITHMETIC_OPCODE_LOR: *result = lhs || rhs; break;
+      case J_ARITHMETIC_OPCODE_LT: *result = lhs < rhs; break;
+      case J_ARITHMETIC_OPCODE_MUL: *result = (gint64) ((guint64) lhs * (guint64) rhs); break;
+      case J_ARITHMETIC_OPCODE_NE: *result = lhs != rhs; break;
+      case J_ARITHMETIC_OPCODE_SHL: *result = (gint64) ((guint64) lhs << (rhs & 63)); break;
+      case J_ARITHMETIC_OPCODE_SHR: *result = lhs >> (rhs & 63); break;
+      case J_ARITHMETIC_OPCODE_SUB: *result = (gint64) ((guint64) lhs - (guint64) rhs); break;
+
+      case J_ARITHMETIC_OPCODE_DIV:
+      case J_ARITHMETIC_OPCODE_MOD:
+        {
+          /* Same results idiv gives, minus the INT64_MIN / -1 trap */
+          if (rhs == 0)
+            {
+              g_set_error_literal (error, J_CLOSURE_ERROR, J_CLOSURE_ERROR_FAILED, "division by zero");
+              return FALSE;
+            }
+          else if (rhs == -1)
+            *result = (opcode == J_ARITHMETIC_OPCODE_DIV) ? (gint64) (- (guint64) lhs) : 0;
+          else
+            *result = (opcode == J_ARITHMETIC_OPCODE_DIV) ? lhs / rhs : lhs % rhs;
+          break;
+        }
+
+      default: g_assert_not_reached ();
+    }
+return TRUE;
+}
+
+gint64 j_arithmetic_load (JRunner* runner, const gchar* name, GError** error)
+{
+  const gchar* value = NULL;
+  GError* tmperr = NULL;
+  gint64 number = 0;
+
+  if ((value = j_runner_variable_get (runner, name)) == NULL || *value == 0)
+    return 0;
+  if ((number = j_parse_int64 (value, &tmperr)), G_UNLIKELY (tmperr != NULL))
+    {
+      g_propagate_prefixed_error (error, tmperr, "%s: ", name);
+      return 0;
+    }
+return number;
+}
+
 void j_chdir (const gchar* path, GError** error)
 {
   if (g_chdir (path) < 0)
@@ -43,10 +124,79 @@ void j_dup2 (gint fd_old, gint fd_new, GError** error)
 #endif // DEVELOPER
 }
 
-void j_execvp (const gchar* program, gchar* const arguments [], GError** error)
+static void expand_print (const gchar* string)
 {
-  execvp (program, arguments);
-  j_set_closure_error_execvp (error, errno, "exec (\"%s\")!", program);
+  g_string_append (expand_buffer, string);
+}
+
+void j_expand_builtin (JRunner* runner, gchar** value, const gchar* builtin, const gchar* argument)
+{
+  GPrintFunc func = NULL;
+  JReadline* readline = NULL;
+  const gchar* variable = NULL;
+
+  /* Builtin names are compared by their interned address */
+  builtin = g_intern_string (builtin);
+  g_free (*value);
+
+  if (builtin == J_TOKEN_BUILTIN_GET)
+    *value = g_strdup ((variable = j_runner_variable_get (runner, argument)) ? variable : "");
+  else if (builtin == J_TOKEN_BUILTIN_FALSE
+        || builtin == J_TOKEN_BUILTIN_TRUE)
+    *value = g_strdup ("");
+  else
+    {
+      G_LOCK (expand_print);
+      expand_buffer = g_string_sized_new (128);
+      func = g_set_print_handler (expand_print);
+
+      if (builtin == J_TOKEN_BUILTIN_HELP)
+        j_dossier_help (argument);
+      else if (builtin == J_TOKEN_BUILTIN_HISTORY)
+        {
+          j_readline_history_print (readline = j_readline_new ());
+          g_object_unref (readline);
+        }
+      else if (builtin == J_TOKEN_BUILTIN_JOBS)
+        j_runner_job_print_all (runner);
+      else if (builtin == J_TOKEN_BUILTIN_STATS)
+        j_stats_print (runner);
+      else g_assert_not_reached ();
+
+      g_set_print_handler (func);
+      *value = g_string_free (g_steal_pointer (&expand_buffer), FALSE);
+      G_UNLOCK (expand_print);
+    }
+}
+
+void j_expand_file (gchar** value, const gchar* filename, GError** error)
+{
+  JCapture capture = J_CAPTURE_INIT;
+  GError* tmperr = NULL;
+  gchar* contents = NULL;
+  gint fd = -1;
+
+  if ((fd = j_open (filename, O_RDONLY, 0, &tmperr)), G_UNLIKELY (tmperr != NULL))
+    g_propagate_error (error, tmperr);
+  else if ((contents = j_capture_finish (&capture, &fd, &tmperr)), G_UNLIKELY (tmperr != NULL))
+    g_propagate_error (error, tmperr);
+  else
+    {
+      g_free (*value);
+      *value = contents;
+    }
+}
+
+void j_expand_int (gchar** value, gint64 number)
+{
+  g_free (*value);
+  *value = g_strdup_printf ("%" G_GINT64_FORMAT, number);
+}
+
+void j_expand_value (gchar** value, const gchar* source)
+{
+  g_free (*value);
+  *value = g_strdup (source == NULL ? "" : source);
 }
 
 pid_t j_fork (GError** error)
@@ -105,8 +255,9 @@ void j_pipe_init_many (JPipe* pipes, guint n_pipes, GError** error)
 {
   guint i;
 
+  /* Close-on-exec, so exec'd children only keep what they dup2 */
   for (i = 0; i < n_pipes; ++i)
-  if (pipe (pipes [i]) < 0)
+  if (pipe2 (pipes [i], O_CLOEXEC) < 0)
     {
       j_set_closure_error_pipe (error, errno, "pipe ()!");
       break;
@@ -149,6 +300,203 @@ gint j_parse_int (const gchar* value, GError** error)
 return (gint) result;
 }
 
+gint64 j_parse_int64 (const gchar* value, GError** error)
+{
+  const gchar* number = NULL;
+  const gint base = detectbase (value, &number);
+  gint64 result = -1;
+
+  g_ascii_string_to_signed (number, base, G_MININT64, G_MAXINT64, &result, error);
+return result;
+}
+
+/*
+ * Everything a forked child runs before exec sticks to
+ * raw syscalls, so it is async-signal-safe; failures go
+ * back to the parent through the close-on-exec report pipe
+ */
+
+void j_spawn_dup2 (gint report, gint fd_old, gint fd_new)
+{
+  if (syscall (SYS_dup2, fd_old, fd_new) < 0)
+    j_spawn_fail (report, J_SPAWN_STEP_DUP2, NULL, errno);
+}
+
+/*
+ * Same fallback as execvp for files without a '#!' line,
+ * the argument vector is built on the stack to stay malloc-free
+ */
+static void spawn_exec_shell (const gchar* path, gchar* const arguments [], gchar* const envp [])
+{
+  gchar** argv = NULL;
+  guint i, n_arguments;
+
+  for (n_arguments = 0; arguments [n_arguments] != NULL; ++n_arguments);
+
+  argv = g_newa (gchar*, n_arguments + 2);
+  argv [0] = "sh";
+  argv [1] = (gchar*) path;
+
+  for (i = 1; i < n_arguments; ++i)
+    argv [i + 1] = arguments [i];
+
+  argv [MAX (n_arguments, 1) + 1] = NULL;
+  syscall (SYS_execve, "/bin/sh", argv, envp);
+}
+
+void j_spawn_exec (const gchar* program, gchar* const arguments [], gchar* const envp [], gint report)
+{
+  gchar buffer [PATH_MAX];
+  const gchar* path = NULL;
+  const gchar* next = NULL;
+  gint errno_value = ENOENT;
+  gsize length, prefix;
+  guint i;
+
+  if (strchr (program, '/') != NULL)
+    {
+      syscall (SYS_execve, program, arguments, envp);
+
+      if (errno == ENOEXEC)
+        spawn_exec_shell (program, arguments, envp);
+      j_spawn_fail (report, J_SPAWN_STEP_EXEC, program, errno);
+    }
+
+  for (i = 0; envp != NULL && envp [i] != NULL; ++i)
+  if (strncmp (envp [i], "PATH=", 5) == 0)
+    {
+      path = envp [i] + 5;
+      break;
+    }
+
+  path = path == NULL ? "/bin:/usr/bin" : path;
+  length = strlen (program);
+
+  for (; TRUE; path = next + 1)
+    {
+      next = strchrnul (path, ':');
+      prefix = next - path;
+
+      if (prefix + length + 2 <= sizeof (buffer))
+        {
+          memcpy (buffer, path, prefix);
+          buffer [prefix] = '/';
+          memcpy (buffer + prefix + 1, program, length + 1);
+
+          syscall (SYS_execve, prefix > 0 ? buffer : buffer + 1, arguments, envp);
+
+          if (errno == ENOEXEC)
+            {
+              spawn_exec_shell (prefix > 0 ? buffer : buffer + 1, arguments, envp);
+              errno_value = errno;
+              break;
+            }
+
+          /* Same as execvp, keep looking past missing or forbidden entries */
+          if (errno == EACCES)
+            errno_value = EACCES;
+          else if (errno != ENOENT && errno != ENOTDIR)
+            {
+              errno_value = errno;
+              break;
+            }
+        }
+
+      if (*next == 0)
+        break;
+    }
+
+  j_spawn_fail (report, J_SPAWN_STEP_EXEC, program, errno_value);
+}
+
+void j_spawn_fail (gint report, JSpawnStep step, const gchar* subject, gint errno_value)
+{
+  JSpawnReport header = { step, errno_value, subject == NULL ? 0 : strlen (subject), };
+
+  syscall (SYS_write, report, &header, sizeof (header));
+  syscall (SYS_write, report, subject, header.length);
+  _exit (1);
+}
+
+static gsize spawn_read (gint fd, gpointer buffer, gsize length)
+{
+  gsize done = 0;
+  gssize result;
+
+  while (done < length)
+    {
+      if ((result = read (fd, buffer + done, length - done)) > 0)
+        done += result;
+      else if (result < 0 && errno == EINTR)
+        continue;
+      else
+        break;
+    }
+return done;
+}
+
+pid_t j_spawn_finish (pid_t pid, JPipe report)
+{
+  JSpawnReport header;
+  GError* tmperr = NULL;
+  gchar* subject = NULL;
+
+  /* Reading EOF means the child got through execve */
+  g_close (report [1], NULL);
+
+  if (spawn_read (report [0], &header, sizeof (header)) == sizeof (header))
+    {
+      subject = g_malloc (header.length + 1);
+      subject [spawn_read (report [0], subject, header.length)] = 0;
+
+      switch (header.step)
+        {
+          case J_SPAWN_STEP_DUP2: j_set_closure_error_dup2 (&tmperr, header.errno_value, "dup2 ()!"); break;
+          case J_SPAWN_STEP_EXEC: j_set_closure_error_execvp (&tmperr, header.errno_value, "exec (\"%s\")!", subject); break;
+          case J_SPAWN_STEP_OPEN: j_set_closure_error_open (&tmperr, header.errno_value, "open (\"%s\")!", subject); break;
+          default: g_assert_not_reached ();
+        }
+
+      g_printerr ("%s: %i: %s\n", g_quark_to_string (tmperr->domain), tmperr->code, tmperr->message);
+      g_error_free (tmperr);
+      g_free (subject);
+    }
+
+  g_close (report [0], NULL);
+return pid;
+}
+
+pid_t j_spawn_fork (JPipe report, GError** error)
+{
+  pid_t pid;
+
+  if (pipe2 (report, O_CLOEXEC) < 0)
+    return (j_set_closure_error_pipe (error, errno, "pipe ()!"), -1);
+  if ((pid = fork ()) < 0)
+    {
+      j_set_closure_error_fork (error, errno, "fork ()!");
+      g_close (report [0], NULL);
+      g_close (report [1], NULL);
+    }
+return pid;
+}
+
+gint j_spawn_open (gint report, const gchar* filename, gint flags, gint mode)
+{
+  glong fd;
+
+  if ((fd = syscall (SYS_open, filename, flags, mode)) < 0)
+    j_spawn_fail (report, J_SPAWN_STEP_OPEN, filename, errno);
+return (gint) fd;
+}
+
+void j_spawn_signal_default (gint signo)
+{
+  /* Kernel's struct sigaction, all zeroes is SIG_DFL with an empty mask */
+  gpointer action [4] = {0};
+  syscall (SYS_rt_sigaction, signo, action, NULL, _NSIG / 8);
+}
+
 gint j_waitpid (pid_t pid, gint* status_code, gint flags, GError** error)
 {
   gint result = 0;
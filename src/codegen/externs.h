@@ -17,22 +17,46 @@
 #ifndef __JASH_CODEGEN_EXTERNS__
 #define __JASH_CODEGEN_EXTERNS__ 1
 #include <glib.h>
+#include <parser/arithmetic.h>
+#include <runtime/runner.h>
 #include <unistd.h>
 
+typedef gint JPipe [2];
+
+typedef enum
+{
+  J_SPAWN_STEP_DUP2,
+  J_SPAWN_STEP_EXEC,
+  J_SPAWN_STEP_OPEN,
+} JSpawnStep;
+
 #if __cplusplus
 extern "C" {
 #endif // __cplusplus
 
+  G_GNUC_INTERNAL gboolean j_arithmetic_apply (JArithmeticOpcode opcode, gint64 lhs, gint64 rhs, gint64* result, GError** error);
+  G_GNUC_INTERNAL gint64 j_arithmetic_load (JRunner* runner, const gchar* name, GError** error);
   G_GNUC_INTERNAL void j_chdir (const gchar* path, GError** error);
   G_GNUC_INTERNAL void j_dup2 (gint fd_old, gint fd_new, GError** error);
-  G_GNUC_INTERNAL void j_execvp (const gchar* program, gchar* const arguments [], GError** error);
+  G_GNUC_INTERNAL void j_expand_builtin (JRunner* runner, gchar** value, const gchar* builtin, const gchar* argument);
+  G_GNUC_INTERNAL void j_expand_file (gchar** value, const gchar* filename, GError** error);
+  G_GNUC_INTERNAL void j_expand_int (gchar** value, gint64 number);
+  G_GNUC_INTERNAL void j_expand_value (gchar** value, const gchar* source);
   G_GNUC_INTERNAL pid_t j_fork (GError** error);
   G_GNUC_INTERNAL guint j_invoke_get_open_flags (gint fileno, gboolean append);
   G_GNUC_INTERNAL guint j_invoke_get_open_mode (gint fileno, gboolean append);
   G_GNUC_INTERNAL gint j_open (const gchar* filename, gint flags, gint mode, GError** error);
   G_GNUC_INTERNAL gint j_parse_int (const gchar* value, GError** error);
+  G_GNUC_INTERNAL gint64 j_parse_int64 (const gchar* value, GError** error);
   G_GNUC_INTERNAL void j_pipe_clear_many (JPipe* pipes, guint n_pipes);
   G_GNUC_INTERNAL void j_pipe_init_many (JPipe* pipes, guint n_pipes, GError** error);
+  G_GNUC_INTERNAL void j_spawn_dup2 (gint report, gint fd_old, gint fd_new);
+  G_GNUC_INTERNAL void j_spawn_exec (const gchar* program, gchar* const arguments [], gchar* const envp [], gint report) G_GNUC_NORETURN;
+  G_GNUC_INTERNAL void j_spawn_fail (gint report, JSpawnStep step, const gchar* subject, gint errno_value) G_GNUC_NORETURN;
+  G_GNUC_INTERNAL pid_t j_spawn_finish (pid_t pid, JPipe report);
+  G_GNUC_INTERNAL pid_t j_spawn_fork (JPipe report, GError** error);
+  G_GNUC_INTERNAL gint j_spawn_open (gint report, const gchar* filename, gint flags, gint mode);
+  G_GNUC_INTERNAL void j_spawn_signal_default (gint signo);
   G_GNUC_INTERNAL gint j_waitpid (pid_t pid, gint* status_code, gint flags, GError** error);
 
 #if __cplusplus
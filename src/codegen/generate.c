@@ -19,13 +19,20 @@
 #include <codegen/context.h>
 #include <codegen/walker.h>
 
+#define J_CONTEXT_COLD_RATIO (16)
+#define J_CONTEXT_LAZY_THRESHOLD (48)
+
+static gboolean branch_is_cold (Dst_DECL, guint site, guint side);
 static void walk_argument (Dst_DECL, JWalker* walker, JAst* ast, JArgument* argument);
 static void walk_command (Dst_DECL, JWalker* walker, JAst* ast, gint in_pipe, gint out_pipe);
 static void walk_expression (Dst_DECL, JAst* ast, const JTag* tag, const JTag* tag_next);
 static void walk_detach (Dst_DECL, JAst* ast, const JTag* tag, const JTag* tag_next);
+static void walk_function (Dst_DECL, JAst* ast, const JTag* tag, const JTag* tag_next);
 static void walk_ifclosure (Dst_DECL, JAst* ast, const JTag* tag, const JTag* tag_next);
 static void walk_invoke (Dst_DECL, JWalker* walker, JAst* ast, gint in_pipe, gint out_pipe);
+static gboolean walk_lazy (Dst_DECL, JAst* ast, const JTag* tag, const JTag* tag_next);
 static void walk_logical (Dst_DECL, JAst* ast, const JTag* tag, const JTag* tag_next);
+static void walk_loopclosure (Dst_DECL, JAst* ast, const JTag* tag, const JTag* tag_next);
 static void walk_pipe (Dst_DECL, JWalker* walker, JAst* ast, gint in_pipe, gint out_pipe);
 static void walk_scope (Dst_DECL, JAst* ast, const JTag* tag, const JTag* tag_next);
 static void walk_target (Dst_DECL, JWalker* walker, JAst* ast, JInvoke* invoke);
@@ -39,6 +46,42 @@ void j_context_generate (Dst_DECL, JAst* ast, const JTag* tag)
   j_context_emit_chain_last (Dst, &tag_last);
 }
 
+void j_context_generate_lazy (Dst_DECL, JAst* ast, gpointer continuation, const JTag* tag)
+{
+  JTag tag_next = {0};
+
+  j_tag_init (Dst, &tag_next);
+
+  switch (j_ast_get_ast_type (ast))
+    {
+      case J_AST_TYPE_IFCLOSURE_DIRECT:
+      case J_AST_TYPE_IFCLOSURE_REVERSE:
+      case J_AST_TYPE_LOOPCLOSURE_BODY:
+        walk_scope (Dst, ast, tag, &tag_next);
+        break;
+      default:
+        walk_expression (Dst, ast, tag, &tag_next);
+        break;
+    }
+
+  j_context_emit_absolute_jump (Dst, continuation, &tag_next);
+}
+
+/*
+ * Sides are 0 for the direct branch and 1 for the reverse
+ * one, as counted by the test sites of a profiled closure
+ */
+static gboolean branch_is_cold (Dst_DECL, guint site, guint side)
+{
+  const guint* counts = NULL;
+
+  if (Dst->profile == NULL || site >= Dst->n_profile)
+    return FALSE;
+
+  counts = Dst->profile + site * 2;
+return (guint64) counts [side] * J_CONTEXT_COLD_RATIO < counts [side ^ 1];
+}
+
 static void walk_argument (Dst_DECL, JWalker* walker, JAst* ast, JArgument* argument)
 {
   switch (j_ast_get_ast_type (ast))
@@ -54,17 +97,41 @@ static void walk_argument (Dst_DECL, JWalker* walker, JAst* ast, JArgument* argu
           argument->index = j_walker_add_argument (walker, data->data);
           break;
         }
+      case J_AST_TYPE_ARITHMETIC:
+        {
+          argument->type = J_ARGUMENT_TYPE_EXPANSION;
+          argument->index = j_walker_add_arithmetic (walker, ast);
+          break;
+        }
       case J_AST_TYPE_EXPANSION:
         {
+          const gchar* builtin = NULL;
+          const gchar* value = NULL;
           JTag tag_head, tag_last;
+          guint type;
 
-          j_tag_init (Dst, &tag_head);
-          j_tag_init (Dst, &tag_last);
-          walk_scope (Dst, ast, &tag_head, &tag_last);
-          j_context_emit_chain_last (Dst, &tag_last);
+          argument->type = J_ARGUMENT_TYPE_EXPANSION;
+
+          if ((type = j_expansion_classify (ast, &builtin, &value)) != J_EXPANSION_TYPE_FORK)
+            argument->index = j_walker_add_expansion_inline (walker, type, builtin, value);
+          else
+            {
+              j_tag_init (Dst, &tag_head);
+              j_tag_init (Dst, &tag_last);
+              walk_scope (Dst, ast, &tag_head, &tag_last);
+              j_context_emit_chain_last (Dst, &tag_last);
+
+              argument->index = j_walker_add_expansion (walker, &tag_head);
+            }
+          break;
+        }
+      case J_AST_TYPE_VARIABLE:
+        {
+          JAst* data = j_ast_get_first_child (ast);
+          const gchar* name = j_ast_get_first_child (data)->data;
 
           argument->type = J_ARGUMENT_TYPE_EXPANSION;
-          argument->index = j_walker_add_expansion (walker, &tag_head);
+          argument->index = j_walker_add_expansion_inline (walker, J_EXPANSION_TYPE_VARIABLE, NULL, name);
           break;
         }
       default: g_assert_not_reached ();
@@ -92,11 +159,11 @@ static void walk_expression (Dst_DECL, JAst* ast, const JTag* tag, const JTag* t
     case J_AST_TYPE_INVOKE:
     case J_AST_TYPE_PIPE:
       {
-        JWalker walker = J_WALKER_INIT;
+        JWalker* walker = j_context_walker_acquire (Dst);
 
-        walk_command (Dst, &walker, ast, -1, -1);
-        j_context_emit_chain_step (Dst, &walker, tag, tag_next);
-        j_walker_clear (&walker);
+        walk_command (Dst, walker, ast, -1, -1);
+        j_context_emit_chain_step (Dst, walker, tag, tag_next);
+        j_context_walker_release (Dst, walker);
         break;
       }
     default: g_assert_not_reached ();
@@ -105,18 +172,28 @@ static void walk_expression (Dst_DECL, JAst* ast, const JTag* tag, const JTag* t
 
 static void walk_detach (Dst_DECL, JAst* ast, const JTag* tag, const JTag* tag_next)
 {
-  guint index = g_queue_get_length (&Dst->detachables);
+  guint index = Dst->detachables_base + g_queue_get_length (&Dst->detachables);
 
   j_context_emit_chain_step_detach (Dst, index, tag, tag_next);
   g_queue_push_tail (&Dst->detachables, ast);
 }
 
+static void walk_function (Dst_DECL, JAst* ast, const JTag* tag, const JTag* tag_next)
+{
+  guint index = Dst->detachables_base + g_queue_get_length (&Dst->detachables);
+
+  j_context_emit_chain_step_function (Dst, index, tag, tag_next);
+  g_queue_push_tail (&Dst->detachables, ast);
+}
+
 static void walk_ifclosure (Dst_DECL, JAst* ast, const JTag* tag, const JTag* tag_next)
 {
   JAst* condition = j_ast_find_child (ast, J_AST_TYPE_IFCLOSURE_CONDITION);
   JAst* direct = j_ast_find_child (ast, J_AST_TYPE_IFCLOSURE_DIRECT);
   JAst* reverse = j_ast_find_child (ast, J_AST_TYPE_IFCLOSURE_REVERSE);
   JTag tag_condition, tag_direct, tag_reverse, tag_test;
+  gboolean cold_direct, cold_reverse;
+  guint site;
 #if DEVELOPER == 1
   g_assert (condition != NULL);
 #endif // DEVELOPER
@@ -127,12 +204,19 @@ static void walk_ifclosure (Dst_DECL, JAst* ast, const JTag* tag, const JTag* ta
   j_tag_init (Dst, &tag_test);
 
   walk_scope (Dst, condition, tag, &tag_condition);
-  j_context_emit_test (Dst, &tag_condition, &tag_direct, &tag_reverse);
-
-  if (direct != NULL) walk_scope (Dst, direct, &tag_direct, tag_next);
-  else j_context_emit_chain_empty (Dst, &tag_direct, tag_next);
-  if (reverse != NULL) walk_scope (Dst, reverse, &tag_reverse, tag_next);
-  else j_context_emit_chain_empty (Dst, &tag_reverse, tag_next);
+  j_context_emit_test (Dst, site = Dst->n_sites++, &tag_condition, &tag_direct, &tag_reverse);
+
+  cold_direct = branch_is_cold (Dst, site, 0);
+  cold_reverse = branch_is_cold (Dst, site, 1);
+
+  if (cold_direct) j_context_enter_cold (Dst);
+  if (direct == NULL) j_context_emit_chain_empty (Dst, &tag_direct, tag_next);
+  else if (!walk_lazy (Dst, direct, &tag_direct, tag_next)) walk_scope (Dst, direct, &tag_direct, tag_next);
+  if (cold_direct) j_context_leave_cold (Dst);
+  if (cold_reverse) j_context_enter_cold (Dst);
+  if (reverse == NULL) j_context_emit_chain_empty (Dst, &tag_reverse, tag_next);
+  else if (!walk_lazy (Dst, reverse, &tag_reverse, tag_next)) walk_scope (Dst, reverse, &tag_reverse, tag_next);
+  if (cold_reverse) j_context_leave_cold (Dst);
 }
 
 static gint adjust_stdfile (union _JInvokeStdfile* file, JAst* redirect, gint pipe)
@@ -194,7 +278,7 @@ static void walk_invoke (Dst_DECL, JWalker* walker, JAst* ast, gint in_pipe, gin
 #endif // DEVELOPER
 
   gint count = j_ast_n_children (arguments);
-  JInvoke* invoke = j_invoke_new (count);
+  JInvoke* invoke = j_walker_new_invoke (walker, count);
   JArgument* targ = & invoke->target;
   JArgument* args = & invoke->first_argument;
   guint i;
@@ -222,6 +306,24 @@ static void walk_invoke (Dst_DECL, JWalker* walker, JAst* ast, gint in_pipe, gin
   G_STMT_END;
 }
 
+static gboolean walk_lazy (Dst_DECL, JAst* ast, const JTag* tag, const JTag* tag_next)
+{
+  JLazyStub* stub = NULL;
+  guint index;
+
+  if (Dst->eager || g_node_n_nodes (ast, G_TRAVERSE_ALL) < J_CONTEXT_LAZY_THRESHOLD)
+    return FALSE;
+
+  index = Dst->lazies_base + g_queue_get_length (&Dst->lazies);
+  stub = g_slice_new (JLazyStub);
+  stub->ast = ast;
+
+  j_tag_copy (tag_next, &stub->tag_next);
+  j_context_emit_chain_step_lazy (Dst, index, tag);
+  g_queue_push_tail (&Dst->lazies, stub);
+return TRUE;
+}
+
 static void walk_logical (Dst_DECL, JAst* ast, const JTag* tag, const JTag* tag_next)
 {
 #if DEVELOPER == 1
@@ -230,6 +332,8 @@ static void walk_logical (Dst_DECL, JAst* ast, const JTag* tag, const JTag* tag_
   JAst* child1 = j_ast_get_first_child (ast);
   JAst* child2 = j_ast_get_next_sibling (child1);
   JTag tag_condition, tag_direct, tag_reverse, tag_test;
+  gboolean cold_direct, cold_reverse;
+  guint site;
 
   j_tag_init (Dst, &tag_condition);
   j_tag_init (Dst, &tag_direct);
@@ -237,22 +341,100 @@ static void walk_logical (Dst_DECL, JAst* ast, const JTag* tag, const JTag* tag_
   j_tag_init (Dst, &tag_test);
 
   walk_expression (Dst, child1, tag, &tag_condition);
-  j_context_emit_test (Dst, &tag_condition, &tag_direct, &tag_reverse);
+  j_context_emit_test (Dst, site = Dst->n_sites++, &tag_condition, &tag_direct, &tag_reverse);
+
+  cold_direct = branch_is_cold (Dst, site, 0);
+  cold_reverse = branch_is_cold (Dst, site, 1);
 
   switch (j_ast_get_ast_type (ast))
   {
     case J_AST_TYPE_LOGICAL_AND:
+      if (cold_reverse) j_context_enter_cold (Dst);
       j_context_emit_chain_empty (Dst, &tag_reverse, tag_next);
-      walk_expression (Dst, child2, &tag_direct, tag_next);
+      if (cold_reverse) j_context_leave_cold (Dst);
+      if (cold_direct) j_context_enter_cold (Dst);
+      if (!walk_lazy (Dst, child2, &tag_direct, tag_next))
+        walk_expression (Dst, child2, &tag_direct, tag_next);
+      if (cold_direct) j_context_leave_cold (Dst);
       break;
     case J_AST_TYPE_LOGICAL_OR:
+      if (cold_direct) j_context_enter_cold (Dst);
       j_context_emit_chain_empty (Dst, &tag_direct, tag_next);
-      walk_expression (Dst, child2, &tag_reverse, tag_next);
+      if (cold_direct) j_context_leave_cold (Dst);
+      if (cold_reverse) j_context_enter_cold (Dst);
+      if (!walk_lazy (Dst, child2, &tag_reverse, tag_next))
+        walk_expression (Dst, child2, &tag_reverse, tag_next);
+      if (cold_reverse) j_context_leave_cold (Dst);
       break;
     default: g_assert_not_reached ();
   }
 }
 
+static void walk_loopclosure (Dst_DECL, JAst* ast, const JTag* tag, const JTag* tag_next)
+{
+  JAst* header = j_ast_get_first_child (ast);
+  JAst* body = j_ast_find_child (ast, J_AST_TYPE_LOOPCLOSURE_BODY);
+  JTag tag_body, tag_condition, tag_yield;
+  const JTag* tag_back = tag;
+  gboolean cold_body = FALSE;
+  guint site;
+#if DEVELOPER == 1
+  g_assert (header != NULL);
+  g_assert (body != NULL);
+#endif // DEVELOPER
+
+  j_tag_init (Dst, &tag_body);
+  j_tag_init (Dst, &tag_condition);
+  j_tag_init (Dst, &tag_yield);
+
+  switch (j_ast_get_ast_type (header))
+  {
+    case J_AST_TYPE_LOOPCLOSURE_FOR:
+      {
+        JAst* name = j_ast_find_child (header, J_AST_TYPE_DATA);
+        JAst* words = j_ast_find_child (header, J_AST_TYPE_ARGUMENTS);
+        JWalker* walker = j_context_walker_acquire (Dst);
+        JInvoke* invoke = j_walker_new_invoke (walker, j_ast_n_children (words));
+        JArgument* args = & invoke->first_argument;
+        JAst* child;
+        guint i;
+
+        for (child = j_ast_get_first_child (words), i = 0;
+             child;
+             child = j_ast_get_next_sibling (child), ++i)
+          walk_argument (Dst, walker, child, args + i);
+          walk_argument (Dst, walker, name, & invoke->target);
+
+        invoke->target_type = J_INVOKE_TARGET_TYPE_REGULAR;
+        j_walker_add_invoke (walker, invoke);
+        j_context_emit_loop (Dst, walker, tag, &tag_condition, &tag_body, tag_next);
+        j_context_walker_release (Dst, walker);
+        tag_back = &tag_condition;
+        break;
+      }
+    case J_AST_TYPE_LOOPCLOSURE_UNTIL:
+      walk_scope (Dst, header, tag, &tag_condition);
+      j_context_emit_test (Dst, site = Dst->n_sites++, &tag_condition, tag_next, &tag_body);
+      cold_body = branch_is_cold (Dst, site, 1);
+      break;
+    case J_AST_TYPE_LOOPCLOSURE_WHILE:
+      walk_scope (Dst, header, tag, &tag_condition);
+      j_context_emit_test (Dst, site = Dst->n_sites++, &tag_condition, &tag_body, tag_next);
+      cold_body = branch_is_cold (Dst, site, 0);
+      break;
+    default: g_assert_not_reached ();
+  }
+
+  /* The exit edge lands on whatever follows the loop, so only the body can move */
+  if (cold_body) j_context_enter_cold (Dst);
+  if (j_ast_get_first_child (body) == NULL) j_context_emit_chain_empty (Dst, &tag_body, &tag_yield);
+  else if (!walk_lazy (Dst, body, &tag_body, &tag_yield)) walk_scope (Dst, body, &tag_body, &tag_yield);
+
+  /* Back-edges return to the runner, so a loop of fused steps still lets it run jobs */
+  j_context_emit_chain_yield (Dst, &tag_yield, tag_back);
+  if (cold_body) j_context_leave_cold (Dst);
+}
+
 static void walk_pipe (Dst_DECL, JWalker* walker, JAst* ast, gint in_pipe, gint out_pipe)
 {
 #if DEVELOPER == 1
@@ -288,9 +470,15 @@ static void walk_scope (Dst_DECL, JAst* ast, const JTag* tag_head, const JTag* t
           case J_AST_TYPE_DETACH:
             walk_detach (Dst, child, &tag, &tag_next);
             break;
+          case J_AST_TYPE_FUNCTION:
+            walk_function (Dst, child, &tag, &tag_next);
+            break;
           case J_AST_TYPE_IFCLOSURE:
             walk_ifclosure (Dst, child, &tag, &tag_next);
             break;
+          case J_AST_TYPE_LOOPCLOSURE:
+            walk_loopclosure (Dst, child, &tag, &tag_next);
+            break;
           case J_AST_TYPE_INVOKE:
           case J_AST_TYPE_LOGICAL_AND:
           case J_AST_TYPE_LOGICAL_OR:
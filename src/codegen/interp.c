@@ -0,0 +1,1211 @@
+/* Copyright 2023 MarcosHCK
+ * This file is part of JASH.
+ *
+ * JASH is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * JASH is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with JASH. If not, see <http://www.gnu.org/licenses/>.
+ */
+#include <config.h>
+#include <codegen/closure.h>
+#include <codegen/codegen.h>
+#include <codegen/context.h>
+#include <codegen/debug/dump.h>
+#include <codegen/debug/stats.h>
+#include <codegen/externs.h>
+#include <codegen/walker.h>
+#include <dossier/dossier.h>
+#include <glib/gstdio.h>
+#include <lexer/token.h>
+#include <signal.h>
+#include <term/readline.h>
+
+#define J_INTERP_PC_FAIL (G_MAXUINT)
+typedef struct _JInterp JInterp;
+typedef struct _JProgram JProgram;
+typedef struct _JStep JStep;
+
+/*
+ * The interpreter tier runs the same step graph j_context_generate ()
+ * would emit, but walks it from C instead of compiling it first. It is
+ * meant for lines which run once, where the cost of dasm_link () plus
+ * dasm_encode () plus mmap () dwarfs the execution itself.
+ */
+
+struct _JInterp
+{
+  JClosure closure;
+  JProgram* program;
+  guint pc;
+};
+
+struct _JProgram
+{
+  GArray* steps;
+  GQueue detachables;
+  GStringChunk* strings;
+  GPtrArray* walkers;
+  guint max_expansions;
+};
+
+struct _JStep
+{
+  guint type;
+  guint next;
+  guint alt;
+  JWalker* walker;
+};
+
+enum
+{
+  J_STEP_DETACH,
+  J_STEP_EMPTY,
+  J_STEP_EXPANSIONS,
+  J_STEP_EXPRESSION,
+  J_STEP_FUNCTION,
+  J_STEP_LAST,
+  J_STEP_LOOP_ENTER,
+  J_STEP_LOOP_NEXT,
+  J_STEP_SPLICE,
+  J_STEP_TEST,
+};
+
+typedef enum
+{
+  INVOKE_CHILD,
+  INVOKE_FAIL,
+  INVOKE_LEAVE,
+  INVOKE_PARENT,
+  INVOKE_STOP,
+} InvokeResult;
+
+static void lower_argument (JProgram* program, JWalker* walker, JAst* ast, JArgument* argument);
+static void lower_command (JProgram* program, JWalker* walker, JAst* ast, gint in_pipe, gint out_pipe);
+static void lower_detach (JProgram* program, JAst* ast, guint step, guint step_next);
+static void lower_expression (JProgram* program, JAst* ast, guint step, guint step_next);
+static void lower_function (JProgram* program, JAst* ast, guint step, guint step_next);
+static void lower_ifclosure (JProgram* program, JAst* ast, guint step, guint step_next);
+static void lower_invoke (JProgram* program, JWalker* walker, JAst* ast, gint in_pipe, gint out_pipe);
+static void lower_logical (JProgram* program, JAst* ast, guint step, guint step_next);
+static void lower_loopclosure (JProgram* program, JAst* ast, guint step, guint step_next);
+static void lower_pipe (JProgram* program, JWalker* walker, JAst* ast, gint in_pipe, gint out_pipe);
+static void lower_scope (JProgram* program, JAst* ast, guint step_head, guint step_last);
+static void lower_target (JProgram* program, JWalker* walker, JAst* ast, JInvoke* invoke);
+
+#define step_at(program,index) (& g_array_index ((program)->steps, JStep, (index)))
+
+static guint step_new (JProgram* program)
+{
+  JStep step = {0};
+  guint index = program->steps->len;
+                g_array_append_val (program->steps, step);
+      return index;
+}
+
+static void step_set (JProgram* program, guint index, guint type, guint next, guint alt, JWalker* walker)
+{
+  JStep* step = step_at (program, index);
+
+  step->type = type;
+  step->next = next;
+  step->alt = alt;
+  step->walker = walker;
+}
+
+static const gchar* program_intern (JProgram* program, const gchar* value)
+{
+  return g_string_chunk_insert_const (program->strings, value);
+}
+
+static void walker_free (JWalker* walker)
+{
+  j_walker_clear (walker);
+  g_slice_free (JWalker, walker);
+}
+
+static void program_free (JProgram* program)
+{
+  g_array_unref (program->steps);
+  g_queue_clear (&program->detachables);
+  g_ptr_array_unref (program->walkers);
+  g_string_chunk_free (program->strings);
+  g_slice_free (JProgram, program);
+}
+
+static JProgram* program_new (void)
+{
+  JProgram* program = g_slice_new0 (JProgram);
+
+  program->steps = g_array_new (FALSE, FALSE, sizeof (JStep));
+  program->strings = g_string_chunk_new (256);
+  program->walkers = g_ptr_array_new_with_free_func ((GDestroyNotify) walker_free);
+  g_queue_init (&program->detachables);
+return program;
+}
+
+static void lower_argument (JProgram* program, JWalker* walker, JAst* ast, JArgument* argument)
+{
+  switch (j_ast_get_ast_type (ast))
+    {
+      case J_AST_TYPE_DATA:
+        {
+  #if DEVELOPER == 1
+          g_assert (j_ast_n_children (ast) == 1);
+  #endif // DEVELOPER
+          JAst* data = j_ast_get_first_child (ast);
+
+          argument->type = J_ARGUMENT_TYPE_DATA;
+          argument->index = j_walker_add_argument (walker, program_intern (program, data->data));
+          break;
+        }
+      case J_AST_TYPE_ARITHMETIC:
+        {
+          argument->type = J_ARGUMENT_TYPE_EXPANSION;
+          argument->index = j_walker_add_arithmetic (walker, ast);
+          break;
+        }
+      case J_AST_TYPE_EXPANSION:
+        {
+          const gchar* builtin = NULL;
+          const gchar* value = NULL;
+          guint step_head, step_last;
+          JTag tag_head;
+          guint type;
+
+          argument->type = J_ARGUMENT_TYPE_EXPANSION;
+
+          if ((type = j_expansion_classify (ast, &builtin, &value)) != J_EXPANSION_TYPE_FORK)
+            {
+              value = (value == NULL) ? NULL : program_intern (program, value);
+              argument->index = j_walker_add_expansion_inline (walker, type, builtin, value);
+            }
+          else
+            {
+              step_head = step_new (program);
+              step_last = step_new (program);
+              tag_head = GUINT_TO_POINTER (step_head);
+
+              lower_scope (program, ast, step_head, step_last);
+              step_set (program, step_last, J_STEP_LAST, 0, 0, NULL);
+
+              argument->index = j_walker_add_expansion (walker, &tag_head);
+            }
+          break;
+        }
+      case J_AST_TYPE_VARIABLE:
+        {
+          JAst* data = j_ast_get_first_child (ast);
+          const gchar* name = program_intern (program, j_ast_get_first_child (data)->data);
+
+          argument->type = J_ARGUMENT_TYPE_EXPANSION;
+          argument->index = j_walker_add_expansion_inline (walker, J_EXPANSION_TYPE_VARIABLE, NULL, name);
+          break;
+        }
+      default: g_assert_not_reached ();
+    }
+}
+
+static void lower_command (JProgram* program, JWalker* walker, JAst* ast, gint in_pipe, gint out_pipe)
+{
+  switch (j_ast_get_ast_type (ast))
+    {
+      case J_AST_TYPE_INVOKE: lower_invoke (program, walker, ast, in_pipe, out_pipe); break;
+      case J_AST_TYPE_PIPE: lower_pipe (program, walker, ast, in_pipe, out_pipe); break;
+      default: g_assert_not_reached ();
+    }
+}
+
+static gboolean detachable_link (JAst* ast, JProgram* program)
+{
+  JAst* parent = j_ast_get_parent (ast);
+
+  if (j_ast_get_ast_type (ast) == J_AST_TYPE_DATA)
+    {
+      if (parent == NULL || j_ast_get_ast_type (parent) != J_AST_TYPE_BUILTIN)
+        {
+          JAst* child = j_ast_get_first_child (ast);
+          child->data = (gpointer) program_intern (program, child->data);
+        }
+    }
+return FALSE;
+}
+
+static guint program_detach (JProgram* program, JAst* ast)
+{
+  const GTraverseType order = (GTraverseType) G_PRE_ORDER;
+  const GTraverseFlags flags = (GTraverseFlags) G_TRAVERSE_NON_LEAVES;
+  const GNodeTraverseFunc func = (GNodeTraverseFunc) detachable_link;
+  guint index = g_queue_get_length (&program->detachables);
+  JAst* copy = j_ast_copy (ast);
+
+  g_node_traverse (copy, order, flags, -1, func, program);
+  g_queue_push_tail (&program->detachables, copy);
+return index;
+}
+
+static void lower_detach (JProgram* program, JAst* ast, guint step, guint step_next)
+{
+  step_set (program, step, J_STEP_DETACH, step_next, program_detach (program, ast), NULL);
+}
+
+static void lower_expression (JProgram* program, JAst* ast, guint step, guint step_next)
+{
+  switch (j_ast_get_ast_type (ast))
+  {
+    case J_AST_TYPE_LOGICAL_AND:
+    case J_AST_TYPE_LOGICAL_OR:
+      lower_logical (program, ast, step, step_next);
+      break;
+    case J_AST_TYPE_INVOKE:
+    case J_AST_TYPE_PIPE:
+      {
+        JWalker* walker = g_slice_new0 (JWalker);
+        guint n_expansions;
+
+        g_ptr_array_add (program->walkers, walker);
+        lower_command (program, walker, ast, -1, -1);
+
+        if ((n_expansions = j_walker_n_expansions (walker)) == 0)
+          step_set (program, step, J_STEP_EXPRESSION, step_next, 0, walker);
+        else
+          {
+            guint splice = step_new (program);
+            guint intercept = step_new (program);
+
+            program->max_expansions = MAX (program->max_expansions, n_expansions);
+
+            step_set (program, step, J_STEP_EXPANSIONS, splice, 0, walker);
+            step_set (program, splice, J_STEP_SPLICE, intercept, 0, walker);
+            step_set (program, intercept, J_STEP_EXPRESSION, step_next, 0, walker);
+          }
+        break;
+      }
+    default: g_assert_not_reached ();
+  }
+}
+
+static void lower_function (JProgram* program, JAst* ast, guint step, guint step_next)
+{
+  step_set (program, step, J_STEP_FUNCTION, step_next, program_detach (program, ast), NULL);
+}
+
+static void lower_ifclosure (JProgram* program, JAst* ast, guint step, guint step_next)
+{
+  JAst* condition = j_ast_find_child (ast, J_AST_TYPE_IFCLOSURE_CONDITION);
+  JAst* direct = j_ast_find_child (ast, J_AST_TYPE_IFCLOSURE_DIRECT);
+  JAst* reverse = j_ast_find_child (ast, J_AST_TYPE_IFCLOSURE_REVERSE);
+  guint step_condition, step_direct, step_reverse;
+#if DEVELOPER == 1
+  g_assert (condition != NULL);
+#endif // DEVELOPER
+
+  step_condition = step_new (program);
+  step_direct = step_new (program);
+  step_reverse = step_new (program);
+
+  lower_scope (program, condition, step, step_condition);
+  step_set (program, step_condition, J_STEP_TEST, step_direct, step_reverse, NULL);
+
+  if (direct != NULL) lower_scope (program, direct, step_direct, step_next);
+  else step_set (program, step_direct, J_STEP_EMPTY, step_next, 0, NULL);
+  if (reverse != NULL) lower_scope (program, reverse, step_reverse, step_next);
+  else step_set (program, step_reverse, J_STEP_EMPTY, step_next, 0, NULL);
+}
+
+static gint adjust_stdfile (JProgram* program, union _JInvokeStdfile* file, JAst* redirect, gint pipe)
+{
+  if (redirect != NULL)
+    {
+  #if DEVELOPER == 1
+      g_assert (j_ast_n_children (redirect) == 1);
+  #endif // DEVELOPER
+      JAst* data_f = j_ast_find_child (redirect, J_AST_TYPE_DATA);
+  #if DEVELOPER == 1
+      g_assert (data_f != NULL);
+      g_assert (j_ast_n_children (data_f) == 1);
+  #endif // DEVELOPER
+      JAst* data_b = j_ast_get_first_child (data_f);
+
+      file->filename = program_intern (program, data_b->data);
+      return J_INVOKE_STD_FILE_TYPE_FILE;
+    }
+  else if (pipe >= 0)
+    {
+      file->fd = pipe;
+      return J_INVOKE_STD_FILE_TYPE_PIPE;
+    }
+  else
+    {
+      file->filename = NULL;
+      return J_INVOKE_STD_FILE_TYPE_FILE;
+    }
+}
+
+static void lower_invoke (JProgram* program, JWalker* walker, JAst* ast, gint in_pipe, gint out_pipe)
+{
+  JAst* arguments = NULL;
+  JAst* redirect_in = NULL;
+  JAst* redirect_out = NULL;
+  JAst* target = NULL;
+  JAst* child;
+
+  for (child = j_ast_get_first_child (ast);
+       child;
+       child = j_ast_get_next_sibling (child))
+    {
+      switch (j_ast_get_ast_type (child))
+        {
+          case J_AST_TYPE_ARGUMENTS: arguments = child; break;
+          case J_AST_TYPE_BUILTIN: target = child; break;
+          case J_AST_TYPE_REDIRECT_INPUT: redirect_in = child; break;
+          case J_AST_TYPE_REDIRECT_OUTPUT_APPEND: redirect_out = child; break;
+          case J_AST_TYPE_REDIRECT_OUTPUT_REPLACE: redirect_out = child; break;
+          case J_AST_TYPE_TARGET: target = child; break;
+          default: g_assert_not_reached ();
+        }
+    }
+
+#if DEVELOPER == 1
+  g_assert (arguments != NULL);
+  g_assert (target != NULL);
+#endif // DEVELOPER
+
+  gint count = j_ast_n_children (arguments);
+  JInvoke* invoke = j_walker_new_invoke (walker, count);
+  JArgument* args = & invoke->first_argument;
+  guint i;
+
+  for (child = j_ast_get_first_child (arguments), i = 0;
+       child;
+       child = j_ast_get_next_sibling (child), ++i)
+    lower_argument (program, walker, child, args + i);
+    lower_target (program, walker, target, invoke);
+
+  if (redirect_out != NULL)
+  switch (j_ast_get_ast_type (redirect_out))
+    {
+      case J_AST_TYPE_REDIRECT_OUTPUT_APPEND: invoke->stdout_mode = J_INVOKE_STD_FILE_MODE_APPEND; break;
+      case J_AST_TYPE_REDIRECT_OUTPUT_REPLACE: invoke->stdout_mode = J_INVOKE_STD_FILE_MODE_REPLACE; break;
+      default: g_assert_not_reached ();
+    }
+
+  G_STMT_START
+    {
+      invoke->stdin_type = adjust_stdfile (program, & invoke->stdin, redirect_in, in_pipe);
+      invoke->stdout_type = adjust_stdfile (program, & invoke->stdout, redirect_out, out_pipe);
+      j_walker_add_invoke (walker, invoke);
+    }
+  G_STMT_END;
+}
+
+static void lower_logical (JProgram* program, JAst* ast, guint step, guint step_next)
+{
+#if DEVELOPER == 1
+  g_assert (j_ast_n_children (ast) == 2);
+#endif // DEVELOPER
+  JAst* child1 = j_ast_get_first_child (ast);
+  JAst* child2 = j_ast_get_next_sibling (child1);
+  guint step_condition, step_direct, step_reverse;
+
+  step_condition = step_new (program);
+  step_direct = step_new (program);
+  step_reverse = step_new (program);
+
+  lower_expression (program, child1, step, step_condition);
+  step_set (program, step_condition, J_STEP_TEST, step_direct, step_reverse, NULL);
+
+  switch (j_ast_get_ast_type (ast))
+  {
+    case J_AST_TYPE_LOGICAL_AND:
+      step_set (program, step_reverse, J_STEP_EMPTY, step_next, 0, NULL);
+      lower_expression (program, child2, step_direct, step_next);
+      break;
+    case J_AST_TYPE_LOGICAL_OR:
+      step_set (program, step_direct, J_STEP_EMPTY, step_next, 0, NULL);
+      lower_expression (program, child2, step_reverse, step_next);
+      break;
+    default: g_assert_not_reached ();
+  }
+}
+
+static void lower_loopclosure (JProgram* program, JAst* ast, guint step, guint step_next)
+{
+  JAst* header = j_ast_get_first_child (ast);
+  JAst* body = j_ast_find_child (ast, J_AST_TYPE_LOOPCLOSURE_BODY);
+  guint step_body, step_condition;
+  guint step_back = step;
+#if DEVELOPER == 1
+  g_assert (header != NULL);
+  g_assert (body != NULL);
+#endif // DEVELOPER
+
+  step_body = step_new (program);
+  step_condition = step_new (program);
+
+  switch (j_ast_get_ast_type (header))
+  {
+    case J_AST_TYPE_LOOPCLOSURE_FOR:
+      {
+        JAst* name = j_ast_find_child (header, J_AST_TYPE_DATA);
+        JAst* words = j_ast_find_child (header, J_AST_TYPE_ARGUMENTS);
+        JWalker* walker = g_slice_new0 (JWalker);
+        JInvoke* invoke = j_walker_new_invoke (walker, j_ast_n_children (words));
+        JArgument* args = & invoke->first_argument;
+        guint n_expansions;
+        JAst* child;
+        guint i;
+
+        g_ptr_array_add (program->walkers, walker);
+
+        for (child = j_ast_get_first_child (words), i = 0;
+             child;
+             child = j_ast_get_next_sibling (child), ++i)
+          lower_argument (program, walker, child, args + i);
+          lower_argument (program, walker, name, & invoke->target);
+
+        invoke->target_type = J_INVOKE_TARGET_TYPE_REGULAR;
+        j_walker_add_invoke (walker, invoke);
+
+        if ((n_expansions = j_walker_n_expansions (walker)) == 0)
+          step_set (program, step, J_STEP_LOOP_ENTER, step_condition, 0, walker);
+        else
+          {
+            guint splice = step_new (program);
+            guint intercept = step_new (program);
+
+            program->max_expansions = MAX (program->max_expansions, n_expansions);
+
+            step_set (program, step, J_STEP_EXPANSIONS, splice, 0, walker);
+            step_set (program, splice, J_STEP_SPLICE, intercept, 0, walker);
+            step_set (program, intercept, J_STEP_LOOP_ENTER, step_condition, 0, walker);
+          }
+
+        step_set (program, step_condition, J_STEP_LOOP_NEXT, step_body, step_next, walker);
+        step_back = step_condition;
+        break;
+      }
+    case J_AST_TYPE_LOOPCLOSURE_UNTIL:
+      lower_scope (program, header, step, step_condition);
+      step_set (program, step_condition, J_STEP_TEST, step_next, step_body, NULL);
+      break;
+    case J_AST_TYPE_LOOPCLOSURE_WHILE:
+      lower_scope (program, header, step, step_condition);
+      step_set (program, step_condition, J_STEP_TEST, step_body, step_next, NULL);
+      break;
+    default: g_assert_not_reached ();
+  }
+
+  lower_scope (program, body, step_body, step_back);
+}
+
+static void lower_pipe (JProgram* program, JWalker* walker, JAst* ast, gint in_pipe, gint out_pipe)
+{
+#if DEVELOPER == 1
+  g_assert (j_ast_n_children (ast) == 2);
+#endif // DEVELOPER
+  JAst* child1 = j_ast_get_first_child (ast);
+  JAst* child2 = j_ast_get_next_sibling (child1);
+  gint cur_pipe = j_walker_add_pipe (walker);
+
+  lower_command (program, walker, child1, in_pipe, cur_pipe);
+  lower_command (program, walker, child2, cur_pipe, out_pipe);
+}
+
+static void lower_scope (JProgram* program, JAst* ast, guint step_head, guint step_last)
+{
+  guint step = step_head;
+  guint step_next = 0;
+  JAst* child = NULL;
+
+  if (j_ast_get_first_child (ast) == NULL)
+    step_set (program, step_head, J_STEP_EMPTY, step_last, 0, NULL);
+
+  for (child = j_ast_get_first_child (ast);
+       child;
+       child = j_ast_get_next_sibling (child))
+    {
+      if (j_ast_get_next_sibling (child) != NULL)
+        step_next = step_new (program);
+      else
+        step_next = step_last;
+
+      switch (j_ast_get_ast_type (child))
+        {
+          case J_AST_TYPE_DETACH:
+            lower_detach (program, child, step, step_next);
+            break;
+          case J_AST_TYPE_FUNCTION:
+            lower_function (program, child, step, step_next);
+            break;
+          case J_AST_TYPE_IFCLOSURE:
+            lower_ifclosure (program, child, step, step_next);
+            break;
+          case J_AST_TYPE_LOOPCLOSURE:
+            lower_loopclosure (program, child, step, step_next);
+            break;
+          case J_AST_TYPE_INVOKE:
+          case J_AST_TYPE_LOGICAL_AND:
+          case J_AST_TYPE_LOGICAL_OR:
+          case J_AST_TYPE_PIPE:
+            lower_expression (program, child, step, step_next);
+            break;
+          default: g_assert_not_reached ();
+        }
+
+      step = step_next;
+    }
+}
+
+static void lower_target (JProgram* program, JWalker* walker, JAst* ast, JInvoke* invoke)
+{
+  JAst* child = j_ast_get_first_child (ast);
+#if DEVELOPER == 1
+  g_assert (j_ast_n_children (ast) == 1);
+#endif // DEVELOPER
+
+  switch (j_ast_get_ast_type (ast))
+    {
+      case J_AST_TYPE_BUILTIN:
+        {
+  #if DEVELOPER == 1
+          g_assert (j_ast_get_ast_type (child) == J_AST_TYPE_DATA);
+          g_assert (j_ast_n_children (child) == 1);
+  #endif // DEVELOPER
+          invoke->target_type = J_INVOKE_TARGET_TYPE_BUILTIN;
+          invoke->target.builtin = j_ast_get_first_child (child)->data;
+          break;
+        }
+      case J_AST_TYPE_TARGET:
+        {
+          invoke->target_type = J_INVOKE_TARGET_TYPE_REGULAR;
+          lower_argument (program, walker, child, & invoke->target);
+          break;
+        }
+      default: g_assert_not_reached ();
+    }
+}
+
+static const gchar* invoke_argument (JInterp* self, JWalker* walker, JInvoke* invoke, guint index)
+{
+  JArgument* argument = (& invoke->target) + index;
+
+  switch (argument->type)
+    {
+      case J_ARGUMENT_TYPE_DATA: return j_walker_get_argument (walker, argument->index);
+      case J_ARGUMENT_TYPE_EXPANSION: return self->closure.expansion_values [argument->index];
+      default: g_assert_not_reached ();
+    }
+}
+
+static void invoke_adjust_file (JInvoke* invoke, union _JInvokeStdfile* file, guint type, gint fileno, JPipe* pipes, GError** error)
+{
+  GError* tmperr = NULL;
+  gboolean append;
+  gint fd;
+
+  switch (type)
+  {
+    case J_INVOKE_STD_FILE_TYPE_FILE:
+      if (file->filename == NULL)
+        break;
+      else
+        {
+          append = invoke->stdout_mode == J_INVOKE_STD_FILE_MODE_APPEND;
+
+          const gint flags = j_invoke_get_open_flags (fileno, append);
+          const gint mode = j_invoke_get_open_mode (fileno, append);
+
+          if ((fd = j_open (file->filename, flags, mode, &tmperr)), G_UNLIKELY (tmperr != NULL))
+            g_propagate_error (error, tmperr);
+          else
+            {
+              if ((j_dup2 (fd, fileno, &tmperr)), G_UNLIKELY (tmperr != NULL))
+                g_propagate_error (error, tmperr);
+              g_close (fd, NULL);
+            }
+          break;
+        }
+    case J_INVOKE_STD_FILE_TYPE_PIPE:
+      if ((j_dup2 (pipes [file->fd] [fileno], fileno, &tmperr)), G_UNLIKELY (tmperr != NULL))
+        g_propagate_error (error, tmperr);
+      break;
+  }
+}
+
+static void invoke_adjust_io (JWalker* walker, JInvoke* invoke, JPipe* pipes, GError** error)
+{
+  GError* tmperr = NULL;
+
+  if ((invoke_adjust_file (invoke, & invoke->stdin, invoke->stdin_type, STDIN_FILENO, pipes, &tmperr)), G_UNLIKELY (tmperr != NULL))
+    g_propagate_error (error, tmperr);
+  else if ((invoke_adjust_file (invoke, & invoke->stdout, invoke->stdout_type, STDOUT_FILENO, pipes, &tmperr)), G_UNLIKELY (tmperr != NULL))
+    g_propagate_error (error, tmperr);
+  else if (walker->n_pipes > 0)
+    j_pipe_clear_many (pipes, walker->n_pipes);
+}
+
+static InvokeResult invoke_fork (gint* pid, GError** error)
+{
+  GError* tmperr = NULL;
+
+  if ((*pid = j_fork (&tmperr)), G_UNLIKELY (tmperr != NULL))
+    {
+      g_propagate_error (error, tmperr);
+      return INVOKE_FAIL;
+    }
+return (*pid > 0) ? INVOKE_PARENT : INVOKE_CHILD;
+}
+
+static InvokeResult invoke_fork_and_fail (JWalker* walker, JInvoke* invoke, JPipe* pipes, GError* reason, gint* pid, GError** error)
+{
+  InvokeResult result;
+
+  if ((result = invoke_fork (pid, error)) != INVOKE_CHILD)
+    g_error_free (reason);
+  else
+    {
+      g_propagate_error (error, reason);
+      invoke_adjust_io (walker, invoke, pipes, NULL);
+    }
+return result;
+}
+
+static InvokeResult invoke_fork_and_report (JWalker* walker, JInvoke* invoke, JPipe* pipes, gint exit_code, gint* pid, GError** error)
+{
+  InvokeResult result;
+  GError* tmperr = NULL;
+
+  if ((result = invoke_fork (pid, error)) == INVOKE_CHILD)
+    {
+      if ((invoke_adjust_io (walker, invoke, pipes, &tmperr)), G_UNLIKELY (tmperr != NULL))
+        g_propagate_error (error, tmperr);
+      else
+        j_set_closure_error_exit (error, exit_code);
+    }
+return result;
+}
+
+static void invoke_spawn_file (JInvoke* invoke, union _JInvokeStdfile* file, guint type, gint fileno, JPipe* pipes, gint report)
+{
+  gboolean append;
+  gint fd;
+
+  switch (type)
+  {
+    case J_INVOKE_STD_FILE_TYPE_FILE:
+      if (file->filename == NULL)
+        break;
+      else
+        {
+          append = invoke->stdout_mode == J_INVOKE_STD_FILE_MODE_APPEND;
+
+          const gint flags = j_invoke_get_open_flags (fileno, append);
+          const gint mode = j_invoke_get_open_mode (fileno, append);
+
+          fd = j_spawn_open (report, file->filename, flags, mode);
+          j_spawn_dup2 (report, fd, fileno);
+          close (fd);
+          break;
+        }
+    case J_INVOKE_STD_FILE_TYPE_PIPE:
+      j_spawn_dup2 (report, pipes [file->fd] [fileno], fileno);
+      break;
+  }
+}
+
+static InvokeResult invoke_builtin (JInterp* self, JRunner* runner, JWalker* walker, JInvoke* invoke, JPipe* pipes, gint* pid, GError** error)
+{
+  const gchar* value = invoke->target.builtin;
+  const gboolean interactive = j_runner_get_interactive (runner);
+  InvokeResult result;
+  GError* tmperr = NULL;
+  gint number = 0;
+
+#define argument(index) (invoke_argument (self, walker, invoke, (index)))
+
+  if (value == J_TOKEN_BUILTIN_AGAIN)
+    {
+      JReadline* readline = NULL;
+      const gchar* line = NULL;
+
+      if (walker->n_pipes > 0 || !interactive)
+        return invoke_fork_and_report (walker, invoke, pipes, 0, pid, error);
+
+      if (invoke->n_arguments > 0)
+        {
+          if ((number = j_parse_int (argument (1), &tmperr)), G_UNLIKELY (tmperr != NULL))
+            return invoke_fork_and_fail (walker, invoke, pipes, tmperr, pid, error);
+        }
+
+      if (invoke->n_arguments == 0)
+        line = j_readline_history_get (readline = j_readline_new ());
+      else
+        line = j_readline_history_get_nth (readline = j_readline_new (), number);
+
+      if ((g_object_unref (readline)), line == NULL)
+        return invoke_fork_and_report (walker, invoke, pipes, 0, pid, error);
+      else
+        {
+          j_set_closure_error_irq (error, G_TYPE_STRING, line);
+          return INVOKE_LEAVE;
+        }
+    }
+  else if (value == J_TOKEN_BUILTIN_CD)
+    {
+      if (walker->n_pipes == 0 && invoke->n_arguments > 0)
+        {
+          if ((j_chdir (argument (1), &tmperr)), G_UNLIKELY (tmperr != NULL))
+            return invoke_fork_and_fail (walker, invoke, pipes, tmperr, pid, error);
+        }
+      return invoke_fork_and_report (walker, invoke, pipes, 0, pid, error);
+    }
+  else if (value == J_TOKEN_BUILTIN_DUMPJIT)
+    {
+      if (walker->n_pipes == 0)
+        j_dump_toggle ();
+      return invoke_fork_and_report (walker, invoke, pipes, 0, pid, error);
+    }
+  else if (value == J_TOKEN_BUILTIN_EXIT)
+    {
+      if (walker->n_pipes > 0)
+        return invoke_fork_and_report (walker, invoke, pipes, 0, pid, error);
+
+      if (invoke->n_arguments > 0)
+        {
+          if ((number = j_parse_int (argument (1), &tmperr)), G_UNLIKELY (tmperr != NULL))
+            return invoke_fork_and_fail (walker, invoke, pipes, tmperr, pid, error);
+        }
+
+      j_set_closure_error_exit (error, number);
+      return INVOKE_STOP;
+    }
+  else if (value == J_TOKEN_BUILTIN_EXPORT)
+    {
+      if (invoke->n_arguments > 0)
+        j_runner_variable_export (runner, argument (1));
+      return invoke_fork_and_report (walker, invoke, pipes, 0, pid, error);
+    }
+  else if (value == J_TOKEN_BUILTIN_FALSE)
+    {
+      return invoke_fork_and_report (walker, invoke, pipes, 1, pid, error);
+    }
+  else if (value == J_TOKEN_BUILTIN_FG)
+    {
+      GClosure* closure = NULL;
+
+      if (walker->n_pipes > 0 || !interactive)
+        {
+          if ((result = invoke_fork (pid, error)) == INVOKE_CHILD)
+            g_set_error_literal (error, J_CLOSURE_ERROR, J_CLOSURE_ERROR_FAILED, "fg ! (no job control)");
+          return result;
+        }
+
+      if (invoke->n_arguments > 0)
+        {
+          if ((number = j_parse_int (argument (1), &tmperr)), G_UNLIKELY (tmperr != NULL))
+            return invoke_fork_and_fail (walker, invoke, pipes, tmperr, pid, error);
+        }
+
+      if (invoke->n_arguments == 0)
+        closure = j_runner_job_pop (runner);
+      else
+        closure = j_runner_job_pop_nth (runner, number);
+
+      if (closure == NULL)
+        {
+          if ((result = invoke_fork (pid, error)) == INVOKE_CHILD)
+            g_set_error_literal (error, J_CLOSURE_ERROR, J_CLOSURE_ERROR_FAILED, "fg ! (no such job)");
+          return result;
+        }
+      else
+        {
+          j_set_closure_error_irq (error, J_TYPE_CLOSURE, closure);
+          return INVOKE_LEAVE;
+        }
+    }
+  else if (value == J_TOKEN_BUILTIN_GET
+        || value == J_TOKEN_BUILTIN_HELP
+        || value == J_TOKEN_BUILTIN_HISTORY
+        || value == J_TOKEN_BUILTIN_JOBS
+        || value == J_TOKEN_BUILTIN_SET
+        || value == J_TOKEN_BUILTIN_STATS)
+    {
+      if (value == J_TOKEN_BUILTIN_GET && invoke->n_arguments == 0)
+        return invoke_fork_and_report (walker, invoke, pipes, 0, pid, error);
+
+      if (value == J_TOKEN_BUILTIN_SET && invoke->n_arguments > 0)
+        {
+          j_runner_variable_set (runner, argument (1), (invoke->n_arguments > 1) ? argument (2) : "");
+          return invoke_fork_and_report (walker, invoke, pipes, 0, pid, error);
+        }
+
+      if ((result = invoke_fork (pid, error)) != INVOKE_CHILD)
+        return result;
+      if ((invoke_adjust_io (walker, invoke, pipes, &tmperr)), G_UNLIKELY (tmperr != NULL))
+        return (g_propagate_error (error, tmperr), result);
+
+      if (value == J_TOKEN_BUILTIN_GET)
+        j_runner_variable_print (runner, argument (1));
+      else if (value == J_TOKEN_BUILTIN_HELP)
+        j_dossier_help ((invoke->n_arguments > 0) ? argument (1) : NULL);
+      else if (value == J_TOKEN_BUILTIN_HISTORY)
+        {
+          JReadline* readline = j_readline_new ();
+          j_readline_history_print (readline);
+          g_object_unref (readline);
+        }
+      else if (value == J_TOKEN_BUILTIN_JOBS)
+        j_runner_job_print_all (runner);
+      else if (value == J_TOKEN_BUILTIN_SET)
+        j_runner_variable_print_all (runner);
+      else if (value == J_TOKEN_BUILTIN_STATS)
+        j_stats_print (runner);
+
+      j_set_closure_error_exit (error, 0);
+      return result;
+    }
+  else if (value == J_TOKEN_BUILTIN_TRUE)
+    {
+      return invoke_fork_and_report (walker, invoke, pipes, 0, pid, error);
+    }
+  else if (value == J_TOKEN_BUILTIN_UNSET)
+    {
+      if (invoke->n_arguments > 0)
+        j_runner_variable_remove (runner, argument (1));
+      return invoke_fork_and_report (walker, invoke, pipes, 0, pid, error);
+    }
+  else g_assert_not_reached ();
+#undef argument
+}
+
+static InvokeResult invoke_regular (JInterp* self, JRunner* runner, JWalker* walker, JInvoke* invoke, JPipe* pipes, gint* pid, GError** error)
+{
+  const guint n_arguments = invoke->n_arguments + 1;
+  GError* tmperr = NULL;
+  GPtrArray* frame = NULL;
+  gchar** argv = NULL;
+  JPipe report;
+  guint i;
+
+  if (walker->n_pipes == 0 && j_invoke_is_inline (invoke))
+    {
+      if ((frame = j_runner_function_prepare (runner, invoke_argument (self, walker, invoke, 0))) != NULL)
+        {
+          for (i = 1; i < n_arguments; ++i)
+            j_runner_function_push (runner, frame, invoke_argument (self, walker, invoke, i));
+
+          j_set_closure_error_irq (error, G_TYPE_PTR_ARRAY, frame);
+          return INVOKE_LEAVE;
+        }
+    }
+
+  if ((*pid = j_spawn_fork (report, &tmperr)), G_UNLIKELY (tmperr != NULL))
+    return (g_propagate_error (error, tmperr), INVOKE_FAIL);
+  if (*pid > 0)
+    return (j_spawn_finish (*pid, report), INVOKE_PARENT);
+
+  invoke_spawn_file (invoke, & invoke->stdin, invoke->stdin_type, STDIN_FILENO, pipes, report [1]);
+  invoke_spawn_file (invoke, & invoke->stdout, invoke->stdout_type, STDOUT_FILENO, pipes, report [1]);
+  j_spawn_signal_default (SIGINT);
+  argv = g_newa (gchar*, n_arguments + 1);
+
+  for (i = 0; i < n_arguments; ++i)
+    argv [i] = (gchar*) invoke_argument (self, walker, invoke, i);
+
+  argv [n_arguments] = NULL;
+
+  j_spawn_exec (argv [0], argv, j_runner_get_envp (runner), report [1]);
+}
+
+static JClosureStatus step_next (JInterp* self, guint pc)
+{
+  return (self->pc = pc, J_CLOSURE_STATUS_CONTINUE);
+}
+
+static JClosureStatus step_fail (JInterp* self)
+{
+  return (self->pc = J_INTERP_PC_FAIL, J_CLOSURE_STATUS_REMOVE);
+}
+
+static gboolean step_arithmetic (JRunner* runner, JWalker* walker, JExpansion* expansion, gint64* result, GError** error)
+{
+  gint64* stack = g_newa (gint64, expansion->n_ops);
+  JArithmetic* code = NULL;
+  GError* tmperr = NULL;
+  guint i, depth = 0;
+
+  for (i = 0; i < expansion->n_ops; ++i)
+    {
+      switch ((code = j_walker_get_arithmetic (walker, expansion->first_op + i))->opcode)
+        {
+          case J_ARITHMETIC_OPCODE_CONSTANT:
+            stack [depth++] = code->value;
+            break;
+          case J_ARITHMETIC_OPCODE_VARIABLE:
+            if ((stack [depth++] = j_arithmetic_load (runner, code->name, &tmperr)), G_UNLIKELY (tmperr != NULL))
+              {
+                g_propagate_error (error, tmperr);
+                return FALSE;
+              }
+            break;
+          case J_ARITHMETIC_OPCODE_BNOT:
+          case J_ARITHMETIC_OPCODE_NEG:
+          case J_ARITHMETIC_OPCODE_NOT:
+            j_arithmetic_apply (code->opcode, stack [depth - 1], 0, & stack [depth - 1], NULL);
+            break;
+          default:
+            if (!j_arithmetic_apply (code->opcode, stack [depth - 2], stack [depth - 1], & stack [depth - 2], error))
+              return FALSE;
+            --depth;
+            break;
+        }
+    }
+#if DEVELOPER == 1
+  g_assert (depth == 1);
+#endif // DEVELOPER
+return (*result = stack [0], TRUE);
+}
+
+static JClosureStatus step_expansions (JInterp* self, JRunner* runner, JStep* step, GError** error)
+{
+  JClosure* jc = & self->closure;
+  JExpansion* expansion = NULL;
+  GError* tmperr = NULL;
+  gint64 number;
+  JPipe pipe_;
+  gint pid;
+  guint i;
+
+  for (i = 0; i < j_walker_n_expansions (step->walker); ++i)
+    {
+      switch ((expansion = j_walker_get_expansion (step->walker, i))->type)
+        {
+          case J_EXPANSION_TYPE_ARITHMETIC:
+            if (!step_arithmetic (runner, step->walker, expansion, &number, &tmperr))
+              {
+                g_propagate_error (error, tmperr);
+                return step_fail (self);
+              }
+            j_expand_int (& jc->expansion_values [i], number);
+            continue;
+          case J_EXPANSION_TYPE_BUILTIN:
+            j_expand_builtin (runner, & jc->expansion_values [i], expansion->builtin, expansion->value);
+            continue;
+          case J_EXPANSION_TYPE_FILE:
+            if ((j_expand_file (& jc->expansion_values [i], expansion->value, &tmperr)), G_UNLIKELY (tmperr != NULL))
+              {
+                g_propagate_error (error, tmperr);
+                return step_fail (self);
+              }
+            continue;
+          case J_EXPANSION_TYPE_VARIABLE:
+            j_expand_value (& jc->expansion_values [i], j_runner_variable_get (runner, expansion->value));
+            continue;
+        }
+
+      if ((j_pipe_init_many (&pipe_, 1, &tmperr)), G_UNLIKELY (tmperr != NULL))
+        {
+          g_propagate_error (error, tmperr);
+          return step_fail (self);
+        }
+
+      if ((pid = j_fork (&tmperr)), G_UNLIKELY (tmperr != NULL))
+        {
+          g_propagate_error (error, tmperr);
+          j_pipe_clear_many (&pipe_, 1);
+          return step_fail (self);
+        }
+
+      if (pid > 0)
+        {
+          g_queue_push_tail (&jc->waitq, GINT_TO_POINTER (pid));
+          g_close (pipe_ [1], NULL);
+          jc->expansion_pipes [i] = pipe_ [0];
+        }
+      else
+        {
+          g_queue_clear (&jc->waitq);
+
+          if ((j_dup2 (pipe_ [1], STDOUT_FILENO, &tmperr)), G_UNLIKELY (tmperr != NULL))
+            {
+              g_propagate_error (error, tmperr);
+              return step_fail (self);
+            }
+
+          j_pipe_clear_many (&pipe_, 1);
+          return step_next (self, GPOINTER_TO_UINT (expansion->tag));
+        }
+    }
+return step_next (self, step->next);
+}
+
+static JClosureStatus step_expression (JInterp* self, JRunner* runner, JStep* step, GError** error)
+{
+  JWalker* walker = step->walker;
+  JPipe* pipes = NULL;
+  GError* tmperr = NULL;
+  gint pid = 0;
+  guint i;
+
+  if (walker->n_pipes > 0)
+    {
+      pipes = g_newa (JPipe, walker->n_pipes);
+
+      if ((j_pipe_init_many (pipes, walker->n_pipes, &tmperr)), G_UNLIKELY (tmperr != NULL))
+        {
+          g_propagate_error (error, tmperr);
+          return step_fail (self);
+        }
+    }
+
+  for (i = 0; i < j_walker_n_invocations (walker); ++i)
+    {
+      JInvoke* invoke = j_walker_get_invoke (walker, i);
+      InvokeResult result;
+
+      if (invoke->target_type == J_INVOKE_TARGET_TYPE_BUILTIN)
+        result = invoke_builtin (self, runner, walker, invoke, pipes, &pid, error);
+      else
+        result = invoke_regular (self, runner, walker, invoke, pipes, &pid, error);
+
+      switch (result)
+        {
+          case INVOKE_CHILD:
+          case INVOKE_STOP:
+            return step_fail (self);
+          case INVOKE_FAIL:
+            if (walker->n_pipes > 0)
+              j_pipe_clear_many (pipes, walker->n_pipes);
+            return step_fail (self);
+          case INVOKE_LEAVE:
+            return step_next (self, step->next);
+          case INVOKE_PARENT:
+            g_queue_push_tail (& self->closure.waitq, GINT_TO_POINTER (pid));
+            break;
+        }
+    }
+
+  if (walker->n_pipes > 0)
+    j_pipe_clear_many (pipes, walker->n_pipes);
+return step_next (self, step->next);
+}
+
+static JClosureStatus step_loop_enter (JInterp* self, JStep* step)
+{
+  JInvoke* invoke = j_walker_get_invoke (step->walker, 0);
+  guint i;
+
+  j_closure_loop_enter (& self->closure);
+
+  for (i = 1; i <= invoke->n_arguments; ++i)
+    j_closure_loop_push (& self->closure, invoke_argument (self, step->walker, invoke, i));
+return step_next (self, step->next);
+}
+
+static JClosureStatus step_loop_next (JInterp* self, JRunner* runner, JStep* step)
+{
+  JInvoke* invoke = j_walker_get_invoke (step->walker, 0);
+  const gchar* name = invoke_argument (self, step->walker, invoke, 0);
+return step_next (self, j_closure_loop_next (& self->closure, runner, name) ? step->next : step->alt);
+}
+
+static JClosureStatus step_splice (JInterp* self, JStep* step, GError** error)
+{
+  JClosure* jc = & self->closure;
+  JExpansion* expansion = NULL;
+  GError* tmperr = NULL;
+  guint i;
+
+  for (i = 0; i < j_walker_n_expansions (step->walker); ++i)
+  if ((expansion = j_walker_get_expansion (step->walker, i))->type == J_EXPANSION_TYPE_FORK)
+    {
+      if ((j_closure_capture (jc, i, &tmperr)), G_UNLIKELY (tmperr != NULL))
+        {
+          g_propagate_error (error, tmperr);
+          return step_fail (self);
+        }
+    }
+return step_next (self, step->next);
+}
+
+static JClosureStatus interp_entry (JClosure* jc, JRunner* runner, GError** error)
+{
+  JInterp* self = (JInterp*) jc;
+  JStep* step = NULL;
+
+  if (G_UNLIKELY (self->pc == J_INTERP_PC_FAIL))
+    return J_CLOSURE_STATUS_REMOVE;
+
+  switch ((step = step_at (self->program, self->pc))->type)
+    {
+      case J_STEP_DETACH:
+        j_set_closure_error_irq (error, J_TYPE_AST, jc->detachables [step->alt]);
+        return step_next (self, step->next);
+      case J_STEP_EMPTY:
+        return step_next (self, step->next);
+      case J_STEP_EXPANSIONS:
+        return step_expansions (self, runner, step, error);
+      case J_STEP_EXPRESSION:
+        return step_expression (self, runner, step, error);
+      case J_STEP_FUNCTION:
+        j_runner_function_define (runner, jc->detachables [step->alt]);
+        return step_next (self, step->next);
+      case J_STEP_LAST:
+        j_set_closure_error_done (error, jc->condition);
+        return step_fail (self);
+      case J_STEP_LOOP_ENTER:
+        return step_loop_enter (self, step);
+      case J_STEP_LOOP_NEXT:
+        return step_loop_next (self, runner, step);
+      case J_STEP_SPLICE:
+        return step_splice (self, step, error);
+      case J_STEP_TEST:
+        return step_next (self, jc->condition ? step->alt : step->next);
+      default: g_assert_not_reached ();
+    }
+}
+
+GClosure* j_codegen_interpret (JCodegen* codegen, JAst* ast, GError** error)
+{
+  g_return_val_if_fail (J_IS_CODEGEN (codegen), NULL);
+  g_return_val_if_fail (ast != NULL, NULL);
+  g_return_val_if_fail (error == NULL || *error == NULL, NULL);
+  JProgram* program = program_new ();
+  JInterp* self = NULL;
+  JClosure* jc = NULL;
+  GList* list;
+  guint head, last, i;
+
+  head = step_new (program);
+  last = step_new (program);
+
+  lower_scope (program, ast, head, last);
+  step_set (program, last, J_STEP_LAST, 0, 0, NULL);
+
+  jc = j_closure_new (codegen, sizeof (JInterp), program->max_expansions);
+  self = (JInterp*) jc;
+
+  g_closure_add_finalize_notifier ((GClosure*) jc, program, (GClosureNotify) program_free);
+
+  if (program->detachables.length > 0)
+    {
+      jc->detachables = g_new (gpointer, program->detachables.length);
+      jc->detachables_count = program->detachables.length;
+
+      for (list = g_queue_peek_head_link (&program->detachables), i = 0; list; list = list->next, ++i)
+        jc->detachables [i] = list->data;
+    }
+
+  jc->entry = interp_entry;
+  self->program = program;
+  self->pc = head;
+return (GClosure*) jc;
+}
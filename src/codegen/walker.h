@@ -16,9 +16,15 @@
  */
 #ifndef __JASH_CODEGEN_WALKER__
 #define __JASH_CODEGEN_WALKER__ 1
-#include <glib.h>
+#include <codegen/externs.h>
+#include <codegen/tag.h>
+#include <lexer/token.h>
+#include <parser/arithmetic.h>
+#include <parser/ast.h>
 
 typedef union _JArgument JArgument;
+typedef struct _JArithmetic JArithmetic;
+typedef struct _JExpansion JExpansion;
 typedef struct _JInvoke JInvoke;
 typedef struct _JWalker JWalker;
 
@@ -60,16 +66,35 @@ extern "C" {
     } target, first_argument;
   };
 
+  struct _JArithmetic
+  {
+    guint opcode;
+    gint64 value;
+    const gchar* name;
+  };
+
+  struct _JExpansion
+  {
+    guint type;
+    JTag tag;
+    const gchar* builtin;
+    const gchar* value;
+    guint first_op;
+    guint n_ops;
+  };
+
   struct _JWalker
   {
-    GQueue arguments;
-    GQueue expansions;
-    GQueue invocations;
+    GPtrArray* arguments;
+    GArray* arithmetic;
+    GArray* expansions;
+    GArray* invocations;
+    GByteArray* invokes;
     guint n_pipes;
   };
 
   #define J_INVOKE_INIT { NULL, NULL, 0, 0, 0, NULL, NULL, }
-  #define J_WALKER_INIT { G_QUEUE_INIT, G_QUEUE_INIT, G_QUEUE_INIT, 0, }
+  #define J_WALKER_INIT { NULL, NULL, NULL, NULL, NULL, 0, }
 
   enum
   {
@@ -77,6 +102,15 @@ extern "C" {
     J_ARGUMENT_TYPE_EXPANSION = 1,
   };
 
+  enum
+  {
+    J_EXPANSION_TYPE_FORK = 0,
+    J_EXPANSION_TYPE_BUILTIN = 1,
+    J_EXPANSION_TYPE_FILE = 2,
+    J_EXPANSION_TYPE_ARITHMETIC = 3,
+    J_EXPANSION_TYPE_VARIABLE = 4,
+  };
+
   enum
   {
     J_INVOKE_STD_FILE_MODE_APPEND = 0,
@@ -98,42 +132,222 @@ extern "C" {
   #define j_walker_clear(walker) \
       (({ \
           JWalker* __walker = ((walker)); \
-          g_queue_clear (&__walker->arguments); \
-          g_queue_clear (&__walker->expansions); \
-          g_queue_clear_full (&__walker->invocations, (GDestroyNotify) g_free); \
+          g_clear_pointer (&__walker->arguments, g_ptr_array_unref); \
+          g_clear_pointer (&__walker->arithmetic, g_array_unref); \
+          g_clear_pointer (&__walker->expansions, g_array_unref); \
+          g_clear_pointer (&__walker->invocations, g_array_unref); \
+          g_clear_pointer (&__walker->invokes, g_byte_array_unref); \
+          __walker->n_pipes = 0; \
+        }))
+  #define j_walker_reset(walker) \
+      (({ \
+          JWalker* __walker = ((walker)); \
+          if (__walker->arguments != NULL) g_ptr_array_set_size (__walker->arguments, 0); \
+          if (__walker->arithmetic != NULL) g_array_set_size (__walker->arithmetic, 0); \
+          if (__walker->expansions != NULL) g_array_set_size (__walker->expansions, 0); \
+          if (__walker->invocations != NULL) g_array_set_size (__walker->invocations, 0); \
+          if (__walker->invokes != NULL) g_byte_array_set_size (__walker->invokes, 0); \
           __walker->n_pipes = 0; \
         }))
 
+  #define j_invoke_is_inline(invoke) \
+      (({ \
+          JInvoke* __invoke = ((invoke)); \
+          (__invoke->stdin_type == J_INVOKE_STD_FILE_TYPE_FILE && __invoke->stdin.filename == NULL) \
+       && (__invoke->stdout_type == J_INVOKE_STD_FILE_TYPE_FILE && __invoke->stdout.filename == NULL); \
+        }))
+
   #define j_walker_add_pipe(walker) (({ JWalker* __walker = ((walker)); __walker->n_pipes++; }))
+  #define j_walker_get_arithmetic(walker,index) (({ JWalker* __walker = ((walker)); & g_array_index (__walker->arithmetic, JArithmetic, ((index))); }))
+  #define j_walker_get_argument(walker,index) (({ JWalker* __walker = ((walker)); (const gchar*) g_ptr_array_index (__walker->arguments, ((index))); }))
+  #define j_walker_get_expansion(walker,index) (({ JWalker* __walker = ((walker)); & g_array_index (__walker->expansions, JExpansion, ((index))); }))
+  #define j_walker_get_invoke(walker,index) (({ JWalker* __walker = ((walker)); (JInvoke*) (__walker->invokes->data + g_array_index (__walker->invocations, guint, ((index)))); }))
+  #define j_walker_n_arguments(walker) (({ JWalker* __walker = ((walker)); __walker->arguments == NULL ? 0 : __walker->arguments->len; }))
+  #define j_walker_n_expansions(walker) (({ JWalker* __walker = ((walker)); __walker->expansions == NULL ? 0 : __walker->expansions->len; }))
+  #define j_walker_n_invocations(walker) (({ JWalker* __walker = ((walker)); __walker->invocations == NULL ? 0 : __walker->invocations->len; }))
 
-  static inline JInvoke* j_invoke_new (guint n_arguments)
+  /* Invokes live in the walker arena, so they stay valid only until the next j_walker_new_invoke () */
+  static inline JInvoke* j_walker_new_invoke (JWalker* walker, guint n_arguments)
   {
     g_assert (g_bit_storage (n_arguments) < J_INVOKE_N_ARGUMENTS_BITS);
     JInvoke* self = NULL;
+    guint offset = 0;
 
     const gsize s_size = G_SIZEOF_MEMBER (JInvoke, target) + G_STRUCT_OFFSET (JInvoke, target);
     const gsize a_size = G_SIZEOF_MEMBER (JInvoke, first_argument) * n_arguments;
-  return (self = g_malloc (s_size + a_size), self->n_arguments = n_arguments, self);
+    const gsize size = (s_size + a_size + sizeof (gpointer) - 1) & ~(sizeof (gpointer) - 1);
+
+    if (walker->invokes == NULL)
+      walker->invokes = g_byte_array_sized_new (256);
+
+    offset = walker->invokes->len;
+    g_byte_array_set_size (walker->invokes, offset + size);
+    self = memset (walker->invokes->data + offset, 0, size);
+  return (self->n_arguments = n_arguments, self);
   }
 
   static inline guint j_walker_add_argument (JWalker* walker, const gchar* value)
   {
-    guint index = g_queue_get_length (&walker->arguments);
-                  g_queue_push_tail (&walker->arguments, (gpointer) value);
+    if (walker->arguments == NULL)
+      walker->arguments = g_ptr_array_sized_new (16);
+
+    guint index = walker->arguments->len;
+                  g_ptr_array_add (walker->arguments, (gpointer) value);
+        return index;
+  }
+
+  static inline guint j_walker_add_expansion_inline (JWalker* walker, guint type, const gchar* builtin, const gchar* value)
+  {
+    JExpansion expansion = { type, NULL, builtin, value, };
+
+    if (walker->expansions == NULL)
+      walker->expansions = g_array_sized_new (FALSE, FALSE, sizeof (JExpansion), 4);
+
+    guint index = walker->expansions->len;
+                  g_array_append_val (walker->expansions, expansion);
         return index;
   }
 
   static inline guint j_walker_add_expansion (JWalker* walker, const JTag* tag)
   {
-    guint index = g_queue_get_length (&walker->expansions);
-                  g_queue_push_tail (&walker->expansions, *tag);
+    guint index = j_walker_add_expansion_inline (walker, J_EXPANSION_TYPE_FORK, NULL, NULL);
+                  j_walker_get_expansion (walker, index)->tag = *tag;
         return index;
   }
 
+  /* Arithmetic trees lower into postfix, operations on constants fold away as they are met */
+  static inline void j_walker_lower_arithmetic (JWalker* walker, JAst* ast)
+  {
+    JArithmetic code = { J_ARITHMETIC_OPCODE_CONSTANT, 0, NULL, };
+    JAst* child = j_ast_get_first_child (ast);
+    const gchar* name = NULL;
+    guint n_operands = 0;
+    guint length;
+
+    switch (j_ast_get_ast_type (ast))
+      {
+        case J_AST_TYPE_DATA:
+          code.value = j_parse_int64 (child->data, NULL);
+          break;
+        case J_AST_TYPE_ARITHMETIC_VARIABLE:
+          code.opcode = J_ARITHMETIC_OPCODE_VARIABLE;
+          code.name = g_intern_string (j_ast_get_first_child (child)->data);
+          break;
+        case J_AST_TYPE_ARITHMETIC_UNARY:
+          name = j_ast_get_first_child (child)->data;
+          n_operands = 1;
+
+          switch (*name)
+            {
+              case '!': code.opcode = J_ARITHMETIC_OPCODE_NOT; break;
+              case '-': code.opcode = J_ARITHMETIC_OPCODE_NEG; break;
+              case '~': code.opcode = J_ARITHMETIC_OPCODE_BNOT; break;
+              default: g_assert_not_reached ();
+            }
+
+          j_walker_lower_arithmetic (walker, j_ast_get_next_sibling (child));
+          break;
+        case J_AST_TYPE_ARITHMETIC_BINARY:
+          name = j_ast_get_first_child (child)->data;
+          n_operands = 2;
+
+          code.opcode = j_arithmetic_lookup (name, strlen (name))->opcode;
+          j_walker_lower_arithmetic (walker, child = j_ast_get_next_sibling (child));
+          j_walker_lower_arithmetic (walker, j_ast_get_next_sibling (child));
+          break;
+        default: g_assert_not_reached ();
+      }
+
+    if (n_operands > 0)
+      {
+        JArithmetic* lhs = j_walker_get_arithmetic (walker, (length = walker->arithmetic->len) - n_operands);
+        JArithmetic* rhs = j_walker_get_arithmetic (walker, length - 1);
+
+        if (lhs->opcode == J_ARITHMETIC_OPCODE_CONSTANT
+          && rhs->opcode == J_ARITHMETIC_OPCODE_CONSTANT
+          && j_arithmetic_apply (code.opcode, lhs->value, rhs->value, &code.value, NULL))
+          {
+            g_array_set_size (walker->arithmetic, length - n_operands);
+            code.opcode = J_ARITHMETIC_OPCODE_CONSTANT;
+          }
+      }
+
+    g_array_append_val (walker->arithmetic, code);
+  }
+
+  static inline guint j_walker_add_arithmetic (JWalker* walker, JAst* ast)
+  {
+    guint index = j_walker_add_expansion_inline (walker, J_EXPANSION_TYPE_ARITHMETIC, NULL, NULL);
+    guint first;
+
+    if (walker->arithmetic == NULL)
+      walker->arithmetic = g_array_sized_new (FALSE, FALSE, sizeof (JArithmetic), 16);
+
+    first = walker->arithmetic->len;
+    j_walker_lower_arithmetic (walker, j_ast_get_first_child (ast));
+    j_walker_get_expansion (walker, index)->first_op = first;
+    j_walker_get_expansion (walker, index)->n_ops = walker->arithmetic->len - first;
+  return index;
+  }
+
+  /* Expansions which need no child: a lone side-effect-free builtin, or '< file' */
+  static inline guint j_expansion_classify (JAst* ast, const gchar** builtin, const gchar** value)
+  {
+    JAst* child = j_ast_get_first_child (ast);
+    JAst* arguments = NULL;
+    JAst* target = NULL;
+    const gchar* name = NULL;
+
+    if (child == NULL || j_ast_get_next_sibling (child) != NULL)
+      return J_EXPANSION_TYPE_FORK;
+
+    switch (j_ast_get_ast_type (child))
+      {
+        case J_AST_TYPE_REDIRECT_INPUT:
+          *value = j_ast_get_first_child (j_ast_get_first_child (child))->data;
+          return J_EXPANSION_TYPE_FILE;
+        case J_AST_TYPE_INVOKE:
+          if (j_ast_n_children (child) != 2
+            || (target = j_ast_find_child (child, J_AST_TYPE_BUILTIN)) == NULL
+            || (arguments = j_ast_find_child (child, J_AST_TYPE_ARGUMENTS)) == NULL)
+            return J_EXPANSION_TYPE_FORK;
+
+          name = j_ast_get_first_child (j_ast_get_first_child (target))->data;
+
+          if (name != J_TOKEN_BUILTIN_FALSE
+            && name != J_TOKEN_BUILTIN_GET
+            && name != J_TOKEN_BUILTIN_HELP
+            && name != J_TOKEN_BUILTIN_HISTORY
+            && name != J_TOKEN_BUILTIN_JOBS
+            && name != J_TOKEN_BUILTIN_STATS
+            && name != J_TOKEN_BUILTIN_TRUE)
+            return J_EXPANSION_TYPE_FORK;
+
+          if ((child = j_ast_get_first_child (arguments)) == NULL)
+            *value = NULL;
+          else
+            {
+              if (j_ast_get_next_sibling (child) != NULL
+                || j_ast_get_ast_type (child) != J_AST_TYPE_DATA)
+                return J_EXPANSION_TYPE_FORK;
+
+              *value = j_ast_get_first_child (child)->data;
+            }
+          return (*builtin = name, J_EXPANSION_TYPE_BUILTIN);
+        default:
+          return J_EXPANSION_TYPE_FORK;
+      }
+  }
+
   static inline guint j_walker_add_invoke (JWalker* walker, JInvoke* invoke)
   {
-    guint index = g_queue_get_length (&walker->invocations);
-                  g_queue_push_tail (&walker->invocations, invoke);
+    guint offset = (guint) ((guint8*) invoke - walker->invokes->data);
+
+    if (walker->invocations == NULL)
+      walker->invocations = g_array_sized_new (FALSE, FALSE, sizeof (guint), 4);
+
+    guint index = walker->invocations->len;
+                  g_array_append_val (walker->invocations, offset);
         return index;
   }
 
@@ -31,7 +31,7 @@ static gint breakdown (JLexer* lexer, JTokens* tokens, const gchar* input, gsize
 #define close_channel(channel) (({ GIOChannel* __channel = ((channel)); g_io_channel_shutdown (__channel, 1, NULL); g_io_channel_unref (__channel); }))
 
 #define BLOCK_SIZ (512)
-#define N_CLASSES (23)
+#define N_CLASSES (35)
 
 struct _JLexer
 {
@@ -96,22 +96,34 @@ static void j_lexer_init (JLexer* self)
   self->classes [__LINE__ - sizeof (linecount)] = token_klass (J_TOKEN_TYPE_COMMENT, "#(.*)");
   self->classes [__LINE__ - sizeof (linecount)] = token_klass (J_TOKEN_TYPE_QUOTED, "\"(.*?)\"");
   self->classes [__LINE__ - sizeof (linecount)] = token_klass (J_TOKEN_TYPE_QUOTED, "\'(.*?)\'");
+  self->classes [__LINE__ - sizeof (linecount)] = token_klass (J_TOKEN_TYPE_ARITHMETIC, "\\$\\(\\(((?:[^()]++|\\((?1)\\))*)\\)\\)");
+  self->classes [__LINE__ - sizeof (linecount)] = token_klass (J_TOKEN_TYPE_VARIABLE, "(?<!\\S)\\$(?:\\{\\w+\\}|\\w+)(?!\\S)");
   self->classes [__LINE__ - sizeof (linecount)] = token_klass (J_TOKEN_TYPE_BUILTIN, keyword_pattern (J_TOKEN_BUILTIN_AGAIN));
   self->classes [__LINE__ - sizeof (linecount)] = token_klass (J_TOKEN_TYPE_BUILTIN, keyword_pattern (J_TOKEN_BUILTIN_CD));
+  self->classes [__LINE__ - sizeof (linecount)] = token_klass (J_TOKEN_TYPE_KEYWORD, keyword_pattern (J_TOKEN_KEYWORD_DO));
+  self->classes [__LINE__ - sizeof (linecount)] = token_klass (J_TOKEN_TYPE_KEYWORD, keyword_pattern (J_TOKEN_KEYWORD_DONE));
+  self->classes [__LINE__ - sizeof (linecount)] = token_klass (J_TOKEN_TYPE_BUILTIN, keyword_pattern (J_TOKEN_BUILTIN_DUMPJIT));
   self->classes [__LINE__ - sizeof (linecount)] = token_klass (J_TOKEN_TYPE_KEYWORD, keyword_pattern (J_TOKEN_KEYWORD_ELSE));
   self->classes [__LINE__ - sizeof (linecount)] = token_klass (J_TOKEN_TYPE_KEYWORD, keyword_pattern (J_TOKEN_KEYWORD_END));
   self->classes [__LINE__ - sizeof (linecount)] = token_klass (J_TOKEN_TYPE_BUILTIN, keyword_pattern (J_TOKEN_BUILTIN_EXIT));
+  self->classes [__LINE__ - sizeof (linecount)] = token_klass (J_TOKEN_TYPE_BUILTIN, keyword_pattern (J_TOKEN_BUILTIN_EXPORT));
   self->classes [__LINE__ - sizeof (linecount)] = token_klass (J_TOKEN_TYPE_BUILTIN, keyword_pattern (J_TOKEN_BUILTIN_FALSE));
   self->classes [__LINE__ - sizeof (linecount)] = token_klass (J_TOKEN_TYPE_BUILTIN, keyword_pattern (J_TOKEN_BUILTIN_FG));
+  self->classes [__LINE__ - sizeof (linecount)] = token_klass (J_TOKEN_TYPE_KEYWORD, keyword_pattern (J_TOKEN_KEYWORD_FOR));
+  self->classes [__LINE__ - sizeof (linecount)] = token_klass (J_TOKEN_TYPE_KEYWORD, keyword_pattern (J_TOKEN_KEYWORD_FUNCTION));
   self->classes [__LINE__ - sizeof (linecount)] = token_klass (J_TOKEN_TYPE_BUILTIN, keyword_pattern (J_TOKEN_BUILTIN_GET));
   self->classes [__LINE__ - sizeof (linecount)] = token_klass (J_TOKEN_TYPE_BUILTIN, keyword_pattern (J_TOKEN_BUILTIN_HELP));
   self->classes [__LINE__ - sizeof (linecount)] = token_klass (J_TOKEN_TYPE_BUILTIN, keyword_pattern (J_TOKEN_BUILTIN_HISTORY));
   self->classes [__LINE__ - sizeof (linecount)] = token_klass (J_TOKEN_TYPE_KEYWORD, keyword_pattern (J_TOKEN_KEYWORD_IF));
+  self->classes [__LINE__ - sizeof (linecount)] = token_klass (J_TOKEN_TYPE_KEYWORD, keyword_pattern (J_TOKEN_KEYWORD_IN));
   self->classes [__LINE__ - sizeof (linecount)] = token_klass (J_TOKEN_TYPE_BUILTIN, keyword_pattern (J_TOKEN_BUILTIN_JOBS));
   self->classes [__LINE__ - sizeof (linecount)] = token_klass (J_TOKEN_TYPE_BUILTIN, keyword_pattern (J_TOKEN_BUILTIN_SET));
+  self->classes [__LINE__ - sizeof (linecount)] = token_klass (J_TOKEN_TYPE_BUILTIN, keyword_pattern (J_TOKEN_BUILTIN_STATS));
   self->classes [__LINE__ - sizeof (linecount)] = token_klass (J_TOKEN_TYPE_KEYWORD, keyword_pattern (J_TOKEN_KEYWORD_THEN));
   self->classes [__LINE__ - sizeof (linecount)] = token_klass (J_TOKEN_TYPE_BUILTIN, keyword_pattern (J_TOKEN_BUILTIN_TRUE));
   self->classes [__LINE__ - sizeof (linecount)] = token_klass (J_TOKEN_TYPE_BUILTIN, keyword_pattern (J_TOKEN_BUILTIN_UNSET));
+  self->classes [__LINE__ - sizeof (linecount)] = token_klass (J_TOKEN_TYPE_KEYWORD, keyword_pattern (J_TOKEN_KEYWORD_UNTIL));
+  self->classes [__LINE__ - sizeof (linecount)] = token_klass (J_TOKEN_TYPE_KEYWORD, keyword_pattern (J_TOKEN_KEYWORD_WHILE));
   self->classes [__LINE__ - sizeof (linecount)] = token_klass (J_TOKEN_TYPE_OPERATOR, "(>>|&&|\\|\\|)");
   self->classes [__LINE__ - sizeof (linecount)] = token_klass (J_TOKEN_TYPE_OPERATOR, "[<>|`&]");
   self->classes [__LINE__ - sizeof (linecount)] = token_klass (J_TOKEN_TYPE_SEPARATOR, "[\n;]");
@@ -307,6 +319,18 @@ static gint breakdown (JLexer* self, JTokens* tokens, const gchar* input, gsize
               value = g_string_chunk_insert_len (tokens->chunk, value, ssize);
               break;
 
+            case J_TOKEN_TYPE_ARITHMETIC:
+              value = prepare (value + 3, stop - start - 5, &ssize);
+              value = g_string_chunk_insert_len (tokens->chunk, value, ssize);
+              break;
+
+            case J_TOKEN_TYPE_VARIABLE:
+              {
+                const gsize braced = (begin [1] == '{') ? 1 : 0;
+                value = g_string_chunk_insert_len (tokens->chunk, value + 1 + braced, stop - start - 1 - braced * 2);
+                break;
+              }
+
             default:
               {
                 gchar* static_value = (gchar*) prepare (begin, stop - start, &ssize);
@@ -37,7 +37,9 @@
 
 _DEFINE_INTERN (builtin, again);
 _DEFINE_INTERN (builtin, cd);
+_DEFINE_INTERN (builtin, dumpjit);
 _DEFINE_INTERN (builtin, exit);
+_DEFINE_INTERN (builtin, export);
 _DEFINE_INTERN (builtin, false);
 _DEFINE_INTERN (builtin, fg);
 _DEFINE_INTERN (builtin, get);
@@ -45,12 +47,20 @@ _DEFINE_INTERN (builtin, help);
 _DEFINE_INTERN (builtin, history);
 _DEFINE_INTERN (builtin, jobs);
 _DEFINE_INTERN (builtin, set);
+_DEFINE_INTERN (builtin, stats);
 _DEFINE_INTERN (builtin, true);
 _DEFINE_INTERN (builtin, unset);
+_DEFINE_INTERN (keyword, do);
+_DEFINE_INTERN (keyword, done);
 _DEFINE_INTERN (keyword, else);
 _DEFINE_INTERN_FULL (keyword, end, fi);
+_DEFINE_INTERN (keyword, for);
+_DEFINE_INTERN (keyword, function);
 _DEFINE_INTERN (keyword, if);
+_DEFINE_INTERN (keyword, in);
 _DEFINE_INTERN (keyword, then);
+_DEFINE_INTERN (keyword, until);
+_DEFINE_INTERN (keyword, while);
 _DEFINE_INTERN_FULL (operator, detach, &);
 _DEFINE_INTERN_FULL (operator, expansion, `);
 _DEFINE_INTERN_FULL (operator, logical_and, &&);
@@ -24,7 +24,9 @@ typedef enum _JTokenType JTokenType;
 
 #define J_TOKEN_BUILTIN_AGAIN (j_token_builtin_again_intern_string ())
 #define J_TOKEN_BUILTIN_CD (j_token_builtin_cd_intern_string ())
+#define J_TOKEN_BUILTIN_DUMPJIT (j_token_builtin_dumpjit_intern_string ())
 #define J_TOKEN_BUILTIN_EXIT (j_token_builtin_exit_intern_string ())
+#define J_TOKEN_BUILTIN_EXPORT (j_token_builtin_export_intern_string ())
 #define J_TOKEN_BUILTIN_FALSE (j_token_builtin_false_intern_string ())
 #define J_TOKEN_BUILTIN_FG (j_token_builtin_fg_intern_string ())
 #define J_TOKEN_BUILTIN_GET (j_token_builtin_get_intern_string ())
@@ -32,12 +34,20 @@ typedef enum _JTokenType JTokenType;
 #define J_TOKEN_BUILTIN_HISTORY (j_token_builtin_history_intern_string ())
 #define J_TOKEN_BUILTIN_JOBS (j_token_builtin_jobs_intern_string ())
 #define J_TOKEN_BUILTIN_SET (j_token_builtin_set_intern_string ())
+#define J_TOKEN_BUILTIN_STATS (j_token_builtin_stats_intern_string ())
 #define J_TOKEN_BUILTIN_TRUE (j_token_builtin_true_intern_string ())
 #define J_TOKEN_BUILTIN_UNSET (j_token_builtin_unset_intern_string ())
+#define J_TOKEN_KEYWORD_DO (j_token_keyword_do_intern_string ())
+#define J_TOKEN_KEYWORD_DONE (j_token_keyword_done_intern_string ())
 #define J_TOKEN_KEYWORD_ELSE (j_token_keyword_else_intern_string ())
 #define J_TOKEN_KEYWORD_END (j_token_keyword_end_intern_string ())
+#define J_TOKEN_KEYWORD_FOR (j_token_keyword_for_intern_string ())
+#define J_TOKEN_KEYWORD_FUNCTION (j_token_keyword_function_intern_string ())
 #define J_TOKEN_KEYWORD_IF (j_token_keyword_if_intern_string ())
+#define J_TOKEN_KEYWORD_IN (j_token_keyword_in_intern_string ())
 #define J_TOKEN_KEYWORD_THEN (j_token_keyword_then_intern_string ())
+#define J_TOKEN_KEYWORD_UNTIL (j_token_keyword_until_intern_string ())
+#define J_TOKEN_KEYWORD_WHILE (j_token_keyword_while_intern_string ())
 #define J_TOKEN_OPERATOR_DETACH (j_token_operator_detach_intern_string ())
 #define J_TOKEN_OPERATOR_EXPANSION (j_token_operator_expansion_intern_string ())
 #define J_TOKEN_OPERATOR_LOGICAL_AND (j_token_operator_logical_and_intern_string ())
@@ -74,11 +84,15 @@ extern "C" {
     J_TOKEN_TYPE_OPERATOR,
     J_TOKEN_TYPE_SEPARATOR,
     J_TOKEN_TYPE_QUOTED,
+    J_TOKEN_TYPE_ARITHMETIC,
+    J_TOKEN_TYPE_VARIABLE,
   };
 
   G_GNUC_INTERNAL const gchar* j_token_builtin_again_intern_string (void) G_GNUC_CONST;
   G_GNUC_INTERNAL const gchar* j_token_builtin_cd_intern_string (void) G_GNUC_CONST;
+  G_GNUC_INTERNAL const gchar* j_token_builtin_dumpjit_intern_string (void) G_GNUC_CONST;
   G_GNUC_INTERNAL const gchar* j_token_builtin_exit_intern_string (void) G_GNUC_CONST;
+  G_GNUC_INTERNAL const gchar* j_token_builtin_export_intern_string (void) G_GNUC_CONST;
   G_GNUC_INTERNAL const gchar* j_token_builtin_false_intern_string (void) G_GNUC_CONST;
   G_GNUC_INTERNAL const gchar* j_token_builtin_fg_intern_string (void) G_GNUC_CONST;
   G_GNUC_INTERNAL const gchar* j_token_builtin_get_intern_string (void) G_GNUC_CONST;
@@ -86,12 +100,20 @@ extern "C" {
   G_GNUC_INTERNAL const gchar* j_token_builtin_history_intern_string (void) G_GNUC_CONST;
   G_GNUC_INTERNAL const gchar* j_token_builtin_jobs_intern_string (void) G_GNUC_CONST;
   G_GNUC_INTERNAL const gchar* j_token_builtin_set_intern_string (void) G_GNUC_CONST;
+  G_GNUC_INTERNAL const gchar* j_token_builtin_stats_intern_string (void) G_GNUC_CONST;
   G_GNUC_INTERNAL const gchar* j_token_builtin_true_intern_string (void) G_GNUC_CONST;
   G_GNUC_INTERNAL const gchar* j_token_builtin_unset_intern_string (void) G_GNUC_CONST;
+  G_GNUC_INTERNAL const gchar* j_token_keyword_do_intern_string (void) G_GNUC_CONST;
+  G_GNUC_INTERNAL const gchar* j_token_keyword_done_intern_string (void) G_GNUC_CONST;
   G_GNUC_INTERNAL const gchar* j_token_keyword_else_intern_string (void) G_GNUC_CONST;
   G_GNUC_INTERNAL const gchar* j_token_keyword_end_intern_string (void) G_GNUC_CONST;
+  G_GNUC_INTERNAL const gchar* j_token_keyword_for_intern_string (void) G_GNUC_CONST;
+  G_GNUC_INTERNAL const gchar* j_token_keyword_function_intern_string (void) G_GNUC_CONST;
   G_GNUC_INTERNAL const gchar* j_token_keyword_if_intern_string (void) G_GNUC_CONST;
+  G_GNUC_INTERNAL const gchar* j_token_keyword_in_intern_string (void) G_GNUC_CONST;
   G_GNUC_INTERNAL const gchar* j_token_keyword_then_intern_string (void) G_GNUC_CONST;
+  G_GNUC_INTERNAL const gchar* j_token_keyword_until_intern_string (void) G_GNUC_CONST;
+  G_GNUC_INTERNAL const gchar* j_token_keyword_while_intern_string (void) G_GNUC_CONST;
   G_GNUC_INTERNAL const gchar* j_token_operator_detach_intern_string (void) G_GNUC_CONST;
   G_GNUC_INTERNAL const gchar* j_token_operator_expansion_intern_string (void) G_GNUC_CONST;
   G_GNUC_INTERNAL const gchar* j_token_operator_logical_and_intern_string (void) G_GNUC_CONST;
@@ -16,16 +16,23 @@
  */
 #include <config.h>
 #include <codegen/codegen.h>
+#include <codegen/debug/stats.h>
 #include <glib.h>
 #include <lexer/lexer.h>
 #include <parser/parser.h>
 #include <runtime/runner.h>
 #include <term/readline.h>
+#include <unistd.h>
 
 #define _g_closure_unref0(var) ((var == NULL) ? NULL : (var = (g_closure_unref (var), NULL)))
 #define _g_error_free0(var) ((var == NULL) ? NULL : (var = (g_error_free (var), NULL)))
 #define _g_object_unref0(var) ((var == NULL) ? NULL : (var = (g_object_unref (var), NULL)))
+#define _g_ptr_array_unref0(var) ((var == NULL) ? NULL : (var = (g_ptr_array_unref (var), NULL)))
 static gint run (guint argc, gchar* argv[], GError** error);
+static gboolean opt_cache = FALSE;
+static gboolean opt_dump_jit = FALSE;
+static gboolean opt_perf_map = FALSE;
+static gboolean opt_stats = FALSE;
 
 int main (int argc, char* argv [])
 {
@@ -39,6 +46,10 @@ int main (int argc, char* argv [])
 
   static GOptionEntry entries [] =
     {
+      { "cache", 0, 0, G_OPTION_ARG_NONE, &opt_cache, "Reuse compiled scripts across runs", NULL, },
+      { "dump-jit", 0, 0, G_OPTION_ARG_NONE, &opt_dump_jit, "Print compiled code and data to stderr", NULL, },
+      { "perf-map", 0, 0, G_OPTION_ARG_NONE, &opt_perf_map, "Name compiled code for perf (/tmp/perf-<pid>.map)", NULL, },
+      { "stats", 0, 0, G_OPTION_ARG_NONE, &opt_stats, "Print compiler timings and counters on exit", NULL, },
       G_OPTION_ENTRY_NULL,
     };
 
@@ -118,17 +129,41 @@ static void on_variable_removing (JRunner* runner, const gchar* key, JReadline*
 static gint run (guint argc, gchar* argv[], GError** error)
 {
   GError* tmperr = NULL;
+  GIOChannel* channel = NULL;
+  GPtrArray* lines = NULL;
   JReadline* readline = NULL;
   JRunner* runner = NULL;
   gboolean finish = FALSE;
   gchar* line = NULL;
   gint i, exit_code = 0;
 
+  if (opt_dump_jit)
+    {
+      /* Same as --perf-map, nested shells dump too */
+      g_setenv ("JASH_DUMP_JIT", "1", TRUE);
+    }
+
+  if (opt_perf_map)
+    {
+      /* Read once by the code generator, and inherited by nested shells */
+      g_setenv ("JASH_PERF_MAP", "1", TRUE);
+    }
+
   runner = j_runner_new (argc == 1);
 
+  if (opt_cache)
+    {
+      gchar* cache_dir = g_build_filename (g_get_user_cache_dir (), "jash", NULL);
+      g_object_set (runner, "cache-dir", cache_dir, NULL);
+      g_free (cache_dir);
+    }
+
 #define cleanup() \
     (({ \
+        if (opt_stats) \
+          j_stats_printerr (runner); \
         _g_object_unref0 (readline); \
+        _g_ptr_array_unref0 (lines); \
         _g_object_unref0 (runner); \
       }))
 
@@ -143,6 +178,17 @@ static gint run (guint argc, gchar* argv[], GError** error)
             }
         }
     }
+  else if (!isatty (STDIN_FILENO))
+    {
+      /* Piped scripts are read statement by statement and compiled ahead of the one running */
+      g_io_channel_set_encoding (channel = g_io_channel_unix_new (STDIN_FILENO), NULL, NULL);
+
+      if ((j_runner_run_channel (runner, channel, &exit_code, &tmperr), g_io_channel_unref (channel)), G_UNLIKELY (tmperr != NULL))
+        {
+          g_propagate_error (error, tmperr);
+          return (cleanup (), 1);
+        }
+    }
   else
     {
       if ((j_readline_history_load (readline = j_readline_new (), &tmperr)), G_UNLIKELY (tmperr != NULL))
@@ -158,7 +204,7 @@ static gint run (guint argc, gchar* argv[], GError** error)
         {
           if ((line = j_readline_get (readline)) == NULL)
             {
-              /* Ctrl-C or stdin EOF */
+              /* Ctrl-C or terminal EOF */
               if (j_readline_get_signaled (readline))
                 continue;
               else
@@ -167,13 +213,31 @@ static gint run (guint argc, gchar* argv[], GError** error)
               }
             }
 
-          if ((finish = j_runner_run_line (runner, line, &exit_code, &tmperr)), G_UNLIKELY (tmperr != NULL))
+          lines = g_ptr_array_new_with_free_func (g_free);
+          g_ptr_array_add (lines, line);
+
+          /* Lines pasted or typed ahead run as one batch, so the later ones compile while the first runs */
+          while (j_readline_get_pending (readline) && (line = j_readline_get (readline)) != NULL)
+            g_ptr_array_add (lines, line);
+
+          if (lines->len == 1)
+            finish = j_runner_run_line (runner, g_ptr_array_index (lines, 0), &exit_code, &tmperr);
+          else
+            {
+              g_ptr_array_add (lines, NULL);
+              finish = j_runner_run_lines (runner, (const gchar* const*) lines->pdata, &exit_code, &tmperr);
+              g_ptr_array_set_size (lines, lines->len - 1);
+            }
+
+          if (G_UNLIKELY (tmperr != NULL))
             {
               g_propagate_error (error, tmperr);
               return (cleanup (), 1);
             }
 
-          j_readline_history_add (readline, line);
+          for (i = 0; i < lines->len; ++i)
+            j_readline_history_add (readline, g_ptr_array_index (lines, i));
+          _g_ptr_array_unref0 (lines);
         }
       while (finish == FALSE);
 
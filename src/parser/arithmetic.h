@@ -0,0 +1,69 @@
+/* Copyright 2023 MarcosHCK
+ * This file is part of JASH.
+ *
+ * JASH is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * JASH is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with JASH. If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef __JASH_PARSER_ARITHMETIC__
+#define __JASH_PARSER_ARITHMETIC__ 1
+#include <glib.h>
+
+typedef struct _JArithmeticOperator JArithmeticOperator;
+
+typedef enum
+{
+  J_ARITHMETIC_OPCODE_CONSTANT,
+  J_ARITHMETIC_OPCODE_VARIABLE,
+  J_ARITHMETIC_OPCODE_BNOT,
+  J_ARITHMETIC_OPCODE_NEG,
+  J_ARITHMETIC_OPCODE_NOT,
+  J_ARITHMETIC_OPCODE_ADD,
+  J_ARITHMETIC_OPCODE_BAND,
+  J_ARITHMETIC_OPCODE_BOR,
+  J_ARITHMETIC_OPCODE_BXOR,
+  J_ARITHMETIC_OPCODE_DIV,
+  J_ARITHMETIC_OPCODE_EQ,
+  J_ARITHMETIC_OPCODE_GE,
+  J_ARITHMETIC_OPCODE_GT,
+  J_ARITHMETIC_OPCODE_LAND,
+  J_ARITHMETIC_OPCODE_LE,
+  J_ARITHMETIC_OPCODE_LOR,
+  J_ARITHMETIC_OPCODE_LT,
+  J_ARITHMETIC_OPCODE_MOD,
+  J_ARITHMETIC_OPCODE_MUL,
+  J_ARITHMETIC_OPCODE_NE,
+  J_ARITHMETIC_OPCODE_SHL,
+  J_ARITHMETIC_OPCODE_SHR,
+  J_ARITHMETIC_OPCODE_SUB,
+} JArithmeticOpcode;
+
+#if __cplusplus
+extern "C" {
+#endif // __cplusplus
+
+  struct _JArithmeticOperator
+  {
+    int name;
+    guint precedence;
+    JArithmeticOpcode opcode;
+  };
+
+  #define j_arithmetic_opcode_is_unary(opcode) (({ guint __opcode = ((opcode)); __opcode >= J_ARITHMETIC_OPCODE_BNOT && __opcode <= J_ARITHMETIC_OPCODE_NOT; }))
+
+  G_GNUC_INTERNAL const JArithmeticOperator* j_arithmetic_lookup (const gchar* name, size_t length);
+
+#if __cplusplus
+}
+#endif // __cplusplus
+
+#endif // __JASH_PARSER_ARITHMETIC__
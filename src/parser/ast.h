@@ -40,10 +40,16 @@ extern "C" {
   typedef enum
   {
     J_AST_TYPE_ARGUMENTS,
+    J_AST_TYPE_ARITHMETIC,
+    J_AST_TYPE_ARITHMETIC_BINARY,
+    J_AST_TYPE_ARITHMETIC_UNARY,
+    J_AST_TYPE_ARITHMETIC_VARIABLE,
     J_AST_TYPE_BUILTIN,
     J_AST_TYPE_DATA,
     J_AST_TYPE_DETACH,
     J_AST_TYPE_EXPANSION,
+    J_AST_TYPE_FUNCTION,
+    J_AST_TYPE_FUNCTION_BODY,
     J_AST_TYPE_IFCLOSURE,
     J_AST_TYPE_IFCLOSURE_CONDITION,
     J_AST_TYPE_IFCLOSURE_DIRECT,
@@ -51,12 +57,18 @@ extern "C" {
     J_AST_TYPE_INVOKE,
     J_AST_TYPE_LOGICAL_AND,
     J_AST_TYPE_LOGICAL_OR,
+    J_AST_TYPE_LOOPCLOSURE,
+    J_AST_TYPE_LOOPCLOSURE_BODY,
+    J_AST_TYPE_LOOPCLOSURE_FOR,
+    J_AST_TYPE_LOOPCLOSURE_UNTIL,
+    J_AST_TYPE_LOOPCLOSURE_WHILE,
     J_AST_TYPE_PIPE,
     J_AST_TYPE_REDIRECT_INPUT,
     J_AST_TYPE_REDIRECT_OUTPUT_APPEND,
     J_AST_TYPE_REDIRECT_OUTPUT_REPLACE,
     J_AST_TYPE_SCOPE,
     J_AST_TYPE_TARGET,
+    J_AST_TYPE_VARIABLE,
   } JAstType;
 
   G_GNUC_INTERNAL GType j_ast_get_type (void) G_GNUC_CONST;
@@ -15,6 +15,8 @@
  * along with JASH. If not, see <http://www.gnu.org/licenses/>.
  */
 #include <config.h>
+#include <codegen/externs.h>
+#include <parser/arithmetic.h>
 #include <parser/ast.h>
 #include <parser/parser.h>
 #include <parser/operator.h>
@@ -26,10 +28,13 @@
 #define J_PARSER_GET_CLASS(obj) (G_TYPE_INSTANCE_GET_CLASS ((obj), J_TYPE_PARSER, JParserClass))
 typedef struct _JParserClass JParserClass;
 static JAst* walk_arguments (JWalker* walker, GError** error);
+static JAst* walk_arithmetic (JWalker* walker, JToken* head, GError** error);
 static JAst* walk_command (JWalker* walker, JToken* head, GError** error);
 static JAst* walk_expansion (JWalker* walker, JToken* head, GError** error);
 static JAst* walk_expression (JWalker* walker, JToken* head, GError** error);
+static JAst* walk_function (JWalker* walker, JToken* head, GError** error);
 static JAst* walk_ifclosure (JWalker* walker, JToken* head, GError** error);
+static JAst* walk_loopclosure (JWalker* walker, JToken* head, GError** error);
 static JAst* walk_scope (JWalker* walker, GError** error);
 #define _g_array_unref0(var) ((var == NULL) ? NULL : (var = (g_array_unref (var), NULL)))
 #define _g_error_free0(var) ((var == NULL) ? NULL : (var = (g_error_free (var), NULL)))
@@ -287,12 +292,180 @@ static JAst* walk_arguments (JWalker* walker, GError** error)
             break;
           }
 
+        case J_TOKEN_TYPE_ARITHMETIC:
+          {
+            JAst* child = NULL;
+
+            if (redirect != NULL)
+              EXCPT (THROW_UNEXPECTED (token), (_j_ast_free0 (ast), NULL));
+            else
+            if ((child = walk_arithmetic (walker, token, &tmperr)), G_UNLIKELY (tmperr != NULL))
+              EXCPT (RETHROW (tmperr), (_j_ast_free0 (ast), NULL));
+            else
+              j_ast_append (ast, child);
+            break;
+          }
+
+        case J_TOKEN_TYPE_VARIABLE:
+          {
+            if (redirect != NULL)
+              EXCPT (THROW_UNEXPECTED (token), (_j_ast_free0 (ast), NULL));
+            else
+              j_ast_append (ast, j_ast_new_wrap (J_AST_TYPE_VARIABLE, j_ast_new_data (value)));
+            break;
+          }
+
         default: EXCPT (THROW_UNEXPECTED (token), (_j_ast_free0 (ast), NULL));
       }
     }
 return (ast);
 }
 
+#define THROW_ARITHMETIC(token,ptr) \
+  (({ \
+      JToken* __token = ((token)); \
+      const gchar* __ptr = ((ptr)); \
+ ; \
+      if (*__ptr == 0) \
+        THROW (J_PARSER_ERROR_UNEXPECTED_EOF, "%i: %i: Unexpected end of arithmetic expansion", locate (__token)); \
+      else \
+        THROW (J_PARSER_ERROR_UNEXPECTED_TOKEN, "%i: %i: Unexpected '%c' in arithmetic expansion", locate (__token), *__ptr); \
+    }))
+
+static const gchar* arithmetic_skip (const gchar* ptr)
+{
+  while (g_ascii_isspace (*ptr))
+    ++ptr;
+return ptr;
+}
+
+static JAst* arithmetic_climb (JToken* head, const gchar** cursor, guint precedence, GError** error);
+
+static JAst* arithmetic_primary (JToken* head, const gchar** cursor, GError** error)
+{
+  const gchar* ptr = arithmetic_skip (*cursor);
+  const gchar* begin = NULL;
+  GError* tmperr = NULL;
+  JAst* ast = NULL;
+  gchar* value = NULL;
+
+  switch (*ptr)
+    {
+      case '(':
+        {
+          *cursor = ptr + 1;
+
+          if ((ast = arithmetic_climb (head, cursor, 0, &tmperr)), G_UNLIKELY (tmperr != NULL))
+            EXCPT (RETHROW (tmperr), NULL);
+          else
+          if (*(ptr = arithmetic_skip (*cursor)) != ')')
+            EXCPT (THROW_ARITHMETIC (head, ptr), (_j_ast_free0 (ast), NULL));
+          return (*cursor = ptr + 1, ast);
+        }
+
+      case '!':
+      case '+':
+      case '-':
+      case '~':
+        {
+          const gchar name [] = { *ptr, 0, };
+          *cursor = ptr + 1;
+
+          if ((ast = arithmetic_primary (head, cursor, &tmperr)), G_UNLIKELY (tmperr != NULL))
+            EXCPT (RETHROW (tmperr), NULL);
+          else
+          if (name [0] == '+')
+            return ast;
+          else
+            {
+              JAst* unary = j_ast_new (J_AST_TYPE_ARITHMETIC_UNARY);
+              j_ast_append (unary, j_ast_new_data (g_intern_string (name)));
+              j_ast_append (unary, ast);
+              return unary;
+            }
+        }
+
+      default:
+        {
+          if (g_ascii_isdigit (*ptr))
+            {
+              for (begin = ptr; g_ascii_isalnum (*ptr); ++ptr);
+              value = g_strndup (begin, ptr - begin);
+
+              if ((j_parse_int64 (value, &tmperr)), G_UNLIKELY (tmperr != NULL))
+                EXCPT (RETHROWP (tmperr, head), (g_free (value), NULL));
+              else
+                ast = j_ast_new_data (g_intern_string (value));
+            }
+          else
+            {
+              if (*ptr == '$')
+                ++ptr;
+              if (!g_ascii_isalnum (*ptr) && *ptr != '_')
+                EXCPT (THROW_ARITHMETIC (head, ptr), NULL);
+
+              for (begin = ptr; g_ascii_isalnum (*ptr) || *ptr == '_'; ++ptr);
+              value = g_strndup (begin, ptr - begin);
+              ast = j_ast_new_wrap (J_AST_TYPE_ARITHMETIC_VARIABLE, j_ast_new_data (g_intern_string (value)));
+            }
+          break;
+        }
+    }
+return (*cursor = ptr, g_free (value), ast);
+}
+
+static JAst* arithmetic_climb (JToken* head, const gchar** cursor, guint precedence, GError** error)
+{
+  const JArithmeticOperator* op = NULL;
+  const gchar* ptr = NULL;
+  GError* tmperr = NULL;
+  JAst* binary = NULL;
+  JAst* lhs = NULL;
+  JAst* rhs = NULL;
+  gchar name [3];
+  gsize length;
+
+  if ((lhs = arithmetic_primary (head, cursor, &tmperr)), G_UNLIKELY (tmperr != NULL))
+    EXCPT (RETHROW (tmperr), NULL);
+
+  while (*(ptr = arithmetic_skip (*cursor)) != 0)
+    {
+      if ((op = j_arithmetic_lookup (ptr, length = 2)) == NULL
+        && (op = j_arithmetic_lookup (ptr, length = 1)) == NULL)
+        break;
+      if (op->precedence <= precedence)
+        break;
+
+      *cursor = ptr + length;
+
+      if ((rhs = arithmetic_climb (head, cursor, op->precedence, &tmperr)), G_UNLIKELY (tmperr != NULL))
+        EXCPT (RETHROW (tmperr), (_j_ast_free0 (lhs), NULL));
+      else
+        {
+          binary = j_ast_new (J_AST_TYPE_ARITHMETIC_BINARY);
+          j_ast_append (binary, j_ast_new_data (g_intern_string ((g_strlcpy (name, ptr, length + 1), name))));
+          j_ast_append (binary, lhs);
+          j_ast_append (binary, rhs);
+          lhs = binary;
+        }
+    }
+return lhs;
+}
+
+static JAst* walk_arithmetic (JWalker* walker, JToken* head, GError** error)
+{ j_walker_dump (walker);
+  const gchar* cursor = head->value;
+  GError* tmperr = NULL;
+  JAst* ast = NULL;
+
+  if ((ast = arithmetic_climb (head, &cursor, 0, &tmperr)), G_UNLIKELY (tmperr != NULL))
+    EXCPT (RETHROW (tmperr), NULL);
+  else
+  if (*(cursor = arithmetic_skip (cursor)) != 0)
+    EXCPT (THROW_ARITHMETIC (head, cursor), (_j_ast_free0 (ast), NULL));
+return j_ast_new_wrap (J_AST_TYPE_ARITHMETIC, ast);
+}
+
 static JAst* walk_command (JWalker* walker, JToken* head, GError** error)
 { j_walker_dump (walker);
   GError* tmperr = NULL;
@@ -310,6 +483,7 @@ static JAst* walk_command (JWalker* walker, JToken* head, GError** error)
           if (value == J_TOKEN_BUILTIN_AGAIN
             || value == J_TOKEN_BUILTIN_CD
             || value == J_TOKEN_BUILTIN_EXIT
+            || value == J_TOKEN_BUILTIN_EXPORT
             || value == J_TOKEN_BUILTIN_FG
             || value == J_TOKEN_BUILTIN_GET
             || value == J_TOKEN_BUILTIN_HELP
@@ -337,8 +511,10 @@ static JAst* walk_command (JWalker* walker, JToken* head, GError** error)
                 }
             }
           else
-          if (value == J_TOKEN_BUILTIN_FALSE
+          if (value == J_TOKEN_BUILTIN_DUMPJIT
+            || value == J_TOKEN_BUILTIN_FALSE
             || value == J_TOKEN_BUILTIN_JOBS
+            || value == J_TOKEN_BUILTIN_STATS
             || value == J_TOKEN_BUILTIN_TRUE)
             {
               if ((child = walk_arguments (walker, &tmperr)), G_UNLIKELY (tmperr != NULL))
@@ -446,8 +622,21 @@ return ast;
 static JAst* walk_expansion (JWalker* walker, JToken* head, GError** error)
 { j_walker_dump (walker);
   GError* tmperr = NULL;
+  JToken* redirect = NULL;
+  JToken* target = NULL;
   JAst* ast = NULL;
 
+  if (j_walker_length (walker) == 2
+    && (redirect = j_walker_peek_index (walker, 0))->type == J_TOKEN_TYPE_OPERATOR
+    && redirect->value == J_TOKEN_OPERATOR_REDIRECTION_READ
+    && ((target = j_walker_peek_index (walker, 1))->type == J_TOKEN_TYPE_LITERAL
+      || target->type == J_TOKEN_TYPE_QUOTED))
+    {
+      ast = j_ast_new (J_AST_TYPE_EXPANSION);
+      j_ast_append (ast, j_ast_new_wrap (J_AST_TYPE_REDIRECT_INPUT, j_ast_new_data (target->value)));
+      return ast;
+    }
+
   if ((ast = walk_scope (walker, &tmperr)), G_UNLIKELY (tmperr != NULL))
     EXCPT (RETHROW (tmperr), NULL);
   else
@@ -608,6 +797,40 @@ static JAst* walk_expression (JWalker* walker, JToken* head, GError** error)
 return (operation = g_queue_pop_head (&operand_queue), CLEANUP (), operation);
 }
 
+static JAst* walk_function (JWalker* walker, JToken* head, GError** error)
+{ j_walker_dump (walker);
+  JToken* name = j_walker_take (walker);
+  JToken* loop = NULL;
+  GError* tmperr = NULL;
+
+  JAst* ast = j_ast_new (J_AST_TYPE_FUNCTION);
+  JAst* child = NULL;
+
+  if (name == NULL || name->type != J_TOKEN_TYPE_LITERAL)
+    EXCPT (THROW_UNEXPECTED (name != NULL ? name : head), (_j_ast_free0 (ast), NULL));
+
+  while ((loop = j_walker_take (walker)) != NULL && loop->type == J_TOKEN_TYPE_SEPARATOR);
+
+  if (loop == NULL || loop->value != J_TOKEN_KEYWORD_DO)
+    EXCPT (THROW_UNEXPECTED (loop != NULL ? loop : name), (_j_ast_free0 (ast), NULL));
+  else
+    {
+      j_walker_adjust (walker, loop);
+
+      if ((child = walk_scope (walker, &tmperr)), G_UNLIKELY (tmperr != NULL))
+        EXCPT (RETHROW (tmperr), (_j_ast_free0 (ast), NULL));
+      else
+      if (j_ast_get_first_child (child) == NULL)
+        EXCPT (THROW_UNEXPECTED (loop), (_j_ast_free0 (child), _j_ast_free0 (ast), NULL));
+      else
+        {
+          j_ast_append (ast, j_ast_new_data (name->value));
+          j_ast_append (ast, (child->data = GUINT_TO_POINTER (J_AST_TYPE_FUNCTION_BODY), child));
+        }
+    }
+return ast;
+}
+
 static JAst* walk_ifclosure (JWalker* walker, JToken* head, GError** error)
 { j_walker_dump (walker);
   JWalker walker2 = J_WALKER_INIT;
@@ -710,6 +933,85 @@ static JAst* walk_ifclosure (JWalker* walker, JToken* head, GError** error)
 return ast;
 }
 
+static JAst* walk_loopclosure (JWalker* walker, JToken* head, GError** error)
+{ j_walker_dump (walker);
+  JWalker walker2 = J_WALKER_INIT;
+  JToken* loop = NULL;
+  GError* tmperr = NULL;
+
+  JAst* ast = j_ast_new (J_AST_TYPE_LOOPCLOSURE);
+  JAst* child = NULL;
+
+  if (collect (walker, &walker2, &tmperr, J_TOKEN_TYPE_KEYWORD, J_TOKEN_KEYWORD_DO, -1), G_UNLIKELY (tmperr != NULL))
+    EXCPT (RETHROW (tmperr), (j_walker_clear (&walker2), _j_ast_free0 (ast), NULL));
+  else
+    {
+      loop = j_walker_withdraw (&walker2);
+      j_walker_adjust (&walker2, head);
+
+      if (head->value == J_TOKEN_KEYWORD_FOR)
+        {
+          JToken* name = j_walker_take (&walker2);
+          JToken* in = j_walker_take (&walker2);
+          JAst* word = NULL;
+
+          if (name == NULL || name->type != J_TOKEN_TYPE_LITERAL)
+            EXCPT (THROW_UNEXPECTED (name != NULL ? name : loop), (j_walker_clear (&walker2), _j_ast_free0 (ast), NULL));
+          if (in == NULL || in->value != J_TOKEN_KEYWORD_IN)
+            EXCPT (THROW_UNEXPECTED (in != NULL ? in : loop), (j_walker_clear (&walker2), _j_ast_free0 (ast), NULL));
+
+          while (j_walker_length (&walker2) > 0 && j_walker_peek_back (&walker2)->type == J_TOKEN_TYPE_SEPARATOR)
+            j_walker_withdraw (&walker2);
+
+          if ((child = walk_arguments (&walker2, &tmperr), j_walker_clear (&walker2)), G_UNLIKELY (tmperr != NULL))
+            EXCPT (RETHROW (tmperr), (_j_ast_free0 (ast), NULL));
+
+          for (word = j_ast_get_first_child (child); word; word = j_ast_get_next_sibling (word))
+            {
+              if (j_ast_get_ast_type (word) != J_AST_TYPE_ARITHMETIC
+                && j_ast_get_ast_type (word) != J_AST_TYPE_DATA
+                && j_ast_get_ast_type (word) != J_AST_TYPE_EXPANSION
+                && j_ast_get_ast_type (word) != J_AST_TYPE_VARIABLE)
+                EXCPT (THROW (J_PARSER_ERROR_UNEXPECTED_TOKEN, "%i: %i: Unexpected redirection in '%s'", locate (head), head->value), (_j_ast_free0 (child), _j_ast_free0 (ast), NULL));
+            }
+
+          j_ast_append (ast, j_ast_new_wrap (J_AST_TYPE_LOOPCLOSURE_FOR, j_ast_new_data (name->value)));
+          j_ast_append (j_ast_get_first_child (ast), child);
+        }
+      else
+        {
+          const JAstType type = (head->value == J_TOKEN_KEYWORD_UNTIL)
+            ? J_AST_TYPE_LOOPCLOSURE_UNTIL
+            : J_AST_TYPE_LOOPCLOSURE_WHILE;
+          const gchar* value2 = NULL;
+
+          if (j_walker_length (&walker2) == 0)
+            EXCPT (THROW_UNEXPECTED (loop), (_j_ast_free0 (ast), NULL));
+          else
+          if ((value2 = j_walker_peek_front (&walker2)->value) == J_TOKEN_KEYWORD_FOR
+            || value2 == J_TOKEN_KEYWORD_UNTIL
+            || value2 == J_TOKEN_KEYWORD_WHILE)
+            EXCPT (THROW_UNEXPECTED (j_walker_peek_front (&walker2)), (j_walker_clear (&walker2), _j_ast_free0 (ast), NULL));
+          else
+          if ((child = walk_scope (&walker2, &tmperr), j_walker_clear (&walker2)), G_UNLIKELY (tmperr != NULL))
+            EXCPT (RETHROW (tmperr), (_j_ast_free0 (ast), NULL));
+          else
+          if (j_ast_get_first_child (child) == NULL)
+            EXCPT (THROW_UNEXPECTED (loop), (_j_ast_free0 (child), _j_ast_free0 (ast), NULL));
+          else
+            j_ast_append (ast, (child->data = GUINT_TO_POINTER (type), child));
+        }
+
+      j_walker_adjust (walker, loop);
+
+      if ((child = walk_scope (walker, &tmperr)), G_UNLIKELY (tmperr != NULL))
+        EXCPT (RETHROW (tmperr), (_j_ast_free0 (ast), NULL));
+      else
+        j_ast_append (ast, (child->data = GUINT_TO_POINTER (J_AST_TYPE_LOOPCLOSURE_BODY), child));
+    }
+return ast;
+}
+
 static JAst* walk_scope (JWalker* walker, GError** error)
 { j_walker_dump (walker);
   GError* tmperr = NULL;
@@ -760,6 +1062,64 @@ static JAst* walk_scope (JWalker* walker, GError** error)
 
         case J_TOKEN_TYPE_KEYWORD:
           {
+            if (value == J_TOKEN_KEYWORD_FOR
+              || value == J_TOKEN_KEYWORD_FUNCTION
+              || value == J_TOKEN_KEYWORD_UNTIL
+              || value == J_TOKEN_KEYWORD_WHILE)
+              {
+                JWalker walker2 = J_WALKER_INIT;
+                JAst* child = NULL;
+                guint loopcount = 1;
+
+#define SEPARATORS \
+  J_TOKEN_TYPE_KEYWORD, J_TOKEN_KEYWORD_FOR, \
+  J_TOKEN_TYPE_KEYWORD, J_TOKEN_KEYWORD_FUNCTION, \
+  J_TOKEN_TYPE_KEYWORD, J_TOKEN_KEYWORD_UNTIL, \
+  J_TOKEN_TYPE_KEYWORD, J_TOKEN_KEYWORD_WHILE, \
+  J_TOKEN_TYPE_KEYWORD, J_TOKEN_KEYWORD_DONE
+
+                while (TRUE)
+                  {
+                    if (collect (walker, &walker2, &tmperr, SEPARATORS, -1), G_UNLIKELY (tmperr != NULL))
+                      EXCPT (RETHROW (tmperr), (j_walker_clear (&walker2), _j_ast_free0 (ast), NULL));
+                    else
+                      {
+                        const gchar* value2 = j_walker_peek_back (&walker2)->value;
+
+                        if (value2 != J_TOKEN_KEYWORD_DONE)
+                          {
+                            ++loopcount;
+                            continue;
+                          }
+                        else
+                          {
+                            if (--loopcount > 0)
+                              continue;
+                          }
+                      }
+
+                    break;
+                  }
+#undef SEPARATORS
+
+                G_STMT_START
+                  {
+                    j_walker_withdraw (&walker2);
+                    j_walker_adjust (&walker2, token);
+
+                    if (value == J_TOKEN_KEYWORD_FUNCTION)
+                      child = walk_function (&walker2, token, &tmperr);
+                    else
+                      child = walk_loopclosure (&walker2, token, &tmperr);
+
+                    if ((j_walker_clear (&walker2)), G_UNLIKELY (tmperr != NULL))
+                      EXCPT (RETHROW (tmperr), (_j_ast_free0 (ast), NULL));
+                    else
+                      j_ast_append (ast, child);
+                  }
+                G_STMT_END;
+              }
+            else
             if (value != J_TOKEN_KEYWORD_IF)
               EXCPT (THROW_UNEXPECTED (token), (_j_ast_free0 (ast), NULL));
             else
@@ -33,12 +33,18 @@ extern "C" {
 
       const gchar* types [] =
         {
-          "J_AST_TYPE_ARGUMENTS", "J_AST_TYPE_BUILTIN", "J_AST_TYPE_DATA", "J_AST_TYPE_DETACH",
-          "J_AST_TYPE_EXPANSION", "J_AST_TYPE_IFCLOSURE", "J_AST_TYPE_IFCLOSURE_CONDITION",
+          "J_AST_TYPE_ARGUMENTS", "J_AST_TYPE_ARITHMETIC", "J_AST_TYPE_ARITHMETIC_BINARY",
+          "J_AST_TYPE_ARITHMETIC_UNARY", "J_AST_TYPE_ARITHMETIC_VARIABLE",
+          "J_AST_TYPE_BUILTIN", "J_AST_TYPE_DATA", "J_AST_TYPE_DETACH",
+          "J_AST_TYPE_EXPANSION", "J_AST_TYPE_FUNCTION", "J_AST_TYPE_FUNCTION_BODY",
+          "J_AST_TYPE_IFCLOSURE", "J_AST_TYPE_IFCLOSURE_CONDITION",
           "J_AST_TYPE_IFCLOSURE_DIRECT", "J_AST_TYPE_IFCLOSURE_REVERSE", "J_AST_TYPE_INVOKE",
-          "J_AST_TYPE_LOGICAL_AND", "J_AST_TYPE_LOGICAL_OR", "J_AST_TYPE_PIPE",
+          "J_AST_TYPE_LOGICAL_AND", "J_AST_TYPE_LOGICAL_OR", "J_AST_TYPE_LOOPCLOSURE",
+          "J_AST_TYPE_LOOPCLOSURE_BODY", "J_AST_TYPE_LOOPCLOSURE_FOR", "J_AST_TYPE_LOOPCLOSURE_UNTIL",
+          "J_AST_TYPE_LOOPCLOSURE_WHILE", "J_AST_TYPE_PIPE",
           "J_AST_TYPE_REDIRECT_INPUT", "J_AST_TYPE_REDIRECT_OUTPUT_APPEND", 
           "J_AST_TYPE_REDIRECT_OUTPUT_REPLACE", "J_AST_TYPE_SCOPE", "J_AST_TYPE_TARGET",
+          "J_AST_TYPE_VARIABLE",
         };
 
       if (ast->parent != NULL && (j_ast_get_ast_type (ast->parent) == J_AST_TYPE_DATA))
@@ -75,11 +81,12 @@ extern "C" {
           "J_TOKEN_TYPE_BUILTIN", "J_TOKEN_TYPE_COMMENT",
           "J_TOKEN_TYPE_KEYWORD", "J_TOKEN_TYPE_LITERAL",
           "J_TOKEN_TYPE_OPERATOR", "J_TOKEN_TYPE_SEPARATOR",
-          "J_TOKEN_TYPE_QUOTED",
+          "J_TOKEN_TYPE_QUOTED", "J_TOKEN_TYPE_ARITHMETIC",
+          "J_TOKEN_TYPE_VARIABLE",
         };
 
       G_STATIC_ASSERT (J_TOKEN_TYPE_BUILTIN == 0);
-      G_STATIC_ASSERT (J_TOKEN_TYPE_QUOTED == G_N_ELEMENTS (types) - 1);
+      G_STATIC_ASSERT (J_TOKEN_TYPE_VARIABLE == G_N_ELEMENTS (types) - 1);
 
       for (list = g_queue_peek_head_link (&walker->queue), i = 0;
           list != NULL;
@@ -0,0 +1,192 @@
+/* Copyright 2023 MarcosHCK
+ * This file is part of JASH.
+ *
+ * JASH is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * JASH is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with JASH. If not, see <http://www.gnu.org/licenses/>.
+ */
+#include <config.h>
+#include <parser/ast.h>
+#include <runtime/ahead.h>
+#define _g_closure_unref0(var) ((var == NULL) ? NULL : (var = (g_closure_unref (var), NULL)))
+#define _g_error_free0(var) ((var == NULL) ? NULL : (var = (g_error_free (var), NULL)))
+typedef struct _Result Result;
+typedef struct _Statement Statement;
+
+struct _JAhead
+{
+  GAsyncQueue* credits;
+  GAsyncQueue* results;
+  GAsyncQueue* statements;
+  JCodegen* codegen;
+  GThread* thread;
+  guint failed : 1;
+  guint next;
+  guint pushed;
+  gint cancelled;
+};
+
+struct _Result
+{
+  GClosure* closure;
+  GError* error;
+};
+
+struct _Statement
+{
+  JAst* ast;
+  JTokens* tokens;
+};
+
+#define CREDIT GUINT_TO_POINTER (1)
+static Statement end = {0};
+
+static void result_free (Result* result)
+{
+  _g_closure_unref0 (result->closure);
+  _g_error_free0 (result->error);
+  g_slice_free (Result, result);
+}
+
+static void statement_free (Statement* statement)
+{
+  if (statement != &end)
+    {
+      j_ast_free (statement->ast);
+      j_tokens_unref (statement->tokens);
+      g_slice_free (Statement, statement);
+    }
+}
+
+static gpointer worker (JAhead* self)
+{
+  Result* result = NULL;
+  Statement* statement = NULL;
+
+  for (;;)
+    {
+      g_async_queue_pop (self->credits);
+
+      if (g_atomic_int_get (&self->cancelled))
+        break;
+      if ((statement = g_async_queue_pop (self->statements)) == &end)
+        break;
+
+      result = g_slice_new0 (Result);
+      result->closure = j_codegen_emit (self->codegen, statement->ast, &result->error);
+
+      statement_free (statement);
+      g_async_queue_push (self->results, result);
+
+      if (G_UNLIKELY (result->error != NULL))
+        break;
+    }
+return NULL;
+}
+
+JAhead* j_ahead_new (JCodegen* codegen, guint depth)
+{
+  g_return_val_if_fail (codegen != NULL, NULL);
+  g_return_val_if_fail (depth > 0, NULL);
+  const GDestroyNotify notify1 = (GDestroyNotify) statement_free;
+  const GDestroyNotify notify2 = (GDestroyNotify) result_free;
+  JAhead* self = g_slice_new0 (JAhead);
+
+  self->credits = g_async_queue_new ();
+  self->results = g_async_queue_new_full (notify2);
+  self->statements = g_async_queue_new_full (notify1);
+  self->codegen = g_object_ref (codegen);
+
+  while (depth-- > 0)
+    g_async_queue_push (self->credits, CREDIT);
+
+  self->thread = g_thread_new ("ahead", (GThreadFunc) worker, self);
+return self;
+}
+
+void j_ahead_free (JAhead* ahead)
+{
+  g_return_if_fail (ahead != NULL);
+  JAhead* self = (ahead);
+
+  g_atomic_int_set (&self->cancelled, TRUE);
+  g_async_queue_push (self->credits, CREDIT);
+  g_async_queue_push (self->statements, &end);
+  g_thread_join (self->thread);
+
+  g_async_queue_unref (self->credits);
+  g_async_queue_unref (self->results);
+  g_async_queue_unref (self->statements);
+  g_object_unref (self->codegen);
+  g_slice_free (JAhead, self);
+}
+
+void j_ahead_push (JAhead* ahead, JTokens* tokens, JAst* ast)
+{
+  g_return_if_fail (ahead != NULL);
+  g_return_if_fail (tokens != NULL);
+  g_return_if_fail (ast != NULL);
+  JAhead* self = (ahead);
+  Statement* statement = NULL;
+  JAst* child = NULL;
+  JAst* scope = NULL;
+
+  /* Each top-level statement becomes its own scope, so it can be emitted (and run) by itself */
+  while (self->failed == FALSE && (child = j_ast_get_first_child (ast)) != NULL)
+    {
+      scope = g_node_new (GUINT_TO_POINTER (J_AST_TYPE_SCOPE));
+      j_ast_unlink (child);
+      g_node_append (scope, child);
+
+      statement = g_slice_new (Statement);
+      statement->ast = scope;
+      statement->tokens = j_tokens_ref (tokens);
+
+      g_async_queue_push (self->statements, statement);
+      self->pushed += 1;
+    }
+
+  j_ast_free (ast);
+}
+
+guint j_ahead_get_pending (JAhead* ahead)
+{
+  g_return_val_if_fail (ahead != NULL, 0);
+return ahead->pushed - ahead->next;
+}
+
+GClosure* j_ahead_next (JAhead* ahead, GError** error)
+{
+  g_return_val_if_fail (ahead != NULL, NULL);
+  g_return_val_if_fail (error == NULL || *error == NULL, NULL);
+  JAhead* self = (ahead);
+  GClosure* closure = NULL;
+  Result* result = NULL;
+
+  if (self->next == self->pushed)
+    return NULL;
+
+  result = g_async_queue_pop (self->results);
+  self->next += 1;
+
+  g_async_queue_push (self->credits, CREDIT);
+
+  if (G_UNLIKELY (result->error != NULL))
+    {
+      /* The worker stops on the first failure, later statements are dropped */
+      self->failed = TRUE;
+      self->next = self->pushed;
+      g_propagate_error (error, g_steal_pointer (&result->error));
+      return (result_free (result), NULL);
+    }
+return (closure = g_steal_pointer (&result->closure), result_free (result), closure);
+}
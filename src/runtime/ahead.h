@@ -0,0 +1,38 @@
+/* Copyright 2023 MarcosHCK
+ * This file is part of JASH.
+ *
+ * JASH is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * JASH is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with JASH. If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef __JASH_RUNTIME_AHEAD__
+#define __JASH_RUNTIME_AHEAD__ 1
+#include <codegen/codegen.h>
+#include <lexer/token.h>
+
+typedef struct _JAhead JAhead;
+
+#if __cplusplus
+extern "C" {
+#endif // __cplusplus
+
+  G_GNUC_INTERNAL JAhead* j_ahead_new (JCodegen* codegen, guint depth);
+  G_GNUC_INTERNAL void j_ahead_free (JAhead* ahead);
+  G_GNUC_INTERNAL guint j_ahead_get_pending (JAhead* ahead);
+  G_GNUC_INTERNAL GClosure* j_ahead_next (JAhead* ahead, GError** error);
+  G_GNUC_INTERNAL void j_ahead_push (JAhead* ahead, JTokens* tokens, JAst* ast);
+
+#if __cplusplus
+}
+#endif // __cplusplus
+
+#endif // __JASH_RUNTIME_AHEAD__
@@ -17,11 +17,14 @@
 #include <config.h>
 #include <codegen/closure.h>
 #include <codegen/codegen.h>
+#include <codegen/debug/stats.h>
 #include <lexer/datachannel.h>
 #include <lexer/lexer.h>
 #include <parser/parser.h>
+#include <runtime/ahead.h>
 #include <runtime/marshal.h>
 #include <runtime/runner.h>
+#include <unistd.h>
 
 #define J_RUNNER_CLASS(klass) (G_TYPE_CHECK_CLASS_CAST ((klass), J_TYPE_RUNNER, JRunnerClass))
 #define J_IS_RUNNER_CLASS(klass) (G_TYPE_CHECK_CLASS_TYPE ((klass), J_TYPE_RUNNER))
@@ -33,18 +36,37 @@ typedef struct _JRunnerClass JRunnerClass;
 #define _j_ast_free0(var) ((var == NULL) ? NULL : (var = (j_ast_free (var), NULL)))
 #define _j_tokens_unref0(var) ((var == NULL) ? NULL : (var = (j_tokens_unref (var), NULL)))
 static gint next_order = 1;
+static guint next_serial = 1;
+typedef struct _Function Function;
+typedef struct _HotLine HotLine;
 typedef struct _Job Job;
 
+#define J_RUNNER_AHEAD_DEPTH (4)
+#define J_RUNNER_HOTLINES_MAX (256)
+#define J_RUNNER_HOT_THRESHOLD (2)
+
 struct _JRunner
 {
   GObject parent;
+  JVariables variables;
   GQueue background;
   GTree* background_ref;
+  guint chained : 1;
   JCodegen* codegen;
+  GPtrArray* exports;
+  GArray* export_flags;
+  GArray* export_owners;
+  GArray* export_positions;
+  GQueue frames;
+  GHashTable* functions;
+  GHashTable* hotlines;
   guint interactive : 1;
   JLexer* lexer;
+  pid_t owner;
   JParser* parser;
-  GHashTable* variables;
+  GPtrArray* slot_names;
+  GHashTable* slots;
+  guint tiers [J_RUNNER_TIER_NUMBER];
 };
 
 struct _JRunnerClass
@@ -55,6 +77,20 @@ struct _JRunnerClass
   void (*variable_removing) (JRunner* runner, const gchar* key);
 };
 
+struct _Function
+{
+  guint serial;
+  JAst* ast;
+  GClosure* closure;
+  GStringChunk* strings;
+};
+
+struct _HotLine
+{
+  guint hits;
+  GClosure* closure;
+};
+
 struct _Job
 {
   guint order : (sizeof (guint) * 8 - 1);
@@ -66,6 +102,7 @@ struct _Job
 enum
 {
   prop_0,
+  prop_cache_dir,
   prop_interactive,
   prop_number,
 };
@@ -78,8 +115,84 @@ enum
 };
 
 G_DEFINE_FINAL_TYPE (JRunner, j_runner, G_TYPE_OBJECT);
+G_STATIC_ASSERT (G_STRUCT_OFFSET (JRunner, variables) == J_RUNNER_VARIABLES_OFFSET);
+G_LOCK_DEFINE_STATIC (slots);
 static GParamSpec* properties [prop_number] = {0};
 static guint signals [signal_number] = {0};
+static GHashTable* slots = NULL;
+static GPtrArray* slot_names = NULL;
+
+static void function_free (Function* function)
+{
+  _g_closure_unref0 (function->closure);
+  j_ast_free (function->ast);
+  g_string_chunk_free (function->strings);
+  g_slice_free (Function, function);
+}
+
+static gboolean exports_marked (JRunner* self, guint slot)
+{
+  return slot < self->export_flags->len && g_array_index (self->export_flags, gboolean, slot);
+}
+
+static void exports_mark (JRunner* self, guint slot, gboolean exported)
+{
+  if (slot >= self->export_flags->len)
+    g_array_set_size (self->export_flags, slot + 1);
+
+  g_array_index (self->export_flags, gboolean, slot) = exported;
+}
+
+static void exports_remove (JRunner* self, guint slot)
+{
+  gpointer entry, * pdata = self->exports->pdata;
+  guint index, last, moved;
+
+  if (slot < self->export_positions->len && (index = g_array_index (self->export_positions, guint, slot)) > 0)
+    {
+      /* Swap with the last entry so removal never shifts the whole array */
+      last = self->exports->len - 2;
+      moved = g_array_index (self->export_owners, guint, last);
+      entry = pdata [--index];
+      pdata [index] = pdata [last];
+      pdata [last] = entry;
+
+      g_array_index (self->export_owners, guint, index) = moved;
+      g_array_index (self->export_positions, guint, moved) = index + 1;
+      g_array_index (self->export_positions, guint, slot) = 0;
+      g_array_set_size (self->export_owners, last);
+      g_ptr_array_remove_index (self->exports, last);
+    }
+}
+
+static void exports_store (JRunner* self, guint slot, const gchar* key, const gchar* value)
+{
+  gchar* entry = g_strconcat (key, "=", value, NULL);
+  guint position;
+
+  if (slot >= self->export_positions->len)
+    g_array_set_size (self->export_positions, slot + 1);
+
+  if ((position = g_array_index (self->export_positions, guint, slot)) > 0)
+    {
+      g_free (self->exports->pdata [position - 1]);
+      self->exports->pdata [position - 1] = entry;
+    }
+  else
+    {
+      self->exports->pdata [self->exports->len - 1] = entry;
+      g_ptr_array_add (self->exports, NULL);
+      g_array_append_val (self->export_owners, slot);
+      g_array_index (self->export_positions, guint, slot) = self->exports->len - 1;
+      self->variables.envp = (gchar**) self->exports->pdata;
+    }
+}
+
+static void hotline_free (HotLine* hot)
+{
+  _g_closure_unref0 (hot->closure);
+  g_slice_free (HotLine, hot);
+}
 
 static void job_free (Job* job)
 {
@@ -87,6 +200,101 @@ static void job_free (Job* job)
   g_slice_free (Job, job);
 }
 
+static gboolean slot_lookup (const gchar* key, gboolean create, guint* slot)
+{
+  gpointer value = NULL;
+  gboolean found;
+
+  G_LOCK (slots);
+
+  if (G_UNLIKELY (slots == NULL))
+    {
+      slots = g_hash_table_new (g_str_hash, g_str_equal);
+      slot_names = g_ptr_array_new ();
+    }
+
+  if ((found = g_hash_table_lookup_extended (slots, key, NULL, &value)) == FALSE && create)
+    {
+      key = g_intern_string (key);
+      value = GUINT_TO_POINTER (slot_names->len);
+      g_hash_table_insert (slots, (gpointer) key, value);
+      g_ptr_array_add (slot_names, (gpointer) key);
+      found = TRUE;
+    }
+
+  G_UNLOCK (slots);
+return (*slot = GPOINTER_TO_UINT (value), found);
+}
+
+/*
+ * Forked children must not take the slots lock, a compiler thread
+ * that does not exist in the child may have been holding it. Each
+ * runner keeps its own copy of the table, caught up by the owner
+ * process before every run, and children allocate past that copy
+ */
+static void runner_slots_sync (JRunner* self)
+{
+  const gchar* key;
+  guint i;
+
+  G_LOCK (slots);
+
+  if (slot_names != NULL)
+  for (i = self->slot_names->len; i < slot_names->len; ++i)
+    {
+      key = g_ptr_array_index (slot_names, i);
+      g_hash_table_insert (self->slots, (gpointer) key, GUINT_TO_POINTER (i));
+      g_ptr_array_add (self->slot_names, (gpointer) key);
+    }
+
+  G_UNLOCK (slots);
+}
+
+static gboolean runner_slot (JRunner* self, const gchar* key, gboolean create, guint* slot)
+{
+  gpointer value = NULL;
+
+  if (g_hash_table_lookup_extended (self->slots, key, NULL, &value))
+    return (*slot = GPOINTER_TO_UINT (value), TRUE);
+  if (create == FALSE)
+    return FALSE;
+
+  if (self->owner == getpid ())
+    {
+      j_variable_slot (key);
+      runner_slots_sync (self);
+    }
+  else
+    {
+      /* The name lives as long as the child does */
+      key = g_strdup (key);
+      g_hash_table_insert (self->slots, (gpointer) key, GUINT_TO_POINTER (self->slot_names->len));
+      g_ptr_array_add (self->slot_names, (gpointer) key);
+    }
+return runner_slot (self, key, FALSE, slot);
+}
+
+static void variables_clear (JVariables* variables)
+{
+  guint i;
+
+  for (i = 0; i < variables->n_values; ++i)
+    g_clear_pointer (& variables->values [i], g_free);
+}
+
+static gchar** variables_reserve (JVariables* variables, guint slot)
+{
+  guint n_values = variables->n_values;
+
+  if (slot >= n_values)
+    {
+      variables->n_values = MAX (slot + 1, n_values * 2);
+      variables->values = g_renew (gchar*, variables->values, variables->n_values);
+      memset (variables->values + n_values, 0, sizeof (gchar*) * (variables->n_values - n_values));
+    }
+return & variables->values [slot];
+}
+
 static void j_runner_class_dispose (GObject* pself)
 {
   JRunner* self = (gpointer) pself;
@@ -94,8 +302,11 @@ static void j_runner_class_dispose (GObject* pself)
   _g_object_unref0 (self->lexer);
   _g_object_unref0 (self->parser);
   g_queue_clear_full (&self->background, (GDestroyNotify) job_free);
+  g_queue_clear_full (&self->frames, (GDestroyNotify) g_ptr_array_unref);
   g_tree_remove_all (self->background_ref);
-  g_hash_table_remove_all (self->variables);
+  g_hash_table_remove_all (self->functions);
+  g_hash_table_remove_all (self->hotlines);
+  variables_clear (&self->variables);
 G_OBJECT_CLASS (j_runner_parent_class)->dispose (pself);
 }
 
@@ -103,7 +314,15 @@ static void j_runner_class_finalize (GObject* pself)
 {
   JRunner* self = (gpointer) pself;
   g_tree_unref (self->background_ref);
-  g_hash_table_unref (self->variables);
+  g_hash_table_unref (self->functions);
+  g_hash_table_unref (self->hotlines);
+  g_ptr_array_unref (self->exports);
+  g_array_unref (self->export_flags);
+  g_array_unref (self->export_owners);
+  g_array_unref (self->export_positions);
+  g_ptr_array_unref (self->slot_names);
+  g_hash_table_unref (self->slots);
+  g_free (self->variables.values);
 G_OBJECT_CLASS (j_runner_parent_class)->finalize (pself);
 }
 
@@ -113,6 +332,9 @@ static void j_runner_class_get_property (GObject* pself, guint property_id, GVal
 
   switch (property_id)
   {
+    case prop_cache_dir:
+      g_object_get_property (G_OBJECT (self->codegen), "cache-dir", value);
+      break;
     case prop_interactive:
       g_value_set_boolean (value, j_runner_get_interactive (self));
       break;
@@ -128,6 +350,9 @@ static void j_runner_class_set_property (GObject* pself, guint property_id, cons
 
   switch (property_id)
   {
+    case prop_cache_dir:
+      g_object_set_property (G_OBJECT (self->codegen), "cache-dir", value);
+      break;
     case prop_interactive:
       self->interactive = g_value_get_boolean (value);
       break;
@@ -139,12 +364,31 @@ static void j_runner_class_set_property (GObject* pself, guint property_id, cons
 
 static void j_runner_class_variable_modifying (JRunner* self, const gchar* key, const gchar* value)
 {
-  g_hash_table_insert (self->variables, g_strdup (key), g_strdup (value));
+  gchar** store = NULL;
+  guint slot;
+
+  runner_slot (self, key, TRUE, &slot);
+  store = variables_reserve (&self->variables, slot);
+  g_free (*store);
+  *store = g_strdup (value);
+
+  if (exports_marked (self, slot))
+    exports_store (self, slot, key, value);
 }
 
 static void j_runner_class_variable_removing (JRunner* self, const gchar* key)
 {
-  g_hash_table_remove (self->variables, key);
+  guint slot;
+
+  /* An exported name may have no value yet, its flag goes all the same */
+  if (runner_slot (self, key, FALSE, &slot))
+    {
+      if (slot < self->variables.n_values)
+        g_clear_pointer (& self->variables.values [slot], g_free);
+
+      exports_mark (self, slot, FALSE);
+      exports_remove (self, slot);
+    }
 }
 
 static void j_runner_class_init (JRunnerClass* klass)
@@ -162,7 +406,9 @@ static void j_runner_class_init (JRunnerClass* klass)
   const guint offset1 = G_STRUCT_OFFSET (JRunnerClass, variable_modifying);
   const guint offset2 = G_STRUCT_OFFSET (JRunnerClass, variable_removing);
   const guint flags1 = G_PARAM_STATIC_STRINGS | G_PARAM_CONSTRUCT_ONLY | G_PARAM_READWRITE;
+  const guint flags3 = G_PARAM_STATIC_STRINGS | G_PARAM_READWRITE;
 
+  properties [prop_cache_dir] = g_param_spec_string ("cache-dir", "cache-dir", "cache-dir", NULL, flags3);
   properties [prop_interactive] = g_param_spec_boolean ("interactive", "interactive", "interactive", FALSE, flags1);
   g_object_class_install_properties (G_OBJECT_CLASS (klass), prop_number, properties);
   signals [signal_variable_modifying] = g_signal_new ("variable-modifying", gtype, flags2, offset1, NULL, NULL, j_cclosure_marshal_VOID__STRING_STRING, G_TYPE_NONE, 2, G_TYPE_STRING, G_TYPE_STRING);
@@ -182,12 +428,36 @@ static void j_runner_init (JRunner* self)
   const GEqualFunc func2 = (GEqualFunc) g_str_equal;
   const GCompareDataFunc func3 = (GCompareDataFunc) uintcmp;
   const GDestroyNotify notify1 = (GDestroyNotify) g_free;
+  const GDestroyNotify notify2 = (GDestroyNotify) hotline_free;
+  const GDestroyNotify notify3 = (GDestroyNotify) function_free;
+  gchar** names = g_listenv ();
+  guint i, slot;
 
   self->background_ref = g_tree_new_full (func3, NULL, NULL, NULL);
   self->codegen = j_codegen_new ();
+  self->exports = g_ptr_array_new_with_free_func (notify1);
+  self->export_flags = g_array_new (FALSE, TRUE, sizeof (gboolean));
+  self->export_owners = g_array_new (FALSE, FALSE, sizeof (guint));
+  self->export_positions = g_array_new (FALSE, TRUE, sizeof (guint));
+  self->functions = g_hash_table_new_full (func1, func2, notify1, notify3);
+  self->hotlines = g_hash_table_new_full (func1, func2, notify1, notify2);
   self->lexer = j_lexer_new ();
+  self->owner = getpid ();
   self->parser = j_parser_new ();
-  self->variables = g_hash_table_new_full (func1, func2, notify1, notify1);
+  self->slot_names = g_ptr_array_new ();
+  self->slots = g_hash_table_new (g_str_hash, g_str_equal);
+
+  g_ptr_array_add (self->exports, NULL);
+  self->variables.envp = (gchar**) self->exports->pdata;
+
+  /* Inherited variables stay exported, as children expect them back */
+  for (i = 0; names [i] != NULL; ++i)
+    {
+      runner_slot (self, names [i], TRUE, &slot);
+      exports_mark (self, slot, TRUE);
+      j_runner_class_variable_modifying (self, names [i], g_getenv (names [i]));
+    }
+  g_strfreev (names);
 }
 
 JRunner* j_runner_new (gboolean interactive)
@@ -195,12 +465,81 @@ JRunner* j_runner_new (gboolean interactive)
   return g_object_new (J_TYPE_RUNNER, "interactive", interactive, NULL);
 }
 
+static gboolean function_intern (JAst* ast, GStringChunk* strings)
+{
+  JAst* parent = j_ast_get_parent (ast);
+
+  if (j_ast_get_ast_type (ast) == J_AST_TYPE_DATA)
+    {
+      if (parent == NULL || j_ast_get_ast_type (parent) != J_AST_TYPE_BUILTIN)
+        {
+          JAst* child = j_ast_get_first_child (ast);
+          child->data = g_string_chunk_insert_const (strings, child->data);
+        }
+    }
+return FALSE;
+}
+
+void j_runner_function_define (JRunner* runner, JAst* ast)
+{
+  g_return_if_fail (J_IS_RUNNER (runner));
+  g_return_if_fail (ast != NULL);
+  const GTraverseType order = (GTraverseType) G_PRE_ORDER;
+  const GTraverseFlags flags = (GTraverseFlags) G_TRAVERSE_NON_LEAVES;
+  const GNodeTraverseFunc func = (GNodeTraverseFunc) function_intern;
+  JAst* name = j_ast_find_child (ast, J_AST_TYPE_DATA);
+  JAst* body = j_ast_find_child (ast, J_AST_TYPE_FUNCTION_BODY);
+  Function* function = g_slice_new0 (Function);
+
+  /* The tree belongs to the defining closure, whose strings may go away before any call does */
+  function->ast = j_ast_copy (body);
+  function->serial = next_serial++;
+  function->strings = g_string_chunk_new (128);
+
+  g_node_traverse (function->ast, order, flags, -1, func, function->strings);
+  g_hash_table_insert (runner->functions, g_strdup (j_ast_get_first_child (name)->data), function);
+}
+
+GPtrArray* j_runner_function_prepare (JRunner* runner, const gchar* name)
+{
+  g_return_val_if_fail (J_IS_RUNNER (runner), NULL);
+  g_return_val_if_fail (name != NULL, NULL);
+  GPtrArray* frame = NULL;
+
+  if (g_hash_table_contains (runner->functions, name))
+    {
+      frame = g_ptr_array_new_with_free_func (g_free);
+      g_ptr_array_add (frame, g_strdup (name));
+    }
+return frame;
+}
+
+void j_runner_function_push (JRunner* runner, GPtrArray* frame, const gchar* value)
+{
+  g_return_if_fail (J_IS_RUNNER (runner));
+  g_return_if_fail (frame != NULL);
+  g_ptr_array_add (frame, g_strdup (value));
+}
+
+gchar** j_runner_get_envp (JRunner* runner)
+{
+  g_return_val_if_fail (J_IS_RUNNER (runner), NULL);
+return runner->variables.envp;
+}
+
 gboolean j_runner_get_interactive (JRunner* runner)
 {
   g_return_val_if_fail (J_IS_RUNNER (runner), FALSE);
 return runner->interactive;
 }
 
+guint j_runner_get_tier_count (JRunner* runner, JRunnerTier tier)
+{
+  g_return_val_if_fail (J_IS_RUNNER (runner), 0);
+  g_return_val_if_fail (tier < J_RUNNER_TIER_NUMBER, 0);
+return runner->tiers [tier];
+}
+
 GClosure* j_runner_job_pop (JRunner* runner)
 {
   g_return_val_if_fail (J_IS_RUNNER (runner), FALSE);
@@ -213,7 +552,7 @@ GClosure* j_runner_job_pop (JRunner* runner)
     {
       g_queue_delete_link (&self->background, (job = list->data, list));
       g_tree_remove (self->background_ref, GUINT_TO_POINTER (job->order));
-      return (closure = job->closure, job_free (job), closure);
+      return (closure = g_closure_ref (job->closure), job_free (job), closure);
     }
 return NULL;
 }
@@ -231,7 +570,7 @@ GClosure* j_runner_job_pop_nth (JRunner* runner, gint order)
     {
       g_queue_delete_link (&self->background, (job = list->data, list));
       g_tree_remove (self->background_ref, GUINT_TO_POINTER (job->order));
-      return (closure = job->closure, job_free (job), closure);
+      return (closure = g_closure_ref (job->closure), job_free (job), closure);
     }
 return NULL;
 }
@@ -287,7 +626,7 @@ void j_runner_job_push (JRunner* runner, GClosure* closure)
   g_closure_sink (g_closure_ref (closure));
 }
 
-static GClosure* parse_staged (JRunner* self, GValue* value, GError** error)
+static GClosure* parse_staged (JRunner* self, GValue* value, gboolean interpret, gboolean profile, const gchar* cache_key, GError** error)
 {
   const gchar* string = NULL;
   GBytes* bytes = NULL;
@@ -297,6 +636,7 @@ static GClosure* parse_staged (JRunner* self, GValue* value, GError** error)
   GClosure* closure = NULL;
   GError* tmperr = NULL;
   guint stage = 0;
+  gint64 lap = 0;
 
   enum
     {
@@ -332,6 +672,8 @@ static GClosure* parse_staged (JRunner* self, GValue* value, GError** error)
     }
   else g_assert_not_reached ();
 
+  lap = g_get_monotonic_time ();
+
   switch (stage)
   {
     case STAGE_LEXER_PRE:
@@ -342,6 +684,9 @@ static GClosure* parse_staged (JRunner* self, GValue* value, GError** error)
             g_propagate_error (error, tmperr);
             break;
           }
+
+        lap = j_stats_lap (J_STATS_TIMER_LEXER, lap);
+        j_stats_add (J_STATS_COUNTER_TOKENS, j_tokens_get_count (tokens));
         G_GNUC_FALLTHROUGH;
       }
     case STAGE_PARSER:
@@ -352,11 +697,21 @@ static GClosure* parse_staged (JRunner* self, GValue* value, GError** error)
             _j_tokens_unref0 (tokens);
             break;
           }
+
+        lap = j_stats_lap (J_STATS_TIMER_PARSER, lap);
+        j_stats_add (J_STATS_COUNTER_AST_NODES, g_node_n_nodes (ast, G_TRAVERSE_ALL));
         G_GNUC_FALLTHROUGH;
       }
     case STAGE_CODEGEN:
       {
-        if ((closure = j_codegen_emit (self->codegen, ast, &tmperr)), G_UNLIKELY (tmperr != NULL))
+        if (interpret)
+          closure = j_codegen_interpret (self->codegen, ast, &tmperr);
+        else if (profile)
+          closure = j_codegen_emit_profiled (self->codegen, ast, &tmperr);
+        else
+          closure = j_codegen_emit_full (self->codegen, ast, cache_key, &tmperr);
+
+        if (G_UNLIKELY (tmperr != NULL))
           {
             g_propagate_error (error, tmperr);
             _j_tokens_unref0 (tokens);
@@ -377,28 +732,128 @@ static GClosure* parse_staged (JRunner* self, GValue* value, GError** error)
           {
             _j_ast_free0 (ast);
           }
-        return g_closure_ref (closure);
+        return (stage == STAGE_COMPLETE) ? g_closure_ref (closure) : closure;
       }
     default: g_assert_not_reached ();
   }
 return NULL;
 }
 
+static GClosure* hotline_take (JRunner* self, const gchar* line, gboolean promote, JRunnerTier* tier_p, GError** error)
+{
+  GValue value [1] = {0};
+  GClosure* closure = NULL;
+  GError* tmperr = NULL;
+  HotLine* hot = NULL;
+  JRunnerTier tier;
+
+  if ((hot = g_hash_table_lookup (self->hotlines, line)) == NULL)
+    {
+      if (g_hash_table_size (self->hotlines) >= J_RUNNER_HOTLINES_MAX)
+        g_hash_table_remove_all (self->hotlines);
+
+      hot = g_slice_new0 (HotLine);
+      g_hash_table_insert (self->hotlines, g_strdup (line), hot);
+    }
+
+  if (++hot->hits >= J_RUNNER_HOT_THRESHOLD || promote)
+    tier = J_RUNNER_TIER_COMPILER;
+  else
+    tier = J_RUNNER_TIER_INTERPRETER;
+
+  if (tier == J_RUNNER_TIER_COMPILER && hot->closure != NULL)
+    {
+      /* Taken out while running, so a nested run of the same line compiles its own copy */
+      closure = g_steal_pointer (&hot->closure);
+      j_closure_rewind ((JClosure*) closure);
+    }
+  else
+    {
+      const gboolean interpret = tier == J_RUNNER_TIER_INTERPRETER;
+
+      g_value_init (value, G_TYPE_STRING);
+      g_value_set_static_string (value, line);
+
+      if ((closure = parse_staged (self, value, interpret, !interpret, NULL, &tmperr), g_value_unset (value)), G_UNLIKELY (tmperr != NULL))
+        {
+          g_propagate_error (error, tmperr);
+          return NULL;
+        }
+    }
+
+  self->tiers [tier] += 1;
+  g_debug ("(" G_STRLOC "): %s tier (hits %u)", (tier == J_RUNNER_TIER_COMPILER) ? "compiler" : "interpreter", hot->hits);
+return (*tier_p = tier, closure);
+}
+
+static void hotline_give (JRunner* self, const gchar* line, GClosure* closure, JRunnerTier tier)
+{
+  HotLine* hot = NULL;
+
+  if (tier == J_RUNNER_TIER_COMPILER)
+    {
+      if ((hot = g_hash_table_lookup (self->hotlines, line)) != NULL && hot->closure == NULL)
+        hot->closure = g_closure_ref (closure);
+    }
+}
+
+static GClosure* function_take (JRunner* self, GPtrArray* frame, guint* serial_p, GError** error)
+{
+  const gchar* name = g_ptr_array_index (frame, 0);
+  GClosure* closure = NULL;
+  GError* tmperr = NULL;
+  Function* function = NULL;
+
+  if ((function = g_hash_table_lookup (self->functions, name)) == NULL)
+    {
+      g_set_error (error, J_CLOSURE_ERROR, J_CLOSURE_ERROR_FAILED, "%s: not a function", name);
+      g_ptr_array_unref (frame);
+      return NULL;
+    }
+
+  if (function->closure != NULL)
+    {
+      /* Taken out while running, so a recursive call compiles its own copy */
+      closure = g_steal_pointer (&function->closure);
+      j_closure_rewind ((JClosure*) closure);
+    }
+  else
+    {
+      if ((closure = j_codegen_emit_profiled (self->codegen, function->ast, &tmperr)), G_UNLIKELY (tmperr != NULL))
+        {
+          g_propagate_error (error, tmperr);
+          g_ptr_array_unref (frame);
+          return NULL;
+        }
+    }
+
+  g_queue_push_head (&self->frames, frame);
+  self->tiers [J_RUNNER_TIER_COMPILER] += 1;
+return (*serial_p = function->serial, closure);
+}
+
+static void function_give (JRunner* self, GClosure* closure, guint serial)
+{
+  GPtrArray* frame = g_queue_pop_head (&self->frames);
+  Function* function = NULL;
+
+  if ((function = g_hash_table_lookup (self->functions, g_ptr_array_index (frame, 0))) != NULL)
+    {
+      /* A redefinition while running leaves the old code behind */
+      if (function->serial == serial && function->closure == NULL)
+        function->closure = g_closure_ref (closure);
+    }
+
+  g_ptr_array_unref (frame);
+}
+
 static gboolean run_unchecked (JRunner* self, GClosure* closure, gint* exit_code_p, gboolean foreground, GError** error)
 {
-  GValue param_values [2] = {0};
-  GValue return_value [1] = {0};
+  JClosureStatus status = J_CLOSURE_STATUS_REMOVE;
   gboolean exit_thrown = FALSE;
   GError* tmperr = NULL;
   gint signalcnt = 0;
 
-  g_value_init (param_values + 0, J_TYPE_RUNNER);
-  g_value_init (param_values + 1, G_TYPE_POINTER);
-  g_value_init (return_value + 0, G_TYPE_INT);
-
-  g_value_set_object (param_values + 0, self);
-  g_value_set_pointer (param_values + 1, &tmperr);
-
   do
   {
     if (foreground)
@@ -433,7 +888,8 @@ static gboolean run_unchecked (JRunner* self, GClosure* closure, gint* exit_code
         break;
     }
 
-    if ((g_closure_invoke (closure, return_value, 2, param_values, NULL)), G_UNLIKELY (tmperr != NULL))
+    /* Step the closure directly, g_closure_invoke would box every call into GValues */
+    if ((status = j_closure_step ((JClosure*) closure, self, &tmperr)), G_UNLIKELY (tmperr != NULL))
     {
       if (!g_error_matches (tmperr, J_CLOSURE_ERROR, J_CLOSURE_ERROR_IRQ))
         {
@@ -446,7 +902,7 @@ static gboolean run_unchecked (JRunner* self, GClosure* closure, gint* exit_code
             {
               GValue* value = j_closure_error_value (tmperr);
 
-              if (self->interactive)
+              if (self->interactive || (self->chained && foreground))
                 exit_code_p [0] = g_value_get_int (value);
               else
                 {
@@ -460,6 +916,8 @@ static gboolean run_unchecked (JRunner* self, GClosure* closure, gint* exit_code
           GClosure* closure2 = NULL;
           GError* tmperr2 = NULL;
           GValue* value = NULL;
+          JRunnerTier tier;
+          guint serial = 0;
 
           value = j_closure_error_value (tmperr);
 
@@ -470,7 +928,14 @@ static gboolean run_unchecked (JRunner* self, GClosure* closure, gint* exit_code
             }
           else
             {
-              if ((closure2 = parse_staged (self, value, &tmperr2)), G_UNLIKELY (tmperr2 != NULL))
+              if (G_VALUE_HOLDS (value, G_TYPE_STRING))
+                closure2 = hotline_take (self, g_value_get_string (value), TRUE, &tier, &tmperr2);
+              else if (G_VALUE_HOLDS (value, G_TYPE_PTR_ARRAY))
+                closure2 = function_take (self, g_value_get_boxed (value), &serial, &tmperr2);
+              else
+                closure2 = parse_staged (self, value, FALSE, FALSE, NULL, &tmperr2);
+
+              if (G_UNLIKELY (tmperr2 != NULL))
                 {
                   g_propagate_error (error, tmperr2);
                   _g_error_free0 (tmperr);
@@ -483,18 +948,31 @@ static gboolean run_unchecked (JRunner* self, GClosure* closure, gint* exit_code
                   j_runner_job_push (self, closure2);
                 }
               else if (G_VALUE_HOLDS (value, J_TYPE_CLOSURE) /* Bring to front (fg) */
+                    || G_VALUE_HOLDS (value, G_TYPE_PTR_ARRAY) /* Call (function) */
                     || G_VALUE_HOLDS (value, G_TYPE_STRING) /* Execute (again) */)
                 {
+                  const gboolean chained = self->chained;
+                  const gboolean call = G_VALUE_HOLDS (value, G_TYPE_PTR_ARRAY);
                   gint exit_code = 0;
 
-                  if ((exit_thrown = run_unchecked (self, closure2, &exit_code, TRUE, &tmperr2)),
-                        G_LIKELY (tmperr2 == NULL))
+                  /* A function body running off its end returns to the caller, it does not end the script */
+                  self->chained = chained || call;
+                  exit_thrown = run_unchecked (self, closure2, &exit_code, TRUE, &tmperr2);
+                  self->chained = chained;
+
+                  if (call)
+                    function_give (self, closure2, serial);
+
+                  if (G_LIKELY (tmperr2 == NULL))
                     {
                       goffset offset = G_STRUCT_OFFSET (JClosure, condition);
                       gboolean condition = (exit_code != 0) ? 1 : 0;
 
                       G_STRUCT_MEMBER (gboolean, closure, offset) |= condition;
 
+                      if (G_VALUE_HOLDS (value, G_TYPE_STRING))
+                        hotline_give (self, g_value_get_string (value), closure2, tier);
+
                       if (exit_thrown)
                         {
                           exit_thrown = TRUE;
@@ -511,15 +989,22 @@ static gboolean run_unchecked (JRunner* self, GClosure* closure, gint* exit_code
                 }
 
               g_closure_unref (closure2);
+
+              if (exit_thrown && G_VALUE_HOLDS (value, G_TYPE_PTR_ARRAY))
+                {
+                  /* exit inside a function leaves its caller as well */
+                  _g_error_free0 (tmperr);
+                  break;
+                }
             }
         }
 
       _g_error_free0 (tmperr);
     }
-  } while ((g_value_get_int (return_value) == J_CLOSURE_STATUS_CONTINUE)
-        || (foreground && (g_value_get_int (return_value) == J_CLOSURE_STATUS_WAITING)));
+  } while ((status == J_CLOSURE_STATUS_CONTINUE)
+        || (foreground && (status == J_CLOSURE_STATUS_WAITING)));
     signal (SIGINT, SIG_DFL);
-return (g_value_unset (return_value), g_value_unset (param_values + 0), g_value_unset (param_values + 1), exit_thrown);
+return exit_thrown;
 }
 
 gboolean j_runner_run (JRunner* runner, GClosure* closure, gint* exit_code, GError** error)
@@ -528,9 +1013,156 @@ gboolean j_runner_run (JRunner* runner, GClosure* closure, gint* exit_code, GErr
   g_return_val_if_fail (closure != NULL, FALSE);
   g_return_val_if_fail (exit_code != NULL, FALSE);
   GError* tmperr = NULL;
+
+  /* Names the closure was compiled against are in the global table by now */
+  if (runner->owner == getpid ())
+    runner_slots_sync (runner);
 return run_unchecked (runner, closure, exit_code, TRUE, error);
 }
 
+static GIOChannel* open_cached (JRunner* self, const gchar* filename, GClosure** closure, gchar** cache_key, GError** error)
+{
+  GIOChannel* channel = NULL;
+  GError* tmperr = NULL;
+  GBytes* bytes = NULL;
+  gchar* contents = NULL;
+  gsize length = 0;
+
+  if ((g_file_get_contents (filename, &contents, &length, &tmperr)), G_UNLIKELY (tmperr != NULL))
+    {
+      g_propagate_error (error, tmperr);
+      return NULL;
+    }
+
+  *cache_key = j_codegen_cache_key (contents, length);
+
+  if ((*closure = j_codegen_load (self->codegen, *cache_key)) != NULL)
+    return (g_free (contents), NULL);
+
+  bytes = g_bytes_new_take (contents, length);
+  channel = j_data_channel_new_bytes (bytes);
+return (g_bytes_unref (bytes), channel);
+}
+
+static gboolean feed_tokens (JRunner* self, JAhead* ahead, JTokens* tokens, gint64 lap, GError** error)
+{
+  GError* tmperr = NULL;
+  JAst* ast = NULL;
+
+  lap = j_stats_lap (J_STATS_TIMER_LEXER, lap);
+  j_stats_add (J_STATS_COUNTER_TOKENS, j_tokens_get_count (tokens));
+
+  if ((ast = j_parser_parse (self->parser, tokens, &tmperr)), G_UNLIKELY (tmperr != NULL))
+    {
+      g_propagate_error (error, tmperr);
+      return FALSE;
+    }
+
+  j_stats_lap (J_STATS_TIMER_PARSER, lap);
+  j_stats_add (J_STATS_COUNTER_AST_NODES, g_node_n_nodes (ast, G_TRAVERSE_ALL));
+  j_ahead_push (ahead, tokens, ast);
+return TRUE;
+}
+
+static gboolean feed_line (JRunner* self, JAhead* ahead, const gchar* line, gssize length, GError** error)
+{
+  GError* tmperr = NULL;
+  JTokens* tokens = NULL;
+  gboolean result = FALSE;
+  gint64 lap = g_get_monotonic_time ();
+
+  if ((tokens = j_lexer_scan_from_data (self->lexer, line, length, &tmperr)), G_UNLIKELY (tmperr != NULL))
+    {
+      g_propagate_error (error, tmperr);
+      return FALSE;
+    }
+
+  result = feed_tokens (self, ahead, tokens, lap, error);
+return (j_tokens_unref (tokens), result);
+}
+
+static gboolean channel_ready (GIOChannel* channel)
+{
+  GPollFD fd = { g_io_channel_unix_get_fd (channel), G_IO_IN, 0 };
+
+  if (g_io_channel_get_buffer_condition (channel) & G_IO_IN)
+    return TRUE;
+return g_poll (&fd, 1, 0) > 0;
+}
+
+static gboolean run_ahead (JRunner* self, JAhead* ahead, GIOChannel* channel, gint* exit_code, GError** error)
+{
+  GClosure* closure = NULL;
+  GError* feederr = NULL;
+  GError* tmperr = NULL;
+  gboolean result = FALSE;
+  gchar* line = NULL;
+  gsize length = 0;
+  guint pending;
+
+  /* Statements are compiled on a worker while earlier ones run */
+  self->chained = TRUE;
+
+  while (result == FALSE)
+    {
+      /* Top the worker up from input that is already there, block on the channel only when it has nothing left */
+      while (channel != NULL && (pending = j_ahead_get_pending (ahead)) < J_RUNNER_AHEAD_DEPTH && (pending == 0 || channel_ready (channel)))
+        {
+          if (g_io_channel_read_line (channel, &line, &length, NULL, &feederr) != G_IO_STATUS_NORMAL)
+            channel = NULL;
+          else
+            {
+              /* A bad line ends the input, but what was queued before it still runs */
+              if ((feed_line (self, ahead, line, length, &feederr), g_free (line)), G_UNLIKELY (feederr != NULL))
+                channel = NULL;
+            }
+        }
+
+      if ((closure = j_ahead_next (ahead, &tmperr)) == NULL)
+        break;
+      if ((result = j_runner_run (self, closure, exit_code, &tmperr), g_closure_unref (closure)), G_UNLIKELY (tmperr != NULL))
+        break;
+    }
+
+  self->chained = FALSE;
+
+  if (G_UNLIKELY (tmperr != NULL))
+    {
+      g_propagate_error (error, tmperr);
+      return (_g_error_free0 (feederr), FALSE);
+    }
+
+  if (G_UNLIKELY (feederr != NULL) && result == FALSE)
+    {
+      g_propagate_error (error, feederr);
+      return FALSE;
+    }
+return (_g_error_free0 (feederr), result);
+}
+
+static gboolean run_ahead_file (JRunner* self, const gchar* filename, gint* exit_code, GError** error)
+{
+  GError* tmperr = NULL;
+  JAhead* ahead = NULL;
+  JTokens* tokens = NULL;
+  gboolean result = FALSE;
+  gint64 lap = g_get_monotonic_time ();
+
+  if ((tokens = j_lexer_scan_from_file (self->lexer, filename, &tmperr)), G_UNLIKELY (tmperr != NULL))
+    {
+      g_propagate_error (error, tmperr);
+      return FALSE;
+    }
+
+  ahead = j_ahead_new (self->codegen, J_RUNNER_AHEAD_DEPTH);
+
+  if ((feed_tokens (self, ahead, tokens, lap, &tmperr), j_tokens_unref (tokens)), G_UNLIKELY (tmperr != NULL))
+    g_propagate_error (error, tmperr);
+  else
+    result = run_ahead (self, ahead, NULL, exit_code, error);
+return (j_ahead_free (ahead), result);
+}
+
 gboolean j_runner_run_file (JRunner* runner, const gchar* filename, gint* exit_code, GError** error)
 {
   GValue value [1] = {0};
@@ -538,56 +1170,116 @@ gboolean j_runner_run_file (JRunner* runner, const gchar* filename, gint* exit_c
   GClosure* closure = NULL;
   GError* tmperr = NULL;
   gboolean result = FALSE;
+  gchar* cache_key = NULL;
+
+  if (j_codegen_get_cache_dir (runner->codegen) == NULL)
+    return run_ahead_file (runner, filename, exit_code, error);
 
-  if ((channel = g_io_channel_new_file (filename, "r", &tmperr)), G_UNLIKELY (tmperr != NULL))
+  if ((channel = open_cached (runner, filename, &closure, &cache_key, &tmperr)), G_UNLIKELY (tmperr != NULL))
     g_propagate_error (error, tmperr);
   else
     {
-      g_value_init (value, G_TYPE_IO_CHANNEL);
-      g_value_take_boxed (value, channel);
-
-      if ((closure = parse_staged (runner, value, &tmperr), g_value_unset (value)), G_UNLIKELY (tmperr != NULL))
-        g_propagate_error (error, tmperr);
-      else
+      if (closure == NULL)
         {
-          if ((result = j_runner_run (runner, closure, exit_code, &tmperr), g_closure_unref (closure)), G_UNLIKELY (tmperr != NULL))
-            g_propagate_error (error, tmperr);
+          g_value_init (value, G_TYPE_IO_CHANNEL);
+          g_value_take_boxed (value, channel);
+
+          if ((closure = parse_staged (runner, value, FALSE, FALSE, cache_key, &tmperr), g_value_unset (value)), G_UNLIKELY (tmperr != NULL))
+            {
+              g_propagate_error (error, tmperr);
+              return (g_free (cache_key), result);
+            }
         }
+
+      if ((result = j_runner_run (runner, closure, exit_code, &tmperr), g_closure_unref (closure)), G_UNLIKELY (tmperr != NULL))
+        g_propagate_error (error, tmperr);
     }
-return result;
+return (g_free (cache_key), result);
 }
 
 gboolean j_runner_run_line (JRunner* runner, const gchar* line, gint* exit_code, GError** error)
 {
-  GValue value [1] = {0};
-  GIOChannel* channel = NULL;
-  GBytes* bytes = NULL;
   GClosure* closure = NULL;
   GError* tmperr = NULL;
   gboolean result = FALSE;
+  JRunnerTier tier;
 
-  bytes = g_bytes_new_static (line, strlen (line));
-  channel = j_data_channel_new_bytes (bytes);
-
-  g_value_init (value, G_TYPE_IO_CHANNEL);
-  g_value_take_boxed (value, channel);
-  g_bytes_unref (bytes);
-
-  if ((closure = parse_staged (runner, value, &tmperr), g_value_unset (value)), G_UNLIKELY (tmperr != NULL))
+  if ((closure = hotline_take (runner, line, FALSE, &tier, &tmperr)), G_UNLIKELY (tmperr != NULL))
     g_propagate_error (error, tmperr);
   else
     {
-      if ((result = j_runner_run (runner, closure, exit_code, &tmperr), g_closure_unref (closure)), G_UNLIKELY (tmperr != NULL))
+      if ((result = j_runner_run (runner, closure, exit_code, &tmperr)), G_UNLIKELY (tmperr != NULL))
         g_propagate_error (error, tmperr);
+      else
+        hotline_give (runner, line, closure, tier);
+      g_closure_unref (closure);
     }
 return result;
 }
 
+gboolean j_runner_run_channel (JRunner* runner, GIOChannel* channel, gint* exit_code, GError** error)
+{
+  g_return_val_if_fail (J_IS_RUNNER (runner), FALSE);
+  g_return_val_if_fail (channel != NULL, FALSE);
+  g_return_val_if_fail (exit_code != NULL, FALSE);
+  g_return_val_if_fail (error == NULL || *error == NULL, FALSE);
+  JAhead* ahead = NULL;
+  gboolean result = FALSE;
+
+  ahead = j_ahead_new (runner->codegen, J_RUNNER_AHEAD_DEPTH);
+  result = run_ahead (runner, ahead, channel, exit_code, error);
+return (j_ahead_free (ahead), result);
+}
+
+gboolean j_runner_run_lines (JRunner* runner, const gchar* const* lines, gint* exit_code, GError** error)
+{
+  g_return_val_if_fail (J_IS_RUNNER (runner), FALSE);
+  g_return_val_if_fail (lines != NULL, FALSE);
+  g_return_val_if_fail (exit_code != NULL, FALSE);
+  g_return_val_if_fail (error == NULL || *error == NULL, FALSE);
+  GError* feederr = NULL;
+  GError* tmperr = NULL;
+  JAhead* ahead = NULL;
+  gboolean result = FALSE;
+
+  ahead = j_ahead_new (runner->codegen, J_RUNNER_AHEAD_DEPTH);
+
+  /* Lines are fed one by one, so a bad one only drops the lines after it */
+  for (; *lines != NULL && feederr == NULL; ++lines)
+    feed_line (runner, ahead, *lines, -1, &feederr);
+
+  if ((result = run_ahead (runner, ahead, NULL, exit_code, &tmperr), j_ahead_free (ahead)), G_UNLIKELY (tmperr != NULL))
+    {
+      g_propagate_error (error, tmperr);
+      return (_g_error_free0 (feederr), FALSE);
+    }
+
+  if (G_UNLIKELY (feederr != NULL) && result == FALSE)
+    {
+      g_propagate_error (error, feederr);
+      return FALSE;
+    }
+return (_g_error_free0 (feederr), result);
+}
+
 const gchar* j_runner_variable_get (JRunner* runner, const gchar* key)
 {
   g_return_val_if_fail (J_IS_RUNNER (runner), NULL);
   g_return_val_if_fail (key != NULL, NULL);
-return g_hash_table_lookup (runner->variables, key);
+  GPtrArray* frame = NULL;
+  guint64 index = 0;
+  guint slot;
+
+  /* Positional arguments of the innermost function call shadow numeric names */
+  if ((frame = g_queue_peek_head (&runner->frames)) != NULL)
+    {
+      if (g_ascii_string_to_unsigned (key, 10, 0, G_MAXUINT, &index, NULL))
+        return (index < frame->len) ? g_ptr_array_index (frame, index) : NULL;
+    }
+
+  if (runner_slot (runner, key, FALSE, &slot) && slot < runner->variables.n_values)
+    return runner->variables.values [slot];
+return NULL;
 }
 
 void j_runner_variable_print (JRunner* runner, const gchar* key)
@@ -597,24 +1289,50 @@ void j_runner_variable_print (JRunner* runner, const gchar* key)
   JRunner* self = (runner);
   const gchar* value;
 
-  if ((value = g_hash_table_lookup (self->variables, key)) != NULL)
+  if ((value = j_runner_variable_get (self, key)) != NULL)
   {
     g_print ("%s", value);
   }
 }
 
-void j_runner_variable_print_all (JRunner* runner)
+/*
+ * Takes a NAME or NAME=VALUE word, a bare name exports
+ * whatever value the variable has now or gets later
+ */
+void j_runner_variable_export (JRunner* runner, const gchar* key)
 {
   g_return_if_fail (J_IS_RUNNER (runner));
+  g_return_if_fail (key != NULL);
   JRunner* self = (runner);
-  GHashTableIter iter = {0};
-  gpointer key, value;
+  const gchar* value = NULL;
+  gchar* name = NULL;
+  guint slot;
+
+  if ((value = strchr (key, '=')) != NULL)
+    key = name = g_strndup (key, value++ - key);
+
+  runner_slot (self, key, TRUE, &slot);
+  exports_mark (self, slot, TRUE);
+
+  if (value != NULL)
+    j_runner_variable_set (runner, key, value);
+  else if (slot < self->variables.n_values && self->variables.values [slot] != NULL)
+    exports_store (self, slot, key, self->variables.values [slot]);
 
-  g_hash_table_iter_init (&iter, self->variables);
+  g_free (name);
+}
+
+void j_runner_variable_print_all (JRunner* runner)
+{
+  g_return_if_fail (J_IS_RUNNER (runner));
+  JRunner* self = (runner);
+  const gchar* value;
+  guint i;
 
-  while (g_hash_table_iter_next (&iter, &key, &value))
+  for (i = 0; i < self->variables.n_values; ++i)
+  if ((value = self->variables.values [i]) != NULL)
   {
-    g_print ("%s=%s\n", (gchar*) key, (gchar*) value);
+    g_print ("%s=%s\n", (const gchar*) g_ptr_array_index (self->slot_names, i), value);
   }
 }
 
@@ -634,3 +1352,10 @@ void j_runner_variable_set (JRunner* runner, const gchar* key, const gchar* valu
 
   g_signal_emit (runner, signals [signal_variable_modifying], 0, key, value);
 }
+
+guint j_variable_slot (const gchar* key)
+{
+  g_return_val_if_fail (key != NULL, 0);
+  guint slot;
+return (slot_lookup (key, TRUE, &slot), slot);
+}
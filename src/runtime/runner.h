@@ -17,31 +17,59 @@
 #ifndef __JASH_RUNTIME_RUNNER__
 #define __JASH_RUNTIME_RUNNER__ 1
 #include <glib-object.h>
+#include <parser/ast.h>
 
 #define J_TYPE_RUNNER (j_runner_get_type ())
 #define J_RUNNER(obj) (G_TYPE_CHECK_INSTANCE_CAST ((obj), J_TYPE_RUNNER, JRunner))
 #define J_IS_RUNNER(obj) (G_TYPE_CHECK_INSTANCE_TYPE ((obj), J_TYPE_RUNNER))
 typedef struct _JRunner JRunner;
+typedef struct _JVariables JVariables;
 
 #if __cplusplus
 extern "C" {
 #endif // __cplusplus
 
+  typedef enum
+  {
+    J_RUNNER_TIER_INTERPRETER,
+    J_RUNNER_TIER_COMPILER,
+    J_RUNNER_TIER_NUMBER,
+  } JRunnerTier;
+
+  struct _JVariables
+  {
+    gchar** values;
+    guint n_values;
+    gchar** envp;
+  };
+
+  /* Variables sit right after the instance header so generated code can reach them */
+  #define J_RUNNER_VARIABLES_OFFSET (sizeof (GObject))
+
   G_GNUC_INTERNAL GType j_runner_get_type (void) G_GNUC_CONST;
   G_GNUC_INTERNAL JRunner* j_runner_new (gboolean interactive);
+  G_GNUC_INTERNAL void j_runner_function_define (JRunner* runner, JAst* ast);
+  G_GNUC_INTERNAL GPtrArray* j_runner_function_prepare (JRunner* runner, const gchar* name);
+  G_GNUC_INTERNAL void j_runner_function_push (JRunner* runner, GPtrArray* frame, const gchar* value);
+  G_GNUC_INTERNAL gchar** j_runner_get_envp (JRunner* runner);
   G_GNUC_INTERNAL gboolean j_runner_get_interactive (JRunner* runner);
+  G_GNUC_INTERNAL guint j_runner_get_tier_count (JRunner* runner, JRunnerTier tier);
   G_GNUC_INTERNAL GClosure* j_runner_job_pop (JRunner* runner);
   G_GNUC_INTERNAL GClosure* j_runner_job_pop_nth (JRunner* runner, gint index);
   G_GNUC_INTERNAL void j_runner_job_print_all (JRunner* runner);
   G_GNUC_INTERNAL void j_runner_job_push (JRunner* runner, GClosure* closure);
   G_GNUC_INTERNAL gboolean j_runner_run (JRunner* runner, GClosure* closure, gint* exit_code, GError** error);
+  G_GNUC_INTERNAL gboolean j_runner_run_channel (JRunner* runner, GIOChannel* channel, gint* exit_code, GError** error);
   G_GNUC_INTERNAL gboolean j_runner_run_file (JRunner* runner, const gchar* filename, gint* exit_code, GError** error);
   G_GNUC_INTERNAL gboolean j_runner_run_line (JRunner* runner, const gchar* line, gint* exit_code, GError** error);
+  G_GNUC_INTERNAL gboolean j_runner_run_lines (JRunner* runner, const gchar* const* lines, gint* exit_code, GError** error);
+  G_GNUC_INTERNAL void j_runner_variable_export (JRunner* runner, const gchar* key);
   G_GNUC_INTERNAL const gchar* j_runner_variable_get (JRunner* runner, const gchar* key);
   G_GNUC_INTERNAL void j_runner_variable_print (JRunner* runner, const gchar* key);
   G_GNUC_INTERNAL void j_runner_variable_print_all (JRunner* runner);
   G_GNUC_INTERNAL void j_runner_variable_remove (JRunner* runner, const gchar* key);
   G_GNUC_INTERNAL void j_runner_variable_set (JRunner* runner, const gchar* key, const gchar* value);
+  G_GNUC_INTERNAL guint j_variable_slot (const gchar* key);
 
 #if __cplusplus
 }
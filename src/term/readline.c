@@ -315,6 +315,14 @@ return (cleanup (), line2);
 #undef cleanup
 }
 
+gboolean j_readline_get_pending (JReadline* readline)
+{
+  g_return_val_if_fail (J_IS_READLINE (readline), FALSE);
+  GPollFD fd = { fileno (rl_instream != NULL ? rl_instream : stdin), G_IO_IN, 0 };
+  /* Lines typed ahead or pasted in are still waiting on the terminal */
+return g_poll (&fd, 1, 0) > 0;
+}
+
 gboolean j_readline_get_signaled (JReadline* readline)
 {
   g_return_val_if_fail (J_IS_READLINE (readline), FALSE);